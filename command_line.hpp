@@ -0,0 +1,93 @@
+/// @file
+/// Parsing of the command lines of ostat and order_statistics_benchmarks.
+
+#pragma once
+
+// C++ Standard Library.
+#include <charconv>
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+namespace command_line {
+
+/// @brief Parses all of @p text as a number.
+/// @throws std::invalid_argument if @p text is no number.
+template<typename T>
+T parse_number(std::string_view text)
+{
+  T          value{};
+  const auto end{text.data() + text.size()};
+  const auto result{std::from_chars(text.data(), end, value)};
+  if (result.ec != std::errc{} || result.ptr != end) {
+    throw std::invalid_argument{"invalid number '" + std::string{text} + "'"};
+  }
+  return value;
+}
+
+/// @brief The arguments of a command line, read from left to right.
+///
+/// @code
+/// command_line::arguments arguments{std::span{argv + 1, argv + argc}};
+/// while (!arguments.empty()) {
+///   const auto argument{arguments.next()};
+///   if (argument == "--column") {
+///     column = arguments.number<std::size_t>();
+///   }
+///   else {
+///     arguments.unknown();
+///   }
+/// }
+/// @endcode
+class arguments {
+public:
+  explicit arguments(std::span<char*> list) noexcept : list{list} {}
+
+  /// @brief Returns @c true if all arguments have been read.
+  bool empty() const noexcept
+  {
+    return index == list.size();
+  }
+
+  /// @brief Reads the next argument, an option or an operand.
+  std::string_view next() noexcept
+  {
+    current = list[index++];
+    return current;
+  }
+
+  /// @brief Reads the value of the option last read.
+  /// @throws std::invalid_argument if there is no argument left.
+  std::string_view value()
+  {
+    if (empty()) {
+      throw std::invalid_argument{std::string{current} + " needs a value"};
+    }
+    return list[index++];
+  }
+
+  /// @brief Reads the value of the option last read as a number.
+  /// @throws std::invalid_argument if there is no number left.
+  template<typename T>
+  T number()
+  {
+    return parse_number<T>(value());
+  }
+
+  /// @brief Rejects the argument last read.
+  /// @throws std::invalid_argument always.
+  [[noreturn]] void unknown() const
+  {
+    throw std::invalid_argument{"unknown option " + std::string{current}};
+  }
+
+private:
+  std::span<char*> list;
+  std::size_t      index{0};
+  std::string_view current;
+};
+
+}
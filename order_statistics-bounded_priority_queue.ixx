@@ -0,0 +1,187 @@
+/// @file
+/// A double-ended priority queue of bounded capacity for admission control.
+///
+/// The queue holds at most @c N elements in a min-max heap. The element of
+/// highest priority (the greatest element) is served first, while the element
+/// of lowest priority (the smallest element) is evicted if a more important
+/// element arrives at a full queue. Both are found in constant time.
+///
+/// Admitting an element to a full queue needs a single sift: Either the new
+/// element is not greater than the minimum and is rejected without touching the
+/// heap, or it replaces the minimum at the root and is trickled down.
+
+/// @cond
+module;
+/// @endcond
+
+// C++ Standard Library.
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/// @cond
+export module order_statistics:bounded_priority_queue;
+
+import :minmax_heaps;
+/// @endcond
+
+export namespace order_statistics {
+
+/// @brief Outcome of bounded_priority_queue::try_admit().
+enum class admission {
+  /// The element was added, the queue was not full.
+  admitted,
+  /// The element was added, the element of lowest priority was evicted.
+  evicted,
+  /// The element was not added, its priority is too low.
+  rejected
+};
+
+/// @brief Counters of the admissions to a bounded_priority_queue.
+struct admission_statistics {
+  /// Number of elements added to a queue that was not full.
+  std::uint64_t admitted{0};
+  /// Number of elements added to a full queue by evicting its minimum.
+  std::uint64_t evicted{0};
+  /// Number of elements rejected by a full queue.
+  std::uint64_t rejected{0};
+};
+
+/// @brief A double-ended priority queue that holds at most a fixed number of
+/// elements and evicts the element of lowest priority when it is full.
+/// @tparam T Type of the elements.
+/// @tparam Compare Type of a binary functor to determine which of two elements
+/// has the lower priority.
+template<typename T, typename Compare = std::less<>>
+class bounded_priority_queue {
+public:
+  using value_type      = T;
+  using size_type       = std::size_t;
+  using reference       = T&;
+  using const_reference = const T&;
+
+  /// @brief Creates an empty queue that holds up to @p capacity elements.
+  explicit bounded_priority_queue(size_type capacity, Compare comp = {}) :
+    max_size{capacity}, comp{comp}
+  {
+    if (capacity == 0) {
+      throw std::invalid_argument{"capacity must not be 0"};
+    }
+    heap.reserve(capacity);
+  }
+
+  /// @brief Returns @c true if the queue holds no elements.
+  bool empty() const noexcept
+  {
+    return heap.empty();
+  }
+
+  /// @brief Returns @c true if the queue holds capacity() elements.
+  bool full() const noexcept
+  {
+    return heap.size() == max_size;
+  }
+
+  /// @brief Returns the number of elements in the queue.
+  size_type size() const noexcept
+  {
+    return heap.size();
+  }
+
+  /// @brief Returns the maximum number of elements in the queue.
+  size_type capacity() const noexcept
+  {
+    return max_size;
+  }
+
+  /// @brief Returns the element of highest priority.
+  const_reference top() const
+  {
+    return *max_mm_heap(heap.begin(), heap.end(), comp);
+  }
+
+  /// @brief Returns the element of lowest priority, i.e., the next one to be
+  /// evicted.
+  const_reference bottom() const
+  {
+    return heap.front();
+  }
+
+  /// @brief Tries to add @p value to the queue.
+  ///
+  /// If the queue is full, @p value is rejected in constant time unless it has
+  /// a higher priority than bottom(). Otherwise bottom() is evicted, i.e., it
+  /// is replaced by @p value and passed to @p on_evict.
+  ///
+  /// @tparam Evict Type of a unary functor that accepts a @c T&&.
+  /// @param value The element to add.
+  /// @param on_evict Functor that receives the evicted element.
+  /// @return Whether @p value was added and whether an element was evicted.
+  template<typename Evict>
+  admission try_admit(T value, Evict on_evict)
+  {
+    if (heap.size() < max_size) {
+      heap.push_back(std::move(value));
+      push_mm_heap(heap.begin(), heap.end(), comp);
+      ++counters.admitted;
+      return admission::admitted;
+    }
+
+    if (!comp(heap.front(), value)) {
+      ++counters.rejected;
+      return admission::rejected;
+    }
+
+    auto evicted{std::exchange(heap.front(), std::move(value))};
+    heapify(heap.begin(), heap.begin(), heap.end(), comp);
+    ++counters.evicted;
+    on_evict(std::move(evicted));
+    return admission::evicted;
+  }
+
+  /// @brief Tries to add @p value to the queue, an evicted element is
+  /// discarded.
+  admission try_admit(T value)
+  {
+    return try_admit(std::move(value), [](T&&) {
+    });
+  }
+
+  /// @brief Removes the element of highest priority.
+  void pop()
+  {
+    pop_max_mm_heap(heap.begin(), heap.end(), comp);
+    heap.pop_back();
+  }
+
+  /// @brief Removes the element of lowest priority.
+  void pop_bottom()
+  {
+    pop_mm_heap(heap.begin(), heap.end(), comp);
+    heap.pop_back();
+  }
+
+  /// @brief Returns the admission counters since construction or the last
+  /// call to reset_statistics().
+  const admission_statistics& statistics() const noexcept
+  {
+    return counters;
+  }
+
+  /// @brief Sets all admission counters to 0.
+  void reset_statistics() noexcept
+  {
+    counters = {};
+  }
+
+private:
+  size_type            max_size;
+  Compare              comp;
+  std::vector<T>       heap;
+  admission_statistics counters;
+};
+
+}
@@ -0,0 +1,642 @@
+/// @file
+/// Containers built on the in situ algorithms.
+///
+/// A minmax_priority_queue owns a min-max heap. An order_statistics_tree owns
+/// its elements and the positions of its ranks. Both record the latencies of
+/// their operations if record_latencies is @c true.
+/// An incremental_tree_build builds an order_statistics_tree in small steps,
+/// e.g., between the iterations of an event loop, while the readers keep using
+/// the previous tree until the new one is complete.
+
+/// @cond
+module;
+/// @endcond
+
+// C++ Standard Library.
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/// @cond
+export module order_statistics:containers;
+
+import :latency;
+import :minmax_heaps;
+import :trees;
+/// @endcond
+
+namespace order_statistics {
+
+/// @brief Throws @c std::invalid_argument unless @p ranks are strictly
+/// increasing positions in a sequence of @p size elements.
+inline void check_ranks(std::size_t size, std::span<const std::size_t> ranks)
+{
+  for (std::size_t i{0}; i < ranks.size(); ++i) {
+    if (ranks[i] >= size || (i > 0 && ranks[i - 1] >= ranks[i])) {
+      throw std::invalid_argument{
+        "ranks must be strictly increasing and less than the size"};
+    }
+  }
+}
+
+}
+
+export namespace order_statistics {
+
+template<typename T, typename Compare>
+class incremental_tree_build;
+
+template<typename T, typename Compare>
+class pipelined_tree_build;
+
+/// @brief Operations of a minmax_priority_queue whose latencies are
+/// recorded.
+enum class queue_operation { push, pop_min, pop_max, count };
+
+/// @brief A double-ended priority queue in a min-max heap.
+/// @tparam T Type of the elements.
+/// @tparam Compare Type of a binary functor to compare two elements.
+template<typename T, typename Compare = std::less<>>
+class minmax_priority_queue {
+public:
+  using value_type      = T;
+  using size_type       = std::size_t;
+  using const_reference = const T&;
+
+  /// @brief Creates an empty queue.
+  explicit minmax_priority_queue(Compare comp = {}) : comp{comp} {}
+
+  /// @brief Creates a queue of @p elements in linear time.
+  explicit minmax_priority_queue(std::vector<T> elements, Compare comp = {}) :
+    comp{comp}, heap{std::move(elements)}
+  {
+    make_mm_heap(heap.begin(), heap.end(), comp);
+  }
+
+  /// @brief Returns @c true if the queue holds no elements.
+  bool empty() const noexcept
+  {
+    return heap.empty();
+  }
+
+  /// @brief Returns the number of elements.
+  size_type size() const noexcept
+  {
+    return heap.size();
+  }
+
+  /// @brief Reserves storage for @p capacity elements.
+  void reserve(size_type capacity)
+  {
+    heap.reserve(capacity);
+  }
+
+  /// @brief Returns the smallest element. The queue must not be empty.
+  const_reference min() const
+  {
+    return heap.front();
+  }
+
+  /// @brief Returns the greatest element. The queue must not be empty.
+  const_reference max() const
+  {
+    return *max_mm_heap(heap.begin(), heap.end(), comp);
+  }
+
+  /// @brief Adds @p value.
+  void push(T value)
+  {
+    [[maybe_unused]] const auto timer{recorder.time(queue_operation::push)};
+    heap.push_back(std::move(value));
+    push_mm_heap(heap.begin(), heap.end(), comp);
+  }
+
+  /// @brief Removes the smallest element. The queue must not be empty.
+  void pop_min()
+  {
+    [[maybe_unused]] const auto timer{
+      recorder.time(queue_operation::pop_min)};
+    pop_mm_heap(heap.begin(), heap.end(), comp);
+    heap.pop_back();
+  }
+
+  /// @brief Removes the greatest element. The queue must not be empty.
+  void pop_max()
+  {
+    [[maybe_unused]] const auto timer{
+      recorder.time(queue_operation::pop_max)};
+    pop_max_mm_heap(heap.begin(), heap.end(), comp);
+    heap.pop_back();
+  }
+
+  /// @brief Returns the latencies of @p operation since construction or the
+  /// last call to reset_latencies(), always empty unless record_latencies
+  /// is @c true.
+  const latency_histogram& latencies(queue_operation operation) const noexcept
+  {
+    return recorder.histogram(operation);
+  }
+
+  /// @brief Forgets the latencies of all operations.
+  void reset_latencies() noexcept
+  {
+    recorder.reset();
+  }
+
+private:
+  Compare                           comp;
+  std::vector<T>                    heap;
+  latency_recorder<queue_operation> recorder;
+};
+
+/// @brief Operations of an order_statistics_tree whose latencies are
+/// recorded, pop_min() is an erase.
+enum class tree_operation { push, insert, erase, count };
+
+/// @brief An order statistics tree that owns its elements.
+///
+/// The ranks are positions into the elements. They keep their positions when
+/// elements are added or removed, so all ranks must stay less than size().
+///
+/// @tparam T Type of the elements.
+/// @tparam Compare Type of a binary functor to compare two elements.
+template<typename T, typename Compare = std::less<>>
+class order_statistics_tree {
+public:
+  using value_type      = T;
+  using size_type       = std::size_t;
+  using const_reference = const T&;
+
+  /// @brief Builds a tree of @p elements with the ranks @p ranks.
+  /// @param elements The elements of the tree.
+  /// @param ranks Strictly increasing positions less than the number of
+  /// elements.
+  /// @param comp Functor to determine which of two elements is considered
+  /// smaller.
+  order_statistics_tree(std::vector<T>         elements,
+                        std::vector<size_type> ranks,
+                        Compare                comp = {}) :
+    comp{comp}, values{std::move(elements)}, positions{std::move(ranks)}
+  {
+    check_ranks(values.size(), positions);
+    const auto& rank_its{rank_iterators()};
+    make_order_statistics_tree(
+      values.begin(), values.end(), rank_its.begin(), rank_its.end(), comp);
+  }
+
+  /// @brief Takes @p elements that already form an order statistics tree
+  /// with the ranks @p ranks, e.g., those of a snapshot, in linear time.
+  /// @throws std::invalid_argument if the ranks are invalid or the elements
+  /// do not form an order statistics tree with them.
+  static order_statistics_tree adopt(std::vector<T>         elements,
+                                     std::vector<size_type> ranks,
+                                     Compare                comp = {})
+  {
+    check_ranks(elements.size(), ranks);
+    order_statistics_tree tree{
+      std::move(elements), std::move(ranks), comp, std::in_place};
+    const auto& rank_its{tree.rank_iterators()};
+    if (!is_order_statistics_tree(tree.values.begin(),
+                                  tree.values.end(),
+                                  rank_its.begin(),
+                                  rank_its.end(),
+                                  comp)) {
+      throw std::invalid_argument{"not an order statistics tree"};
+    }
+    return tree;
+  }
+
+  /// @brief Returns @c true if the tree has no elements.
+  bool empty() const noexcept
+  {
+    return values.empty();
+  }
+
+  /// @brief Returns the number of elements.
+  size_type size() const noexcept
+  {
+    return values.size();
+  }
+
+  /// @brief Returns the positions of the ranks.
+  std::span<const size_type> ranks() const noexcept
+  {
+    return positions;
+  }
+
+  /// @brief Returns the element of the rank @p i, i.e., the element at
+  /// ranks()[@p i] of the sorted elements.
+  const_reference at_rank(size_type i) const
+  {
+    return values[positions[i]];
+  }
+
+  /// @brief Returns the smallest element. The tree must not be empty.
+  const_reference min() const
+  {
+    return values.front();
+  }
+
+  /// @brief Returns the greatest element. The tree must not be empty.
+  const_reference max() const
+  {
+    const auto last_segment{values.begin()
+                            + static_cast<std::ptrdiff_t>(
+                              positions.empty() ? 0 : positions.back())};
+    return *max_mm_heap(last_segment, values.end(), comp);
+  }
+
+  /// @brief Returns all elements, the elements between two ranks are
+  /// consecutive (range-query).
+  std::span<const T> elements() const noexcept
+  {
+    return values;
+  }
+
+  /// @brief Reserves storage for @p capacity elements.
+  void reserve(size_type capacity)
+  {
+    values.reserve(capacity);
+  }
+
+  /// @brief Adds @p value.
+  void push(T value)
+  {
+    [[maybe_unused]] const auto timer{recorder.time(tree_operation::push)};
+    values.push_back(std::move(value));
+    const auto& rank_its{rank_iterators()};
+    push_order_statistics_tree(
+      values.begin(), values.end(), rank_its.begin(), rank_its.end(), comp);
+  }
+
+  /// @brief Adds all @p batch.
+  ///
+  /// Same as push() for every element of @p batch, but the elements are
+  /// appended at once.
+  void insert(std::span<const T> batch)
+  {
+    [[maybe_unused]] const auto timer{recorder.time(tree_operation::insert)};
+    const auto old_size{values.size()};
+    values.insert(values.end(), batch.begin(), batch.end());
+    const auto& rank_its{rank_iterators()};
+    const auto  first{values.begin()};
+    for (auto n{old_size + 1}; n <= values.size(); ++n) {
+      push_order_statistics_tree(first,
+                                 first + static_cast<std::ptrdiff_t>(n),
+                                 rank_its.begin(),
+                                 rank_its.end(),
+                                 comp);
+    }
+  }
+
+  /// @brief Removes the element at @p position of elements().
+  /// @throws std::length_error if the greatest rank would be out of range.
+  void erase(size_type position)
+  {
+    if (!positions.empty() && positions.back() + 1 >= values.size()) {
+      throw std::length_error{"the greatest rank would be out of range"};
+    }
+    [[maybe_unused]] const auto timer{recorder.time(tree_operation::erase)};
+    const auto& rank_its{rank_iterators()};
+    erase_order_statistics_tree(
+      values.begin(),
+      values.begin() + static_cast<std::ptrdiff_t>(position),
+      values.end(),
+      rank_its.begin(),
+      rank_its.end(),
+      comp);
+    values.pop_back();
+  }
+
+  /// @brief Removes the smallest element.
+  /// @throws std::length_error if the greatest rank would be out of range.
+  void pop_min()
+  {
+    erase(0);
+  }
+
+  /// @brief Returns the latencies of @p operation since construction or the
+  /// last call to reset_latencies(), always empty unless record_latencies
+  /// is @c true.
+  const latency_histogram& latencies(tree_operation operation) const noexcept
+  {
+    return recorder.histogram(operation);
+  }
+
+  /// @brief Forgets the latencies of all operations.
+  void reset_latencies() noexcept
+  {
+    recorder.reset();
+  }
+
+  /// @brief Moves all elements out of the tree, the tree is left empty.
+  std::vector<T> release() noexcept
+  {
+    auto elements{std::move(values)};
+    values.clear();
+    positions.clear();
+    return elements;
+  }
+
+private:
+  friend class incremental_tree_build<T, Compare>;
+  friend class pipelined_tree_build<T, Compare>;
+
+  using iterator = typename std::vector<T>::iterator;
+
+  /// @brief Takes @p elements that already form a tree with the ranks
+  /// @p ranks.
+  order_statistics_tree(std::vector<T>         elements,
+                        std::vector<size_type> ranks,
+                        Compare                comp,
+                        std::in_place_t) :
+    comp{comp}, values{std::move(elements)}, positions{std::move(ranks)}
+  {
+  }
+
+  /// @brief Returns the iterators to the ranks, they are refreshed on every
+  /// call since @c values may have been reallocated.
+  const std::vector<iterator>& rank_iterators()
+  {
+    iterators.resize(positions.size());
+    for (size_type i{0}; i < positions.size(); ++i) {
+      iterators[i] = values.begin() + static_cast<std::ptrdiff_t>(positions[i]);
+    }
+    return iterators;
+  }
+
+  Compare                          comp;
+  std::vector<T>                   values;
+  std::vector<size_type>           positions;
+  std::vector<iterator>            iterators;
+  latency_recorder<tree_operation> recorder;
+};
+
+/// @brief Builds an order_statistics_tree in bounded steps.
+///
+/// The build performs the same work as make_order_statistics_tree(): One
+/// selection per rank, a three-way quickselect here, and one min-max heap
+/// construction per segment. Each step partitions a single element or
+/// heapifies a single node, so the build can be suspended after any step and
+/// resumed later. A quickselect that has not found its rank after
+/// 2 log2(n) partitions falls back to a heap select, so no input makes the
+/// build quadratic. The elements are owned by the build until it is done.
+///
+/// @code
+/// incremental_tree_build<float> build{std::move(samples), {n / 2}};
+/// while (!build.resume(std::chrono::milliseconds{2})) {
+///   // Serve other events, readers keep using the old tree.
+/// }
+/// tree = build.result();
+/// @endcode
+///
+/// @tparam T Type of the elements, must be copyable and default
+/// constructible.
+/// @tparam Compare Type of a binary functor to compare two elements.
+template<typename T, typename Compare = std::less<>>
+class incremental_tree_build {
+public:
+  using size_type = std::size_t;
+
+  /// @brief Number of steps between two looks at the clock in resume().
+  static constexpr size_type steps_per_check{4096};
+
+  /// @brief Prepares the build of a tree of @p elements with the ranks
+  /// @p ranks, no work is done yet.
+  /// @param elements The elements of the tree.
+  /// @param ranks Strictly increasing positions less than the number of
+  /// elements.
+  /// @param comp Functor to determine which of two elements is considered
+  /// smaller.
+  incremental_tree_build(std::vector<T>         elements,
+                         std::vector<size_type> ranks,
+                         Compare                comp = {}) :
+    comp{comp}, values{std::move(elements)}, positions{std::move(ranks)}
+  {
+    check_ranks(values.size(), positions);
+    start_segment(0);
+  }
+
+  /// @brief Returns @c true if the tree is complete.
+  bool done() const noexcept
+  {
+    return state == phase::done;
+  }
+
+  /// @brief Performs at most @p steps steps of the build.
+  /// @return done()
+  bool step(size_type steps)
+  {
+    for (; steps > 0 && state != phase::done; --steps) {
+      if (state == phase::select) {
+        select_step();
+      }
+      else if (state == phase::heap_select) {
+        heap_select_step();
+      }
+      else {
+        heapify_step();
+      }
+    }
+    return done();
+  }
+
+  /// @brief Continues the build for about @p budget.
+  ///
+  /// The clock is read every steps_per_check steps, a step takes
+  /// <tt>O(log n)</tt> at most and the build <tt>O(n log n)</tt> steps per
+  /// rank at most.
+  ///
+  /// @return done()
+  bool resume(std::chrono::steady_clock::duration budget)
+  {
+    const auto deadline{std::chrono::steady_clock::now() + budget};
+    while (!step(steps_per_check)
+           && std::chrono::steady_clock::now() < deadline) {
+    }
+    return done();
+  }
+
+  /// @brief Returns the completed tree, the build is left empty.
+  /// @throws std::logic_error if the build is not done().
+  order_statistics_tree<T, Compare> result()
+  {
+    if (!done()) {
+      throw std::logic_error{"the build is not done"};
+    }
+    return {std::move(values), std::move(positions), comp, std::in_place};
+  }
+
+private:
+  enum class phase { select, heap_select, heapify, done };
+
+  /// @brief Selects the rank @p s, or heapifies the last segment if @p s is
+  /// the number of ranks.
+  void start_segment(size_type s)
+  {
+    segment = s;
+    if (s < positions.size()) {
+      state        = phase::select;
+      lo           = s == 0 ? 0 : positions[s - 1] + 1;
+      hi           = values.size();
+      partitioning = false;
+      rounds       = 2 * std::bit_width(hi - lo);
+    }
+    else {
+      start_heapify(s == 0 ? 0 : positions[s - 1], values.size());
+    }
+  }
+
+  void start_heapify(size_type first, size_type last)
+  {
+    state      = phase::heapify;
+    heap_first = first;
+    heap_last  = last;
+    node       = (last - first) / 2 + 1;
+  }
+
+  /// @brief Partitions one element of [lo, hi) around the pivot, or starts
+  /// the next partition.
+  void select_step()
+  {
+    using std::swap;
+
+    const auto k{positions[segment]};
+    if (!partitioning) {
+      if (hi - lo <= 16) {
+        std::sort(values.begin() + static_cast<std::ptrdiff_t>(lo),
+                  values.begin() + static_cast<std::ptrdiff_t>(hi),
+                  comp);
+        finish_selection();
+        return;
+      }
+      if (rounds == 0) {
+        state = phase::heap_select;
+        scan  = lo;
+        return;
+      }
+      --rounds;
+      // Median of three.
+      const auto& a{values[lo]};
+      const auto& b{values[lo + (hi - lo) / 2]};
+      const auto& c{values[hi - 1]};
+      pivot = comp(a, b) ? (comp(b, c) ? b : (comp(a, c) ? c : a))
+                         : (comp(a, c) ? a : (comp(b, c) ? c : b));
+      lt           = lo;
+      next         = lo;
+      gt           = hi;
+      partitioning = true;
+      return;
+    }
+
+    // [lo, lt) < pivot, [lt, next) == pivot, [gt, hi) > pivot.
+    if (comp(values[next], pivot)) {
+      swap(values[lt++], values[next++]);
+    }
+    else if (comp(pivot, values[next])) {
+      swap(values[next], values[--gt]);
+    }
+    else {
+      ++next;
+    }
+    if (next == gt) {
+      partitioning = false;
+      if (k < lt) {
+        hi = lt;
+      }
+      else if (k >= gt) {
+        lo = gt;
+      }
+      else {
+        finish_selection();
+      }
+    }
+  }
+
+  /// @brief Selects the rank of the current segment in [lo, hi) with a max
+  /// heap of the smallest elements, one element per step.
+  void heap_select_step()
+  {
+    using std::swap;
+
+    const auto k{positions[segment]};
+    const auto first{values.begin() + static_cast<std::ptrdiff_t>(lo)};
+    const auto heap_end{values.begin() + static_cast<std::ptrdiff_t>(k + 1)};
+    if (scan <= k) {
+      // [lo, scan + 1) becomes a heap.
+      std::push_heap(
+        first, values.begin() + static_cast<std::ptrdiff_t>(++scan), comp);
+    }
+    else if (scan < hi) {
+      // [lo, k + 1) holds the k + 1 - lo smallest elements of [lo, scan).
+      if (comp(values[scan], values[lo])) {
+        std::pop_heap(first, heap_end, comp);
+        swap(values[k], values[scan]);
+        std::push_heap(first, heap_end, comp);
+      }
+      ++scan;
+    }
+    else {
+      std::pop_heap(first, heap_end, comp);
+      finish_selection();
+    }
+  }
+
+  void finish_selection()
+  {
+    start_heapify(segment == 0 ? 0 : positions[segment - 1],
+                  positions[segment]);
+  }
+
+  /// @brief Heapifies one node of the current segment, see make_mm_heap().
+  void heapify_step()
+  {
+    if (node == 0) {
+      if (segment < positions.size()) {
+        start_segment(segment + 1);
+      }
+      else {
+        state = phase::done;
+      }
+      return;
+    }
+    --node;
+    const auto first{values.begin() + static_cast<std::ptrdiff_t>(heap_first)};
+    const auto last{values.begin() + static_cast<std::ptrdiff_t>(heap_last)};
+    heapify(first, first + static_cast<std::ptrdiff_t>(node), last, comp);
+  }
+
+  Compare                comp;
+  std::vector<T>         values;
+  std::vector<size_type> positions;
+
+  phase     state{phase::select};
+  size_type segment{0};
+
+  // Quickselect of the rank of the current segment in [lo, hi).
+  size_type lo{0};
+  size_type hi{0};
+  bool      partitioning{false};
+  T         pivot{};
+  size_type lt{0};
+  size_type next{0};
+  size_type gt{0};
+  // Partitions left before the fall back to a heap select, and the next
+  // element of the heap select.
+  size_type rounds{0};
+  size_type scan{0};
+
+  // Construction of the min-max heap [heap_first, heap_last), node is the
+  // number of nodes left to heapify.
+  size_type heap_first{0};
+  size_type heap_last{0};
+  size_type node{0};
+};
+
+}
@@ -0,0 +1,793 @@
+/// @file
+/// Exact quantiles of data sharded across workers.
+///
+/// Every worker keeps a window of its shard per requested rank, the elements
+/// that may still hold the rank. A coordinator selects all ranks at once in
+/// rounds of two messages to every worker:
+///
+/// 1. Every worker proposes, for every rank, the element of its window at the
+///    relative position of the rank in the global window, weighted by the size
+///    of its window. The coordinator picks the weighted median of the
+///    proposals as the splitter.
+/// 2. Every worker counts the elements of its window smaller than the splitter
+///    and not greater than the splitter. If the rank lies between the two
+///    global sums the splitter is the element of that rank. Otherwise the
+///    windows shrink to the side of the splitter that holds the rank, which
+///    the workers learn with the next proposal request.
+///
+/// The shards are not sorted. Like std::nth_element, a worker partitions its
+/// shard around the splitters and proposals, but only the part between the
+/// cuts of earlier splitters that a new one falls into. Every cut stays valid
+/// for all windows, and a worker does expected linear work per rank.
+///
+/// A message holds a constant number of values per rank, i.e., a round
+/// exchanges O(m × workers) values for m ranks, independent of the size of
+/// the shards. The messages travel over a transport: in_process_transport
+/// calls the workers directly, pipe_transport talks to worker processes
+/// through pipes.
+
+/// @cond
+module;
+/// @endcond
+
+// C++ Standard Library.
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// POSIX.
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+/// @cond
+export module order_statistics:distributed;
+
+import :percentiles;
+/// @endcond
+
+export namespace order_statistics {
+
+/// @brief Steps of the distributed selection protocol.
+enum class selection_step : std::uint64_t {
+  /// Asks for the number of elements, replied in @c counts.
+  size,
+  /// Narrows the windows and asks for proposals. @c counts holds a decision,
+  /// the offset of the rank in the global window and the size of the global
+  /// window per rank, the reply one proposal in @c values and the size of
+  /// the local window in @c counts per rank.
+  propose,
+  /// Asks for the number of elements of the windows smaller than and not
+  /// greater than the splitters in @c values, replied in @c counts, two per
+  /// rank.
+  count,
+  /// Ends the worker, there is no reply.
+  stop
+};
+
+/// @brief How a window changes with the counts of the last splitter.
+enum class selection_decision : std::uint64_t {
+  /// The window is unchanged, e.g., in the first round.
+  keep,
+  /// The window shrinks to the elements smaller than the splitter.
+  take_smaller,
+  /// The rank is found, the window is empty.
+  found,
+  /// The window shrinks to the elements greater than the splitter.
+  take_greater
+};
+
+/// @brief A request of the coordinator or the reply of a worker.
+/// @tparam T Type of the elements.
+template<typename T>
+struct selection_message {
+  selection_step             step{selection_step::size};
+  std::vector<T>             values;
+  std::vector<std::uint64_t> counts;
+};
+
+/// @brief The shard of a worker and its windows.
+///
+/// The shard is cut into segments, every element of a segment is not
+/// greater than the elements of the following segments. Every window is a
+/// sequence of whole segments.
+///
+/// @tparam T Type of the elements, must be default constructible.
+/// @tparam Compare Type of a binary functor to compare two elements.
+template<typename T, typename Compare = std::less<>>
+class selection_worker {
+public:
+  /// @brief Takes @p shard, which is reordered by the selections.
+  explicit selection_worker(std::vector<T> shard, Compare comp = {}) :
+    comp{comp},
+    shard{std::move(shard)}
+  {
+  }
+
+  /// @brief Returns the reply to @p request.
+  selection_message<T> handle(const selection_message<T>& request)
+  {
+    selection_message<T> reply{request.step, {}, {}};
+    switch (request.step) {
+    case selection_step::size:
+      // A new selection starts.
+      windows.clear();
+      reply.counts.push_back(shard.size());
+      break;
+    case selection_step::propose:
+      propose(request.counts, reply);
+      break;
+    case selection_step::count:
+      count(request.values, reply);
+      break;
+    case selection_step::stop:
+      break;
+    }
+    return reply;
+  }
+
+private:
+  /// @brief A window of the shard and the counts of its last splitter.
+  struct window {
+    std::size_t first{0};
+    std::size_t last{0};
+    std::size_t smaller{0};
+    std::size_t not_greater{0};
+  };
+
+  /// @brief A cut between two segments of the shard.
+  struct boundary {
+    std::size_t position{0};
+    T           splitter{};
+    /// If @c true the elements before are smaller than the splitter and the
+    /// elements after are not, otherwise the elements before are not greater
+    /// than the splitter and the elements after are not smaller.
+    bool smaller{true};
+  };
+
+  void propose(std::span<const std::uint64_t> counts,
+               selection_message<T>&          reply)
+  {
+    const auto ranks{counts.size() / 3};
+    if (windows.empty()) {
+      windows.assign(ranks, window{0, shard.size(), 0, 0});
+    }
+    for (std::size_t i{0}; i < ranks; ++i) {
+      auto& w{windows[i]};
+      switch (static_cast<selection_decision>(counts[3 * i])) {
+      case selection_decision::keep:
+        break;
+      case selection_decision::take_smaller:
+        w.last = w.first + w.smaller;
+        break;
+      case selection_decision::found:
+        w.last = w.first;
+        break;
+      case selection_decision::take_greater:
+        w.first += w.not_greater;
+        break;
+      }
+
+      const auto size{w.last - w.first};
+      const auto offset{counts[3 * i + 1]};
+      const auto global{counts[3 * i + 2]};
+      if (size == 0 || global == 0) {
+        reply.values.emplace_back();
+      }
+      else {
+        const auto position{static_cast<std::size_t>(
+          static_cast<double>(offset) / static_cast<double>(global)
+          * static_cast<double>(size))};
+        reply.values.push_back(select(w.first + std::min(position, size - 1)));
+      }
+      reply.counts.push_back(size);
+    }
+  }
+
+  void count(std::span<const T> splitters, selection_message<T>& reply)
+  {
+    for (std::size_t i{0}; i < splitters.size() && i < windows.size(); ++i) {
+      auto& w{windows[i]};
+      w.smaller     = cut(w.first, w.last, splitters[i], true) - w.first;
+      w.not_greater = cut(w.first, w.last, splitters[i], false) - w.first;
+      reply.counts.push_back(w.smaller);
+      reply.counts.push_back(w.not_greater);
+    }
+  }
+
+  /// @brief Returns the element of the shard that would be at @p position
+  /// if the shard were sorted.
+  ///
+  /// Reorders the segment of @p position only, see std::nth_element(), and
+  /// records the cut at @p position.
+  const T& select(std::size_t position)
+  {
+    const auto next{boundary_after(position)};
+    const auto first{next == boundaries.begin() ? 0
+                                                : std::prev(next)->position};
+    const auto last{next == boundaries.end() ? shard.size() : next->position};
+    std::nth_element(at(first), at(position), at(last), comp);
+    if (position > first) {
+      boundaries.insert(next, boundary{position, shard[position], false});
+    }
+    return shard[position];
+  }
+
+  /// @brief Returns the position in the window [@p first, @p last) before
+  /// which the elements are smaller than @p splitter or, unless @p smaller,
+  /// not greater than @p splitter.
+  ///
+  /// Partitions the one segment of the window that holds the position and
+  /// records the cut.
+  std::size_t
+  cut(std::size_t first, std::size_t last, const T& splitter, bool smaller)
+  {
+    const auto inner_first{boundary_after(first)};
+    const auto inner_last{std::lower_bound(
+      inner_first,
+      boundaries.end(),
+      last,
+      [](const boundary& b, std::size_t p) { return b.position < p; })};
+    // Every boundary has only elements before or after it that belong before
+    // the new cut, which lies in the segment between the last boundary of
+    // the first kind and the next one.
+    const auto next{
+      std::partition_point(inner_first, inner_last, [&](const boundary& b) {
+        return b.smaller || !smaller ? !comp(splitter, b.splitter)
+                                     : comp(b.splitter, splitter);
+      })};
+    const auto segment_first{
+      next == inner_first ? first : std::prev(next)->position};
+    const auto segment_last{next == inner_last ? last : next->position};
+
+    const auto position{static_cast<std::size_t>(
+      std::partition(at(segment_first),
+                     at(segment_last),
+                     [&](const T& value) {
+                       return smaller ? comp(value, splitter)
+                                      : !comp(splitter, value);
+                     })
+      - shard.begin())};
+    if (position > segment_first && position < segment_last) {
+      boundaries.insert(next, boundary{position, splitter, smaller});
+    }
+    return position;
+  }
+
+  /// @brief Returns the first boundary after @p position.
+  typename std::vector<boundary>::iterator boundary_after(std::size_t position)
+  {
+    return std::upper_bound(
+      boundaries.begin(),
+      boundaries.end(),
+      position,
+      [](std::size_t p, const boundary& b) { return p < b.position; });
+  }
+
+  typename std::vector<T>::iterator at(std::size_t position)
+  {
+    return shard.begin() + static_cast<std::ptrdiff_t>(position);
+  }
+
+  Compare               comp;
+  std::vector<T>        shard;
+  std::vector<window>   windows;
+  std::vector<boundary> boundaries;
+};
+
+/// @brief A transport that calls the workers directly, one after the other.
+///
+/// It simulates the protocol in a single process, e.g., to test it or to
+/// count the rounds.
+template<typename T, typename Compare = std::less<>>
+class in_process_transport {
+public:
+  /// @brief Creates a worker per shard.
+  explicit in_process_transport(std::vector<std::vector<T>> shards,
+                                Compare                     comp = {})
+  {
+    for (auto& shard : shards) {
+      workers.emplace_back(std::move(shard), comp);
+    }
+  }
+
+  /// @brief Returns the number of workers.
+  std::size_t size() const noexcept
+  {
+    return workers.size();
+  }
+
+  /// @brief Sends @p request to every worker and returns their replies.
+  std::vector<selection_message<T>>
+  broadcast(const selection_message<T>& request)
+  {
+    std::vector<selection_message<T>> replies;
+    for (auto& worker : workers) {
+      replies.push_back(worker.handle(request));
+    }
+    return replies;
+  }
+
+private:
+  std::vector<selection_worker<T, Compare>> workers;
+};
+
+/// @brief The elements of the requested ranks and the cost of selecting
+/// them.
+template<typename T>
+struct distributed_selection {
+  /// The element of every rank.
+  std::vector<T> values;
+  /// Number of rounds of proposals and counts.
+  std::size_t rounds{0};
+  /// Number of values and counts sent in both directions.
+  std::size_t exchanged{0};
+};
+
+}
+
+namespace order_statistics {
+
+/// @brief Sends @p request to all workers of @p transport and adds the size
+/// of the messages to @p exchanged.
+template<typename T, typename Transport>
+std::vector<selection_message<T>>
+broadcast_counted(Transport&                  transport,
+                  const selection_message<T>& request,
+                  std::size_t&                exchanged)
+{
+  auto replies{transport.broadcast(request)};
+  exchanged +=
+    transport.size() * (request.values.size() + request.counts.size());
+  for (const auto& reply : replies) {
+    exchanged += reply.values.size() + reply.counts.size();
+  }
+  return replies;
+}
+
+/// @brief Selects the ranks that @p ranks_of returns for the total number
+/// of elements.
+template<typename T, typename Transport, typename Ranks, typename Compare>
+distributed_selection<T>
+select_distributed(Transport& transport, Ranks ranks_of, Compare comp)
+{
+  distributed_selection<T> result;
+
+  std::uint64_t total{0};
+  const selection_message<T> size_request{selection_step::size, {}, {}};
+  for (const auto& reply :
+       broadcast_counted(transport, size_request, result.exchanged)) {
+    total += reply.counts.at(0);
+  }
+  const std::vector<std::uint64_t> ranks{ranks_of(total)};
+  for (const auto rank : ranks) {
+    if (rank >= total) {
+      throw std::out_of_range{"rank out of range"};
+    }
+  }
+
+  // The global window of every rank and the number of elements before it.
+  std::vector<std::uint64_t> below(ranks.size(), 0);
+  std::vector<std::uint64_t> sizes(ranks.size(), total);
+  std::vector<selection_decision> decisions(ranks.size(),
+                                           selection_decision::keep);
+  result.values.resize(ranks.size());
+
+  std::vector<std::pair<T, std::uint64_t>> proposals;
+  while (std::any_of(
+    sizes.begin(), sizes.end(), [](const auto size) { return size > 0; })) {
+    ++result.rounds;
+
+    selection_message<T> request{selection_step::propose, {}, {}};
+    for (std::size_t i{0}; i < ranks.size(); ++i) {
+      request.counts.insert(request.counts.end(),
+                            {static_cast<std::uint64_t>(decisions[i]),
+                             ranks[i] - below[i],
+                             sizes[i]});
+    }
+    const auto replies{
+      broadcast_counted(transport, request, result.exchanged)};
+
+    // The weighted median of the proposals of every rank.
+    request = {selection_step::count, {}, {}};
+    for (std::size_t i{0}; i < ranks.size(); ++i) {
+      proposals.clear();
+      std::uint64_t weight{0};
+      for (const auto& reply : replies) {
+        if (reply.counts.at(i) > 0) {
+          proposals.emplace_back(reply.values.at(i), reply.counts[i]);
+          weight += reply.counts[i];
+        }
+      }
+      std::sort(
+        proposals.begin(),
+        proposals.end(),
+        [&](const auto& a, const auto& b) { return comp(a.first, b.first); });
+      std::uint64_t sum{0};
+      auto          splitter{proposals.empty() ? T{} : proposals.back().first};
+      for (const auto& [value, w] : proposals) {
+        sum += w;
+        if (2 * sum >= weight) {
+          splitter = value;
+          break;
+        }
+      }
+      request.values.push_back(splitter);
+    }
+
+    std::vector<std::uint64_t> smaller(ranks.size(), 0);
+    std::vector<std::uint64_t> not_greater(ranks.size(), 0);
+    for (const auto& reply :
+         broadcast_counted(transport, request, result.exchanged)) {
+      for (std::size_t i{0}; i < ranks.size(); ++i) {
+        smaller[i] += reply.counts.at(2 * i);
+        not_greater[i] += reply.counts.at(2 * i + 1);
+      }
+    }
+    for (std::size_t i{0}; i < ranks.size(); ++i) {
+      const auto offset{ranks[i] - below[i]};
+      if (sizes[i] == 0) {
+        decisions[i] = selection_decision::found;
+      }
+      else if (offset < smaller[i]) {
+        decisions[i] = selection_decision::take_smaller;
+        sizes[i]     = smaller[i];
+      }
+      else if (offset < not_greater[i]) {
+        decisions[i]     = selection_decision::found;
+        sizes[i]         = 0;
+        result.values[i] = request.values[i];
+      }
+      else {
+        decisions[i] = selection_decision::take_greater;
+        below[i] += not_greater[i];
+        sizes[i] -= not_greater[i];
+      }
+    }
+  }
+  return result;
+}
+
+}
+
+export namespace order_statistics {
+
+/// @brief Selects the elements of @p ranks of the union of the shards of the
+/// workers of @p transport.
+///
+/// @tparam Transport Type of a transport with the members @c size(), which
+/// returns the number of workers, and @c broadcast(request), which returns
+/// the reply of every worker, e.g., in_process_transport or pipe_transport.
+/// @param ranks Zero-based ranks, in any order.
+/// @param comp Functor to compare two elements, the same as the workers'.
+/// @throws std::out_of_range if a rank is not less than the number of
+/// elements.
+template<typename T, typename Transport, typename Compare = std::less<>>
+distributed_selection<T>
+distributed_select(Transport&                   transport,
+                   std::span<const std::size_t> ranks,
+                   Compare                      comp = {})
+{
+  return select_distributed<T>(
+    transport,
+    [&](std::uint64_t) {
+      return std::vector<std::uint64_t>(ranks.begin(), ranks.end());
+    },
+    comp);
+}
+
+/// @brief Selects the @p percentiles of the union of the shards of the
+/// workers of @p transport, see distributed_select().
+///
+/// The percentile p is the element of rank percentile_rank(p, size).
+///
+/// @throws std::out_of_range if there are no elements.
+/// @throws std::invalid_argument if a percentile is not in [0, 1].
+template<typename T, typename Transport, typename Compare = std::less<>>
+distributed_selection<T>
+distributed_quantiles(Transport&              transport,
+                      std::span<const double> percentiles,
+                      Compare                 comp = {})
+{
+  for (const auto p : percentiles) {
+    if (!(p >= 0.0 && p <= 1.0)) {
+      throw std::invalid_argument{"percentile must lie in [0, 1]"};
+    }
+  }
+  return select_distributed<T>(
+    transport,
+    [&](std::uint64_t size) {
+      std::vector<std::uint64_t> ranks;
+      for (const auto p : percentiles) {
+        ranks.push_back(percentile_rank(p, static_cast<std::size_t>(size)));
+      }
+      return ranks;
+    },
+    comp);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+/// @brief A transport to worker processes through a pair of pipes each.
+///
+/// A message is a header of three 64-bit words, the step and the numbers of
+/// values and counts, followed by the values and the counts as raw bytes.
+/// The request is written to all workers before the replies are read, i.e.,
+/// the workers handle it in parallel. SIGPIPE is blocked in the writing
+/// thread while a message is written, so a worker that has exited makes the
+/// write throw instead of terminating the process.
+///
+/// @tparam T Type of the elements, must be trivially copyable.
+template<typename T>
+class pipe_transport {
+  static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+  /// @brief Forks a worker process per shard.
+  ///
+  /// The processes are forked from the calling thread. Call it before other
+  /// threads are started, the child processes allocate memory.
+  ///
+  /// @throws std::system_error if a pipe or a process cannot be created.
+  template<typename Compare = std::less<>>
+  static pipe_transport fork(std::vector<std::vector<T>> shards,
+                             Compare                     comp = {})
+  {
+    pipe_transport transport;
+    for (auto& shard : shards) {
+      int requests[2];
+      int replies[2];
+      if (::pipe(requests) != 0) {
+        throw std::system_error{errno, std::generic_category(), "pipe"};
+      }
+      if (::pipe(replies) != 0) {
+        const auto error{errno};
+        ::close(requests[0]);
+        ::close(requests[1]);
+        throw std::system_error{error, std::generic_category(), "pipe"};
+      }
+      const auto pid{::fork()};
+      if (pid < 0) {
+        const auto error{errno};
+        for (const auto fd :
+             {requests[0], requests[1], replies[0], replies[1]}) {
+          ::close(fd);
+        }
+        throw std::system_error{error, std::generic_category(), "fork"};
+      }
+      if (pid == 0) {
+        ::close(requests[1]);
+        ::close(replies[0]);
+        for (const auto& worker : transport.workers) {
+          ::close(worker.requests);
+          ::close(worker.replies);
+        }
+        try {
+          selection_worker<T, Compare> worker{std::move(shard), comp};
+          serve(worker, requests[0], replies[1]);
+        }
+        catch (...) {
+          ::_exit(1);
+        }
+        ::_exit(0);
+      }
+      ::close(requests[0]);
+      ::close(replies[1]);
+      transport.workers.push_back({pid, requests[1], replies[0]});
+    }
+    return transport;
+  }
+
+  /// @brief Handles the requests read from @p in until a stop request or the
+  /// end of the pipe, writes the replies to @p out.
+  /// @throws std::system_error if reading or writing fails.
+  template<typename Worker>
+  static void serve(Worker& worker, int in, int out)
+  {
+    selection_message<T> request;
+    while (read_message(in, request)
+           && request.step != selection_step::stop) {
+      write_message(out, worker.handle(request));
+    }
+  }
+
+  pipe_transport(pipe_transport&& other) noexcept :
+    workers{std::exchange(other.workers, {})}
+  {
+  }
+
+  pipe_transport& operator=(pipe_transport&& other) noexcept
+  {
+    if (this != &other) {
+      stop();
+      workers = std::exchange(other.workers, {});
+    }
+    return *this;
+  }
+
+  /// @brief Stops the worker processes and waits for them.
+  ~pipe_transport()
+  {
+    stop();
+  }
+
+  /// @brief Returns the number of workers.
+  std::size_t size() const noexcept
+  {
+    return workers.size();
+  }
+
+  /// @brief Sends @p request to every worker and returns their replies.
+  /// @throws std::system_error if a worker cannot be reached.
+  std::vector<selection_message<T>>
+  broadcast(const selection_message<T>& request)
+  {
+    for (const auto& worker : workers) {
+      write_message(worker.requests, request);
+    }
+    std::vector<selection_message<T>> replies(workers.size());
+    for (std::size_t i{0}; i < workers.size(); ++i) {
+      if (!read_message(workers[i].replies, replies[i])) {
+        throw std::system_error{
+          EPIPE, std::generic_category(), "worker exited"};
+      }
+    }
+    return replies;
+  }
+
+private:
+  struct process {
+    pid_t pid;
+    int   requests;
+    int   replies;
+  };
+
+  /// @brief Blocks SIGPIPE in the calling thread while it lives, a write to
+  /// a pipe without reader then fails with EPIPE.
+  class sigpipe_block {
+  public:
+    sigpipe_block() noexcept
+    {
+      sigemptyset(&sigpipe);
+      sigaddset(&sigpipe, SIGPIPE);
+      sigset_t pending;
+      sigpending(&pending);
+      was_pending = sigismember(&pending, SIGPIPE) == 1;
+      pthread_sigmask(SIG_BLOCK, &sigpipe, &previous);
+    }
+
+    sigpipe_block(const sigpipe_block&)            = delete;
+    sigpipe_block& operator=(const sigpipe_block&) = delete;
+
+    /// @brief Discards the SIGPIPE raised by the writes and restores the
+    /// signal mask.
+    ~sigpipe_block()
+    {
+      sigset_t pending;
+      sigpending(&pending);
+      if (!was_pending && sigismember(&pending, SIGPIPE) == 1) {
+        int signal{0};
+        sigwait(&sigpipe, &signal);
+      }
+      pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+    }
+
+  private:
+    sigset_t sigpipe;
+    sigset_t previous;
+    bool     was_pending{false};
+  };
+
+  pipe_transport() = default;
+
+  void stop() noexcept
+  {
+    for (const auto& worker : workers) {
+      try {
+        write_message(worker.requests,
+                      selection_message<T>{selection_step::stop, {}, {}});
+      }
+      catch (...) {
+        // The worker has exited already.
+      }
+      ::close(worker.requests);
+      ::close(worker.replies);
+      int status{0};
+      while (::waitpid(worker.pid, &status, 0) < 0 && errno == EINTR) {
+      }
+    }
+    workers.clear();
+  }
+
+  static void write_bytes(int fd, const void* data, std::size_t size)
+  {
+    auto bytes{static_cast<const char*>(data)};
+    while (size > 0) {
+      const auto written{::write(fd, bytes, size)};
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        if (errno == EPIPE) {
+          throw std::system_error{
+            EPIPE, std::generic_category(), "worker exited"};
+        }
+        throw std::system_error{errno, std::generic_category(), "write"};
+      }
+      bytes += written;
+      size -= static_cast<std::size_t>(written);
+    }
+  }
+
+  /// @return @c false at the end of the pipe before the first byte.
+  static bool read_bytes(int fd, void* data, std::size_t size)
+  {
+    auto       bytes{static_cast<char*>(data)};
+    const auto first{bytes};
+    while (size > 0) {
+      const auto count{::read(fd, bytes, size)};
+      if (count < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw std::system_error{errno, std::generic_category(), "read"};
+      }
+      if (count == 0) {
+        if (bytes == first) {
+          return false;
+        }
+        throw std::system_error{
+          EPIPE, std::generic_category(), "truncated message"};
+      }
+      bytes += count;
+      size -= static_cast<std::size_t>(count);
+    }
+    return true;
+  }
+
+  static void write_message(int fd, const selection_message<T>& message)
+  {
+    const sigpipe_block block;
+    const std::uint64_t header[3]{static_cast<std::uint64_t>(message.step),
+                                  message.values.size(),
+                                  message.counts.size()};
+    write_bytes(fd, header, sizeof(header));
+    write_bytes(fd, message.values.data(), message.values.size() * sizeof(T));
+    write_bytes(fd,
+                message.counts.data(),
+                message.counts.size() * sizeof(std::uint64_t));
+  }
+
+  static bool read_message(int fd, selection_message<T>& message)
+  {
+    std::uint64_t header[3];
+    if (!read_bytes(fd, header, sizeof(header))) {
+      return false;
+    }
+    message.step = static_cast<selection_step>(header[0]);
+    message.values.resize(header[1]);
+    message.counts.resize(header[2]);
+    return read_bytes(
+             fd, message.values.data(), message.values.size() * sizeof(T))
+           && read_bytes(fd,
+                         message.counts.data(),
+                         message.counts.size() * sizeof(std::uint64_t));
+  }
+
+  std::vector<process> workers;
+};
+#endif
+
+}
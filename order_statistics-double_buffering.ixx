@@ -0,0 +1,212 @@
+/// @file
+/// An order statistics tree that is rebuilt in the background.
+///
+/// The ranks of an order statistics tree keep their positions when elements
+/// are added, so the percentiles of a growing tree drift until the tree is
+/// rebuilt with the ranks of its new size. Rebuilding a large tree takes long
+/// and must not block the writers.
+///
+/// The elements are kept twice: In the active tree, which serves the writers
+/// and the readers, and in a standby buffer. A rebuild takes the standby
+/// buffer to a background thread and turns it into a tree with the new ranks.
+/// Meanwhile new elements go to the active tree and to a delta log. The
+/// background thread replays the delta log into the new tree until it has
+/// caught up. Then the trees are swapped and the elements of the old tree
+/// become the standby buffer of the next rebuild.
+
+/// @cond
+module;
+/// @endcond
+
+// C++ Standard Library.
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/// @cond
+export module order_statistics:double_buffering;
+
+import :containers;
+import :percentiles;
+/// @endcond
+
+export namespace order_statistics {
+
+/// @brief Percentiles of a growing multiset of elements, rebuilt in the
+/// background.
+///
+/// push() and quantile() are thread-safe. They wait at most for the swap of
+/// the trees at the end of a rebuild, which replays at most
+/// swap_replay_limit elements.
+///
+/// @tparam T Type of the elements, must be copyable.
+/// @tparam Compare Type of a binary functor to compare two elements.
+template<typename T, typename Compare = std::less<>>
+class double_buffered_tree {
+public:
+  using value_type = T;
+  using size_type  = std::size_t;
+
+  /// @brief Maximum number of elements the background thread replays while
+  /// the writers wait for the swap.
+  static constexpr size_type swap_replay_limit{64};
+
+  /// @brief Creates an empty tree.
+  /// @param percentiles Percentiles in [0, 1] to maintain, e.g., 0.5 and
+  /// 0.99.
+  /// @param comp Functor to determine which of two elements is considered
+  /// smaller.
+  explicit double_buffered_tree(std::vector<double> percentiles,
+                                Compare             comp = {}) :
+    comp{comp},
+    percentiles{std::move(percentiles)},
+    active{make_generation({})}
+  {
+    if (this->percentiles.empty()) {
+      throw std::invalid_argument{"no percentiles"};
+    }
+    for (const auto p : this->percentiles) {
+      if (!(p >= 0.0 && p <= 1.0)) {
+        throw std::invalid_argument{"percentile must lie in [0, 1]"};
+      }
+    }
+  }
+
+  double_buffered_tree(const double_buffered_tree&)            = delete;
+  double_buffered_tree& operator=(const double_buffered_tree&) = delete;
+
+  /// @brief Waits for a running rebuild.
+  ~double_buffered_tree()
+  {
+    wait();
+  }
+
+  /// @brief Returns the number of elements.
+  size_type size() const
+  {
+    const std::scoped_lock lock{mutex};
+    return active.tree.size();
+  }
+
+  /// @brief Adds @p value.
+  void push(T value)
+  {
+    const std::scoped_lock lock{mutex};
+    (rebuilding ? log : standby).push_back(value);
+    active.tree.push(std::move(value));
+  }
+
+  /// @brief Returns the percentile @p i.
+  ///
+  /// The ranks are those of the size at the end of the last rebuild, e.g.,
+  /// the median of the first 1000 of 1100 elements is the 500th smallest
+  /// element of all 1100 elements.
+  ///
+  /// @param i Index into the percentiles given to the constructor.
+  /// @throws std::length_error if there are no elements.
+  T quantile(size_type i) const
+  {
+    const std::scoped_lock lock{mutex};
+    if (active.tree.empty()) {
+      throw std::length_error{"no elements"};
+    }
+    const auto rank{active.rank_of_percentile[i]};
+    return rank == percentile_ranks::greatest ? active.tree.max()
+                                              : active.tree.at_rank(rank);
+  }
+
+  /// @brief Starts to rebuild the tree with the ranks of its current size in
+  /// a background thread.
+  /// @return @c false if a rebuild is already running.
+  bool rebuild()
+  {
+    const std::scoped_lock lock{mutex};
+    if (rebuilding) {
+      return false;
+    }
+    rebuilding = true;
+    // Joins the thread of the previous rebuild, which has finished.
+    worker = std::jthread{
+      [this, elements = std::move(standby)]() mutable {
+        rebuild_in_background(std::move(elements));
+      }};
+    standby.clear();
+    return true;
+  }
+
+  /// @brief Returns @c true while a rebuild is running.
+  bool is_rebuilding() const
+  {
+    const std::scoped_lock lock{mutex};
+    return rebuilding;
+  }
+
+  /// @brief Waits until a running rebuild has swapped in its tree.
+  void wait()
+  {
+    std::unique_lock lock{mutex};
+    rebuilt.wait(lock, [this] { return !rebuilding; });
+  }
+
+private:
+  /// @brief A tree and the index of the rank of every percentile.
+  struct generation {
+    order_statistics_tree<T, Compare> tree;
+    std::vector<size_type>            rank_of_percentile;
+  };
+
+  /// @brief Builds a tree of @p elements with the ranks of the percentiles.
+  generation make_generation(std::vector<T> elements) const
+  {
+    // The greatest element is the maximum of the last segment, no rank.
+    auto [ranks, index]{
+      make_percentile_ranks(percentiles, elements.size(), false)};
+    return {{std::move(elements), std::move(ranks), comp}, std::move(index)};
+  }
+
+  void rebuild_in_background(std::vector<T> elements)
+  {
+    auto           next{make_generation(std::move(elements))};
+    std::vector<T> delta;
+    for (;;) {
+      next.tree.insert(delta);
+      delta.clear();
+      // The replay during the swap must not reallocate.
+      next.tree.reserve(next.tree.size() + swap_replay_limit);
+
+      const std::scoped_lock lock{mutex};
+      if (log.size() <= swap_replay_limit) {
+        next.tree.insert(log);
+        log.clear();
+        std::swap(active, next);
+        // The old tree holds the same elements as the new one.
+        standby    = next.tree.release();
+        rebuilding = false;
+        rebuilt.notify_all();
+        return;
+      }
+      std::swap(delta, log);
+    }
+  }
+
+  Compare             comp;
+  std::vector<double> percentiles;
+
+  mutable std::mutex      mutex;
+  std::condition_variable rebuilt;
+  generation              active;
+  /// The elements of the active tree while no rebuild is running.
+  std::vector<T> standby;
+  /// The elements added while a rebuild is running.
+  std::vector<T> log;
+  bool           rebuilding{false};
+  std::jthread   worker;
+};
+
+}
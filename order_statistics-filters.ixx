@@ -0,0 +1,345 @@
+/// @file
+/// Sliding window median and percentile filters for images and signals.
+///
+/// Every output pixel is the given percentile of the window of pixels around
+/// the input pixel at the same position. Pixels outside the image are replaced
+/// by the nearest pixel at the border.
+///
+/// Instead of selecting the percentile of every window from scratch, the
+/// window is kept in an order statistics tree with a single rank. The window
+/// slides in a serpentine order through a band of rows: To the right along
+/// one row, one row down, to the left along the next row and so on. Each step
+/// replaces one column (row) of the window, i.e., for a window of @c w x @c h
+/// pixels only @c h (@c w) elements are erased from and inserted into the tree
+/// instead of selecting from all @c w * @c h pixels.
+///
+/// The elements of the tree pack the ordered bits of the pixel and the slot of
+/// the pixel in the window into a single 64 bit integer. Comparisons are
+/// integer comparisons and the slot is used as a handle to track the position
+/// of every pixel in the tree. The bands of rows are filtered in parallel.
+
+/// @cond
+module;
+/// @endcond
+
+// C++ Standard Library.
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/// @cond
+export module order_statistics:filters;
+
+import :minmax_heaps;
+import :packed_keys;
+import :percentiles;
+import :tracking;
+import :trees;
+/// @endcond
+
+namespace order_statistics {
+
+/// @brief Returns the bits of @p pixel ordered like the pixels.
+template<typename Pixel>
+std::uint32_t pixel_bits(Pixel pixel) noexcept
+{
+  if constexpr (std::is_floating_point_v<Pixel>) {
+    return order_preserving_bits(static_cast<float>(pixel));
+  }
+  else if constexpr (std::is_signed_v<Pixel>) {
+    return order_preserving_bits(static_cast<std::int32_t>(pixel));
+  }
+  else {
+    return order_preserving_bits(static_cast<std::uint32_t>(pixel));
+  }
+}
+
+/// @brief Reverts pixel_bits().
+template<typename Pixel>
+Pixel from_pixel_bits(std::uint32_t bits) noexcept
+{
+  if constexpr (std::is_floating_point_v<Pixel>) {
+    return static_cast<Pixel>(from_order_preserving_bits<float>(bits));
+  }
+  else if constexpr (std::is_signed_v<Pixel>) {
+    return static_cast<Pixel>(from_order_preserving_bits<std::int32_t>(bits));
+  }
+  else {
+    return static_cast<Pixel>(bits);
+  }
+}
+
+/// @brief Returns the slot stored in the lower bits of a window element.
+struct window_slot {
+  std::size_t operator()(std::uint64_t element) const noexcept
+  {
+    return static_cast<std::uint32_t>(element);
+  }
+};
+
+/// @brief An order statistics tree of the pixels of a sliding window.
+template<typename Pixel>
+class window_tree {
+public:
+  window_tree(std::size_t size, std::size_t rank) :
+    elements(size), positions(size), rank{rank}
+  {
+  }
+
+  /// @brief Sets the pixel in @p slot without restoring the tree, see build().
+  void set(std::size_t slot, Pixel pixel)
+  {
+    elements[slot] = element(slot, pixel);
+  }
+
+  /// @brief Turns the pixels set so far into an order statistics tree.
+  void build()
+  {
+    track_positions(
+      elements.begin(), elements.end(), positions.begin(), window_slot{});
+    const auto first{begin()};
+    ranks[0] = first + static_cast<std::ptrdiff_t>(rank);
+    make_order_statistics_tree(
+      first, end(), ranks.begin(), ranks.begin() + rank_count());
+  }
+
+  /// @brief Replaces the pixel in @p slot by @p pixel.
+  void replace(std::size_t slot, Pixel pixel)
+  {
+    const auto e{element(slot, pixel)};
+    const auto first{begin()};
+    const auto last{end()};
+    const auto it{first + positions[slot]};
+    if (*it.base() != e) {
+      *it = e;
+      update_order_statistics_tree(
+        first, it, last, ranks.begin(), ranks.begin() + rank_count());
+    }
+  }
+
+  /// @brief Returns the pixel at the rank of the tree.
+  Pixel percentile() const
+  {
+    const auto e{rank_count() == 1
+                   ? elements[rank]
+                   : *max_mm_heap(elements.begin(), elements.end())};
+    return from_pixel_bits<Pixel>(static_cast<std::uint32_t>(e >> 32));
+  }
+
+private:
+  using iterator = tracking_iterator<std::vector<std::uint64_t>::iterator,
+                                     std::vector<std::uint32_t>::iterator,
+                                     window_slot>;
+
+  static std::uint64_t element(std::size_t slot, Pixel pixel) noexcept
+  {
+    return std::uint64_t{pixel_bits(pixel)} << 32 | slot;
+  }
+
+  /// @brief The greatest element is the maximum of the min-max heap of the
+  /// whole window, it needs no rank.
+  std::ptrdiff_t rank_count() const noexcept
+  {
+    return rank + 1 < elements.size() ? 1 : 0;
+  }
+
+  iterator begin()
+  {
+    return {elements.begin(), elements.begin(), positions.begin()};
+  }
+
+  iterator end()
+  {
+    return {elements.begin(), elements.end(), positions.begin()};
+  }
+
+  std::vector<std::uint64_t> elements;
+  std::vector<std::uint32_t> positions;
+  std::size_t                rank;
+  std::array<iterator, 1>    ranks;
+};
+
+/// @brief Filters the rows [@p y_first, @p y_last) of the image.
+template<typename Pixel>
+void filter_rows(std::span<const Pixel> input,
+                 std::span<Pixel>       output,
+                 std::size_t            width,
+                 std::size_t            radius_x,
+                 std::size_t            radius_y,
+                 std::size_t            rank,
+                 std::size_t            y_first,
+                 std::size_t            y_last)
+{
+  const auto height{static_cast<std::ptrdiff_t>(input.size() / width)};
+  const auto w{static_cast<std::ptrdiff_t>(width)};
+  const auto rx{static_cast<std::ptrdiff_t>(radius_x)};
+  const auto ry{static_cast<std::ptrdiff_t>(radius_y)};
+  const auto window_width{2 * rx + 1};
+  const auto window_height{2 * ry + 1};
+
+  // Coordinates may lie outside of the image by up to the radius.
+  const auto pixel{[&](std::ptrdiff_t x, std::ptrdiff_t y) {
+    x = std::clamp<std::ptrdiff_t>(x, 0, w - 1);
+    y = std::clamp<std::ptrdiff_t>(y, 0, height - 1);
+    return input[static_cast<std::size_t>(y * w + x)];
+  }};
+  const auto slot{[&](std::ptrdiff_t x, std::ptrdiff_t y) {
+    return static_cast<std::size_t>((x + rx) % window_width
+                                    + (y + ry) % window_height * window_width);
+  }};
+
+  window_tree<Pixel> tree{
+    static_cast<std::size_t>(window_width * window_height), rank};
+  std::ptrdiff_t x{0};
+  std::ptrdiff_t dx{1};
+  auto           y{static_cast<std::ptrdiff_t>(y_first)};
+  for (auto j{-ry}; j <= ry; ++j) {
+    for (auto i{-rx}; i <= rx; ++i) {
+      tree.set(slot(i, y + j), pixel(i, y + j));
+    }
+  }
+  tree.build();
+
+  for (; y < static_cast<std::ptrdiff_t>(y_last); ++y) {
+    if (y != static_cast<std::ptrdiff_t>(y_first)) {
+      for (auto i{x - rx}; i <= x + rx; ++i) {
+        tree.replace(slot(i, y + ry), pixel(i, y + ry));
+      }
+    }
+    for (std::ptrdiff_t n{0}; n < w; ++n) {
+      output[static_cast<std::size_t>(y * w + x)] = tree.percentile();
+      if (n + 1 < w) {
+        const auto column{dx > 0 ? x + rx + 1 : x - rx - 1};
+        for (auto j{y - ry}; j <= y + ry; ++j) {
+          tree.replace(slot(column, j), pixel(column, j));
+        }
+        x += dx;
+      }
+    }
+    dx = -dx;
+  }
+}
+
+}
+
+export namespace order_statistics {
+
+/// @brief Applies a sliding window percentile filter to an image.
+///
+/// The window spans (2 * @p radius_x + 1) x (2 * @p radius_y + 1) pixels.
+/// For a one-dimensional signal pass the signal's length as @p width and 0 as
+/// @p radius_y.
+///
+/// @tparam Pixel An arithmetic type of at most 32 bits, e.g., @c std::uint8_t,
+/// @c std::uint16_t or @c float.
+/// @param [in] input The pixels of the image, row by row.
+/// @param [out] output The filtered pixels, same size as @p input.
+/// @param width Number of pixels per row.
+/// @param radius_x Horizontal radius of the window.
+/// @param radius_y Vertical radius of the window.
+/// @param percentile Percentile in [0, 1] to select from every window, e.g.,
+/// 0.5 for the median.
+/// @param threads Number of threads, 0 for one thread per hardware thread.
+template<typename Pixel>
+void percentile_filter(std::span<const Pixel> input,
+                       std::span<Pixel>       output,
+                       std::size_t            width,
+                       std::size_t            radius_x,
+                       std::size_t            radius_y,
+                       double                 percentile,
+                       unsigned               threads = 0)
+{
+  static_assert(std::is_arithmetic_v<Pixel> && sizeof(Pixel) <= 4,
+                "Pixel must be an arithmetic type of at most 32 bits");
+
+  if (input.size() != output.size()) {
+    throw std::invalid_argument{"input and output differ in size"};
+  }
+  if (width == 0 || input.size() % width != 0) {
+    throw std::invalid_argument{"size is not a multiple of width"};
+  }
+  if (!(percentile >= 0.0 && percentile <= 1.0)) {
+    throw std::invalid_argument{"percentile must lie in [0, 1]"};
+  }
+  const auto window{(2 * radius_x + 1) * (2 * radius_y + 1)};
+  if (window > std::numeric_limits<std::uint32_t>::max()) {
+    throw std::invalid_argument{"window too large"};
+  }
+  if (input.empty()) {
+    return;
+  }
+
+  const auto height{input.size() / width};
+  const auto rank{percentile_rank(percentile, window)};
+
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  // Every band pays for building its tree, so keep the bands high enough.
+  const auto bands{std::clamp<std::size_t>(
+    height / (2 * radius_y + 1), 1, threads)};
+  const auto band_height{(height + bands - 1) / bands};
+
+  // The exception of every band, rethrown after all bands are joined.
+  std::vector<std::exception_ptr> failures(bands);
+  const auto                      filter_band{[&](std::size_t band) {
+    const auto y{band * band_height};
+    try {
+      filter_rows(input,
+                  output,
+                  width,
+                  radius_x,
+                  radius_y,
+                  rank,
+                  y,
+                  std::min(y + band_height, height));
+    }
+    catch (...) {
+      failures[band] = std::current_exception();
+    }
+  }};
+  {
+    std::vector<std::jthread> workers;
+    for (std::size_t band{1}; band * band_height < height; ++band) {
+      workers.emplace_back(filter_band, band);
+    }
+    filter_band(0);
+  }
+  for (const auto& failure : failures) {
+    if (failure) {
+      std::rethrow_exception(failure);
+    }
+  }
+}
+
+/// @brief Applies a sliding window median filter to an image.
+///
+/// The window spans (2 * @p radius + 1) x (2 * @p radius + 1) pixels, see
+/// percentile_filter().
+///
+/// @tparam Pixel An arithmetic type of at most 32 bits, e.g., @c std::uint8_t,
+/// @c std::uint16_t or @c float.
+/// @param [in] input The pixels of the image, row by row.
+/// @param [out] output The filtered pixels, same size as @p input.
+/// @param width Number of pixels per row.
+/// @param radius Radius of the window.
+/// @param threads Number of threads, 0 for one thread per hardware thread.
+template<typename Pixel>
+void median_filter(std::span<const Pixel> input,
+                   std::span<Pixel>       output,
+                   std::size_t            width,
+                   std::size_t            radius,
+                   unsigned               threads = 0)
+{
+  percentile_filter(input, output, width, radius, radius, 0.5, threads);
+}
+
+}
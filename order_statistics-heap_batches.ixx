@@ -0,0 +1,226 @@
+/// @file
+/// Operations on many independent min-max heaps in lockstep.
+///
+/// Pushing to or popping from a small heap that is not in the cache waits for
+/// a cache miss on every level of the sift. When thousands of heaps are
+/// updated, e.g., one heap per connection, the sifts of a group of heaps are
+/// advanced together: First the nodes of the next level of every heap of the
+/// group are prefetched, then every sift moves one level. The misses of the
+/// group overlap instead of adding up.
+
+/// @cond
+module;
+/// @endcond
+
+// C++ Standard Library.
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <span>
+
+/// @cond
+export module order_statistics:heap_batches;
+
+import :minmax_heaps;
+/// @endcond
+
+namespace order_statistics {
+
+/// @brief Prefetches the node at @p it if the nodes are contiguous in memory.
+template<typename RandomIt>
+void prefetch_node(RandomIt it) noexcept
+{
+  if constexpr (std::contiguous_iterator<RandomIt>) {
+    prefetch(std::to_address(it));
+  }
+}
+
+/// @brief State of a single sift of a batch.
+template<typename RandomIt>
+struct sift {
+  RandomIt first;
+  /// The node of the item that moves, @c last if the sift is done.
+  RandomIt it;
+  RandomIt last;
+  /// @c true if the item moves down, @c false if it moves up.
+  bool down;
+  /// @c true if the item moves along the max levels.
+  bool max_levels;
+
+  bool done() const
+  {
+    return it == last;
+  }
+
+  /// @brief Prefetches the nodes the next step() compares.
+  void prefetch() const
+  {
+    const auto d{std::distance(first, it)};
+    if (down) {
+      if (d * 2 + 1 < std::distance(first, last)) {
+        prefetch_node(first + (d * 2 + 1));
+      }
+      // The grandchildren may span two cache lines.
+      if (d * 4 + 3 < std::distance(first, last)) {
+        prefetch_node(first + (d * 4 + 3));
+      }
+      if (d * 4 + 6 < std::distance(first, last)) {
+        prefetch_node(first + (d * 4 + 6));
+      }
+    }
+    else if (d > 2) {
+      prefetch_node(grandparent(first, it));
+    }
+  }
+
+  template<typename Compare>
+  void step(Compare comp)
+  {
+    using namespace std::placeholders;
+
+    if (down) {
+      it = heapify_step(first, it, last, comp);
+    }
+    else if (max_levels) {
+      it = push_mm_heap_step(first, it, last, std::bind(comp, _2, _1));
+    }
+    else {
+      it = push_mm_heap_step(first, it, last, comp);
+    }
+  }
+};
+
+}
+
+export namespace order_statistics {
+
+/// @brief An operation on a min-max heap, see heap_task.
+enum class heap_operation {
+  /// Inserts the element at (@c last - 1), see push_mm_heap().
+  push,
+  /// Moves the smallest element to (@c last - 1), see pop_mm_heap().
+  pop,
+  /// Moves the greatest element to (@c last - 1), see pop_max_mm_heap().
+  pop_max
+};
+
+/// @brief An operation on the min-max heap [@c first, @c last).
+template<typename RandomIt>
+struct heap_task {
+  RandomIt       first;
+  RandomIt       last;
+  heap_operation operation;
+};
+
+/// @brief Number of heaps batch_mm_heap() advances in lockstep.
+inline constexpr std::size_t heap_batch_group_size{16};
+
+/// @brief Applies the operations @p tasks to their min-max heaps.
+///
+/// The result is the same as calling push_mm_heap(), pop_mm_heap() or
+/// pop_max_mm_heap() for every task. The heaps of a group of
+/// heap_batch_group_size tasks are processed in lockstep: Before any sift of
+/// the group compares the nodes of its next level, these nodes are prefetched
+/// for all sifts of the group.
+///
+/// @tparam RandomIt A @c RandomAccessIterator type. Prefetching requires a
+/// @c ContiguousIterator, other iterators are processed without.
+/// @tparam Compare Type of a binary functor to compare two elements in the
+/// heaps.
+/// @param tasks The operations. The heaps of the tasks must not overlap.
+/// @param comp Functor to determine which of two items in the heap is
+/// considered smaller.
+template<typename RandomIt, typename Compare>
+void batch_mm_heap(std::span<const heap_task<RandomIt>> tasks, Compare comp)
+{
+  using std::swap;
+
+  for (std::size_t g{0}; g < tasks.size(); g += heap_batch_group_size) {
+    const auto group{
+      tasks.subspan(g, std::min(heap_batch_group_size, tasks.size() - g))};
+    std::array<sift<RandomIt>, heap_batch_group_size> sifts;
+
+    // The first step touches the last node and the root (pop) or its parent
+    // (push).
+    for (const auto& task : group) {
+      if (task.first != task.last) {
+        prefetch_node(task.last - 1);
+        prefetch_node(task.operation == heap_operation::push
+                        ? parent(task.first, task.last - 1)
+                        : task.first);
+      }
+    }
+
+    for (std::size_t i{0}; i < group.size(); ++i) {
+      const auto [first, last, operation]{group[i]};
+      auto& s{sifts[i]};
+      s = {first, last, last, false, false};
+      if (std::distance(first, last) < 2) {
+        continue;
+      }
+
+      switch (operation) {
+      case heap_operation::push: {
+        // An item on a min level that is greater than its parent moves up
+        // the max levels and vice versa.
+        const auto it{last - 1};
+        const auto parent_it{parent(first, it)};
+        const auto min_level{is_min_level(first, it)};
+        if (min_level ? comp(*parent_it, *it) : comp(*it, *parent_it)) {
+          swap(*it, *parent_it);
+          s.it         = parent_it;
+          s.max_levels = min_level;
+        }
+        else {
+          s.it         = it;
+          s.max_levels = !min_level;
+        }
+        break;
+      }
+      case heap_operation::pop:
+        swap(*first, *(last - 1));
+        s = {first, first, last - 1, true, false};
+        break;
+      case heap_operation::pop_max:
+        if (std::distance(first, last) > 2) {
+          const auto max_it{max_mm_heap(first, last, comp)};
+          swap(*max_it, *(last - 1));
+          s = {first, max_it, last - 1, true, false};
+        }
+        break;
+      }
+    }
+
+    for (auto active{true}; active;) {
+      active = false;
+      for (std::size_t i{0}; i < group.size(); ++i) {
+        if (!sifts[i].done()) {
+          sifts[i].prefetch();
+        }
+      }
+      for (std::size_t i{0}; i < group.size(); ++i) {
+        if (!sifts[i].done()) {
+          sifts[i].step(comp);
+          active = active || !sifts[i].done();
+        }
+      }
+    }
+  }
+}
+
+/// @brief Applies the operations @p tasks to their min-max heaps.
+///
+/// Uses std::less to determine the order of elements.
+///
+/// @tparam RandomIt A @c RandomAccessIterator type.
+/// @param tasks The operations. The heaps of the tasks must not overlap.
+template<typename RandomIt>
+void batch_mm_heap(std::span<const heap_task<RandomIt>> tasks)
+{
+  batch_mm_heap(tasks, std::less<>{});
+}
+
+}
@@ -0,0 +1,292 @@
+/// @file
+/// Parsing of numbers from text into the buffer a tree is built in.
+///
+/// The text, e.g., a mapped CSV file, is split into chunks at line breaks.
+/// Every chunk is handled by a task of an executor in two passes:
+///
+/// 1. The line breaks of every chunk are counted, 16 bytes at a time with
+///    SSE2 where available. The prefix sums of the counts are the positions
+///    of the first value of every chunk in the output buffer.
+/// 2. Every chunk parses its lines with std::from_chars, straight into its
+///    part of the buffer.
+///
+/// The buffer is allocated once and not initialized, the tasks are the first
+/// to touch its pages. Blank lines leave gaps in the buffer, which are
+/// closed at the end.
+
+/// @cond
+module;
+/// @endcond
+
+// C++ Standard Library.
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+// Intel Intrinsics.
+#if defined(__SSE2__) || defined(_M_X64) \
+  || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ORDER_STATISTICS_SSE2
+#include <emmintrin.h>
+#endif
+
+/// @cond
+export module order_statistics:ingest;
+/// @endcond
+
+namespace order_statistics {
+
+/// @brief Returns the number of bytes @p c in [@p first, @p last).
+inline std::size_t
+count_bytes(const char* first, const char* last, char c) noexcept
+{
+  std::size_t count{0};
+#if defined(ORDER_STATISTICS_SSE2)
+  const auto pattern{_mm_set1_epi8(c)};
+  for (; last - first >= 16; first += 16) {
+    const auto block{
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(first))};
+    const auto mask{static_cast<unsigned>(
+      _mm_movemask_epi8(_mm_cmpeq_epi8(block, pattern)))};
+    count += static_cast<std::size_t>(std::popcount(mask));
+  }
+#endif
+  return count + static_cast<std::size_t>(std::count(first, last, c));
+}
+
+/// @brief Returns the first byte @p a or @p b in [@p first, @p last), or
+/// @p last.
+inline const char*
+find_either(const char* first, const char* last, char a, char b) noexcept
+{
+#if defined(ORDER_STATISTICS_SSE2)
+  const auto pattern_a{_mm_set1_epi8(a)};
+  const auto pattern_b{_mm_set1_epi8(b)};
+  for (; last - first >= 16; first += 16) {
+    const auto block{
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(first))};
+    const auto mask{static_cast<unsigned>(_mm_movemask_epi8(
+      _mm_or_si128(_mm_cmpeq_epi8(block, pattern_a),
+                   _mm_cmpeq_epi8(block, pattern_b))))};
+    if (mask != 0) {
+      return first + std::countr_zero(mask);
+    }
+  }
+#endif
+  return std::find_if(
+    first, last, [a, b](const char c) { return c == a || c == b; });
+}
+
+/// @brief Returns @c true for the blanks around a value.
+constexpr bool is_blank(char c) noexcept
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+}
+
+export namespace order_statistics {
+
+/// @brief Default number of bytes of text parsed by a single task.
+inline constexpr std::size_t ingest_chunk_size{1 << 20};
+
+/// @brief An executor that executes tasks immediately on the calling thread,
+/// e.g., for work that is already part of a task of another executor.
+struct inline_executor {
+  /// @brief Returns 1, the calling thread is the only thread.
+  std::size_t size() const noexcept
+  {
+    return 1;
+  }
+
+  template<typename F>
+  void run(F&& f)
+  {
+    f();
+  }
+
+  template<typename F>
+  void spawn(F&& f)
+  {
+    f();
+  }
+};
+
+/// @brief Where the values are in a line of text.
+struct csv_format {
+  /// Separates the columns.
+  char delimiter{','};
+  /// Zero-based column of the values.
+  std::size_t column{0};
+  /// Skips the first line.
+  bool header{false};
+};
+
+/// @brief Values parsed from text, in a buffer that a tree can be built in.
+/// @tparam T Type of the values.
+template<typename T>
+struct ingested_column {
+  std::unique_ptr<T[]> values;
+  std::size_t          size{0};
+
+  /// @brief Returns the values.
+  std::span<T> elements() const noexcept
+  {
+    return {values.get(), size};
+  }
+};
+
+}
+
+namespace order_statistics {
+
+/// @brief Parses the lines of @p text, the first of which is the line
+/// @p first_line of the input, see parse_column().
+template<typename T, typename Executor>
+ingested_column<T> parse_lines(std::string_view  text,
+                               const csv_format& format,
+                               Executor&         executor,
+                               std::size_t       chunk_size,
+                               std::size_t       first_line)
+{
+  const auto first{text.data()};
+  const auto last{text.data() + text.size()};
+
+  // Chunks of whole lines.
+  std::vector<const char*> bounds{first};
+  if (format.header) {
+    const auto header_end{std::find(first, last, '\n')};
+    bounds.back() = header_end == last ? last : header_end + 1;
+  }
+  while (static_cast<std::size_t>(last - bounds.back()) > chunk_size) {
+    const auto line_end{
+      std::find(bounds.back() + chunk_size, last, '\n')};
+    bounds.push_back(line_end == last ? last : line_end + 1);
+  }
+  if (bounds.back() != last) {
+    bounds.push_back(last);
+  }
+  const auto chunks{bounds.size() - 1};
+
+  // The lines of every chunk, a last line without line break included.
+  std::vector<std::size_t> offsets(chunks + 1, 0);
+  executor.run([&] {
+    for (std::size_t i{0}; i < chunks; ++i) {
+      executor.spawn([&, i] {
+        offsets[i + 1] = count_bytes(bounds[i], bounds[i + 1], '\n')
+                         + (bounds[i + 1][-1] != '\n' ? 1 : 0);
+      });
+    }
+  });
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+  ingested_column<T> result{
+    std::make_unique_for_overwrite<T[]>(offsets.back()), 0};
+  std::vector<std::size_t> sizes(chunks, 0);
+  executor.run([&] {
+    for (std::size_t i{0}; i < chunks; ++i) {
+      executor.spawn([&, i] {
+        auto out{result.values.get() + offsets[i]};
+        auto line{first_line + offsets[i] + (format.header ? 1 : 0)};
+        for (auto it{bounds[i]}; it != bounds[i + 1]; ++line) {
+          const auto line_end{static_cast<const char*>(std::memchr(
+            it, '\n', static_cast<std::size_t>(bounds[i + 1] - it)))};
+          const auto end{line_end == nullptr ? bounds[i + 1] : line_end};
+          const auto error{[&] {
+            return std::invalid_argument{
+              "line " + std::to_string(line) + ": no number in column "
+              + std::to_string(format.column)};
+          }};
+
+          const auto next{end == bounds[i + 1] ? end : end + 1};
+          if (std::all_of(it, end, is_blank)) {
+            it = next;
+            continue;
+          }
+
+          auto field{it};
+          for (std::size_t column{0}; column < format.column; ++column) {
+            field = find_either(field, end, format.delimiter, '\n');
+            if (field == end) {
+              throw error();
+            }
+            ++field;
+          }
+          while (field != end && is_blank(*field)) {
+            ++field;
+          }
+          const auto parsed{std::from_chars(field, end, *out)};
+          auto       rest{parsed.ptr};
+          while (rest != end && is_blank(*rest)) {
+            ++rest;
+          }
+          if (parsed.ec != std::errc{}
+              || (rest != end && *rest != format.delimiter)) {
+            throw error();
+          }
+          ++out;
+          it = next;
+        }
+        sizes[i] = static_cast<std::size_t>(
+          out - (result.values.get() + offsets[i]));
+      });
+    }
+  });
+
+  // Closes the gaps of blank lines.
+  for (std::size_t i{0}; i < chunks; ++i) {
+    if (result.size != offsets[i]) {
+      std::memmove(result.values.get() + result.size,
+                   result.values.get() + offsets[i],
+                   sizes[i] * sizeof(T));
+    }
+    result.size += sizes[i];
+  }
+  return result;
+}
+
+}
+
+export namespace order_statistics {
+
+/// @brief Parses the column @c format.column of every line of @p text with
+/// the tasks of @p executor.
+///
+/// Blank lines are skipped. Blanks around a value and a carriage return at
+/// the end of a line are ignored.
+///
+/// @tparam T An arithmetic type std::from_chars() supports.
+/// @tparam Executor See parallel_make_order_statistics_tree().
+/// @param chunk_size Number of bytes of text parsed by a single task.
+/// @throws std::invalid_argument if a line holds no number in the column.
+template<typename T, typename Executor>
+ingested_column<T>
+parse_column(std::string_view  text,
+             const csv_format& format,
+             Executor&         executor,
+             std::size_t       chunk_size = ingest_chunk_size)
+{
+  return parse_lines<T>(text, format, executor, chunk_size, 1);
+}
+
+/// @brief Parses the column @c format.column of every line of @p text on
+/// the calling thread, see parse_column().
+template<typename T>
+ingested_column<T> parse_column(std::string_view  text,
+                                const csv_format& format = {})
+{
+  inline_executor executor;
+  return parse_lines<T>(text, format, executor, text.size() + 1, 1);
+}
+
+}
@@ -0,0 +1,259 @@
+/// @file
+/// Latency histograms of the operations of the containers.
+///
+/// If the library is compiled with @c ORDER_STATISTICS_LATENCY defined, the
+/// containers time each of their operations with the time stamp counter of
+/// the CPU and count the times in a latency_histogram per operation.
+/// Otherwise the recorder of a container is an empty object, the operations
+/// read no clock and latencies() returns empty histograms.
+///
+/// A latency_histogram is log-linear: Every power of two is divided into 16
+/// buckets of equal width, so a quantile is at most 1/16 above the true
+/// latency, whether it is 20 ns or 20 ms. Recording a time is a bit scan and
+/// an increment, without allocation.
+///
+/// The time stamp counter is read without serialization, which costs a few
+/// nanoseconds but lets the CPU overlap the read with the operation. The
+/// ticks are converted to nanoseconds only when quantiles are read.
+
+/// @cond
+module;
+/// @endcond
+
+// C++ Standard Library.
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+// Intel Intrinsics.
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define ORDER_STATISTICS_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define ORDER_STATISTICS_TSC
+#endif
+
+/// @cond
+export module order_statistics:latency;
+
+import :percentiles;
+/// @endcond
+
+export namespace order_statistics {
+
+/// @brief @c true if the containers record the latencies of their
+/// operations, i.e., if @c ORDER_STATISTICS_LATENCY is defined.
+#if defined(ORDER_STATISTICS_LATENCY)
+inline constexpr bool record_latencies{true};
+#else
+inline constexpr bool record_latencies{false};
+#endif
+
+/// @brief Returns the time stamp counter of the CPU, or the nanoseconds of
+/// std::chrono::steady_clock on CPUs without one.
+inline std::uint64_t read_ticks() noexcept
+{
+#if defined(ORDER_STATISTICS_TSC)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  std::uint64_t ticks;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+  return ticks;
+#else
+  return static_cast<std::uint64_t>(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch())
+      .count());
+#endif
+}
+
+/// @brief Returns the nanoseconds per tick of read_ticks().
+///
+/// The first call measures the ticks of 10 ms of std::chrono::steady_clock.
+inline double nanoseconds_per_tick()
+{
+  static const auto result{[] {
+    const auto start{std::chrono::steady_clock::now()};
+    const auto start_ticks{read_ticks()};
+    auto       now{start};
+    while (now - start < std::chrono::milliseconds{10}) {
+      now = std::chrono::steady_clock::now();
+    }
+    const auto ticks{read_ticks() - start_ticks};
+    return ticks == 0
+             ? 1.0
+             : std::chrono::duration<double, std::nano>(now - start).count()
+                 / static_cast<double>(ticks);
+  }()};
+  return result;
+}
+
+}
+
+namespace order_statistics {
+
+/// @brief log2 of the number of buckets of every power of two.
+constexpr int latency_sub_bucket_bits{4};
+
+/// @brief Number of buckets of every power of two.
+constexpr std::size_t latency_sub_buckets{1u << latency_sub_bucket_bits};
+
+/// @brief Longer latencies are counted as this one, about a second.
+constexpr std::uint64_t max_latency_ticks{(std::uint64_t{1} << 32) - 1};
+
+/// @brief Returns the bucket of @p ticks: The values below
+/// 2 * latency_sub_buckets have buckets of their own, the others keep their
+/// latency_sub_bucket_bits + 1 most significant bits.
+constexpr std::size_t latency_bucket(std::uint64_t ticks) noexcept
+{
+  const auto shift{std::max(
+    static_cast<int>(std::bit_width(ticks)) - (latency_sub_bucket_bits + 1),
+    0)};
+  return static_cast<std::size_t>(shift) * latency_sub_buckets
+         + static_cast<std::size_t>(ticks >> shift);
+}
+
+/// @brief Returns the greatest number of ticks of the bucket @p i.
+constexpr std::uint64_t latency_upper_bound(std::size_t i) noexcept
+{
+  if (i < 2 * latency_sub_buckets) {
+    return i;
+  }
+  const auto shift{i / latency_sub_buckets - 1};
+  return ((i % latency_sub_buckets + latency_sub_buckets + 1) << shift) - 1;
+}
+
+/// @brief Number of buckets of a latency_histogram.
+constexpr std::size_t latency_buckets{latency_bucket(max_latency_ticks) + 1};
+
+}
+
+export namespace order_statistics {
+
+/// @brief A log-linear histogram of latencies in ticks of read_ticks().
+class latency_histogram {
+public:
+  /// @brief Counts a latency of @p ticks.
+  void record(std::uint64_t ticks) noexcept
+  {
+    ++counts[latency_bucket(std::min(ticks, max_latency_ticks))];
+    ++total;
+  }
+
+  /// @brief Returns the number of recorded latencies.
+  std::uint64_t count() const noexcept
+  {
+    return total;
+  }
+
+  /// @brief Returns the latency of the percentile @p p in nanoseconds, 0 if
+  /// no latency was recorded.
+  ///
+  /// The percentile is the latency of rank percentile_rank(p, count()),
+  /// rounded up to the upper bound of its bucket.
+  /// @throws std::invalid_argument if @p p is not in [0, 1].
+  double quantile(double p) const
+  {
+    if (!(p >= 0.0 && p <= 1.0)) {
+      throw std::invalid_argument{"percentile must lie in [0, 1]"};
+    }
+    if (total == 0) {
+      return 0.0;
+    }
+    const auto rank{percentile_rank(p, static_cast<std::size_t>(total))};
+    std::uint64_t below{0};
+    std::size_t   i{0};
+    while (below + counts[i] <= rank) {
+      below += counts[i++];
+    }
+    return static_cast<double>(latency_upper_bound(i))
+           * nanoseconds_per_tick();
+  }
+
+  /// @brief Forgets all recorded latencies.
+  void reset() noexcept
+  {
+    counts.fill(0);
+    total = 0;
+  }
+
+private:
+  std::array<std::uint64_t, latency_buckets> counts{};
+  std::uint64_t                              total{0};
+};
+
+/// @brief The latency histograms of the operations of a container, empty
+/// unless record_latencies is @c true.
+/// @tparam Operation An enumeration of the operations whose last value is
+/// @c count.
+template<typename Operation>
+class latency_recorder {
+public:
+  /// @brief Records the time from its construction to its destruction.
+  class timer {
+  public:
+    timer(const timer&)            = delete;
+    timer& operator=(const timer&) = delete;
+
+    ~timer()
+    {
+      histogram.record(read_ticks() - start);
+    }
+
+  private:
+    friend class latency_recorder;
+
+    explicit timer(latency_histogram& histogram) noexcept :
+      histogram{histogram}, start{read_ticks()}
+    {
+    }
+
+    latency_histogram& histogram;
+    std::uint64_t      start;
+  };
+
+  /// @brief Returns a timer that records the latency of @p operation until
+  /// it is destroyed, or nothing if latencies are not recorded.
+  auto time(Operation operation) noexcept
+  {
+    if constexpr (record_latencies) {
+      return timer{histograms[static_cast<std::size_t>(operation)]};
+    }
+    else {
+      return 0;
+    }
+  }
+
+  /// @brief Returns the histogram of @p operation.
+  const latency_histogram& histogram(Operation operation) const noexcept
+  {
+    if constexpr (record_latencies) {
+      return histograms[static_cast<std::size_t>(operation)];
+    }
+    else {
+      static const latency_histogram empty;
+      return empty;
+    }
+  }
+
+  /// @brief Forgets the latencies of all operations.
+  void reset() noexcept
+  {
+    for (auto& h : histograms) {
+      h.reset();
+    }
+  }
+
+private:
+  static constexpr auto operations{
+    record_latencies ? static_cast<std::size_t>(Operation::count) : 0};
+
+  std::array<latency_histogram, operations> histograms;
+};
+
+}
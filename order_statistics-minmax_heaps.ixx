@@ -18,10 +18,14 @@ module;
 /// @endcond
 
 // C++ Standard Library.
-#include <cmath>
+#include <bit>
 #include <functional>
 #include <iterator>
 
+#if defined(_M_IX86) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
 /// @cond
 export module order_statistics:minmax_heaps;
 /// @endcond
@@ -33,10 +37,9 @@ namespace order_statistics {
 template<typename RandomIt>
 bool is_min_level(RandomIt first, RandomIt it)
 {
-  return static_cast<unsigned long long>(
-           std::log2(std::distance(first, it) + 1))
-           % 2
-         == 0;
+  const auto depth{std::bit_width(
+    static_cast<unsigned long long>(std::distance(first, it)) + 1)};
+  return depth % 2 == 1;
 }
 
 /// @brief Returns @c true if @p it still has children inside the heap [@p
@@ -63,36 +66,10 @@ RandomIt parent(RandomIt first, RandomIt it)
 template<typename RandomIt>
 bool is_grandchild(RandomIt first, RandomIt it, RandomIt it2)
 {
-  return parent(first, parent(first, it)) == it2;
-}
-
-/// @brief Checks if a predicate @c pred holds for all child nodes of @p it in the
-/// min-max heap [@c first, @c last).
-template<typename RandomIt, typename Predicate>
-bool for_all_children(RandomIt  first,
-                      RandomIt  it,
-                      RandomIt  last,
-                      Predicate pred)
-{
-  const auto d0{std::distance(first, it)};
-  const auto d1{std::distance(first, last)};
-  if (d0 * 2 + 2 < d1) {
-    auto left_child{first};
-    std::advance(left_child, d0 * 2 + 1);
-    auto right_child{left_child};
-    std::advance(right_child, 1);
-    return pred(*left_child) && pred(*right_child)
-           && for_all_children(first, left_child, last, pred)
-           && for_all_children(first, right_child, last, pred);
-  }
-  else if (d0 * 2 + 1 < d1) {
-    auto left_child{first};
-    std::advance(left_child, d0 * 2 + 1);
-    return pred(*left_child) && for_all_children(first, left_child, last, pred);
-  }
-  else {
-    return true;
-  }
+  // The children of the root have no grandparent, parent() of the root is the
+  // root itself.
+  return std::distance(first, it) > 2
+         && parent(first, parent(first, it)) == it2;
 }
 
 /// @brief Returns an iterator to the grandparent node of @p it in the min-max
@@ -103,20 +80,34 @@ RandomIt grandparent(RandomIt first, RandomIt it)
   return parent(first, parent(first, it));
 }
 
-/// @brief Pushes an item up the tree defined by [@p first, @p last) maintaining
-/// the min-max property using the caller-supplied ordering functor @c comp.
+/// @brief Moves the item at @p it one level up the min (max) levels of the
+/// min-max heap starting at @p first if it is smaller than its grandparent
+/// according to @c comp.
+/// @return The new position of the item, @p done if it stays where it is.
 template<typename RandomIt, typename Compare>
-void push_mm_heap_impl(RandomIt first, RandomIt last, Compare comp)
+RandomIt
+push_mm_heap_step(RandomIt first, RandomIt it, RandomIt done, Compare comp)
 {
   using std::swap;
 
-  if (std::distance(first, last) > 2) {
-    auto it{last - 1};
-    while (std::distance(first, it) > 2 && comp(*it, *grandparent(first, it))) {
-      swap(*it, *grandparent(first, it));
-      it = grandparent(first, it);
+  if (std::distance(first, it) > 2) {
+    const auto grandparent_it{grandparent(first, it)};
+    if (comp(*it, *grandparent_it)) {
+      swap(*it, *grandparent_it);
+      return grandparent_it;
     }
   }
+  return done;
+}
+
+/// @brief Pushes an item up the tree defined by [@p first, @p last) maintaining
+/// the min-max property using the caller-supplied ordering functor @c comp.
+template<typename RandomIt, typename Compare>
+void push_mm_heap_impl(RandomIt first, RandomIt last, Compare comp)
+{
+  for (auto it{last - 1}; it != last;) {
+    it = push_mm_heap_step(first, it, last, comp);
+  }
 }
 
 /// @brief Finds the smallest ancestor according to the caller-supplied ordering
@@ -133,6 +124,18 @@ smallest_ancestor(RandomIt first, RandomIt it, RandomIt last, Compare comp)
   auto       smallest_it{first};
   auto       d{std::distance(first, it)};
 
+  if (d * 4 + 6 < size) {
+    // All children and grand-children exist. Reduce them pairwise, the
+    // independent comparisons turn into conditional moves for numeric keys.
+    const auto lesser{[&comp](RandomIt a, RandomIt b) {
+      return comp(*b, *a) ? b : a;
+    }};
+    const auto c{first + (d * 2 + 1)};
+    const auto g{first + (d * 4 + 3)};
+    return lesser(lesser(c, c + 1),
+                  lesser(lesser(g, g + 1), lesser(g + 2, g + 3)));
+  }
+
   std::advance(smallest_it, d * children[0][0] + children[0][1]);
 
   for (auto i{1}; i < 6; ++i) {
@@ -152,53 +155,98 @@ smallest_ancestor(RandomIt first, RandomIt it, RandomIt last, Compare comp)
   return smallest_it;
 }
 
-/// @brief Push the item at @c it down into the heap [@c first, @c last) using
-/// the ordering functor @c comp.
+/// @brief Moves the item at @p it one level down the heap [@c first, @c last)
+/// using the ordering functor @c comp.
+/// @return The new position of the item if it has to move on, @p last
+/// otherwise.
 template<typename RandomIt, typename Compare>
-void heapify(RandomIt first, RandomIt it, RandomIt last, Compare comp)
+RandomIt heapify_step(RandomIt first, RandomIt it, RandomIt last, Compare comp)
 {
   using namespace std::placeholders;
   using std::swap;
 
-  while (has_children(first, it, last)) {
-    const auto it2{it};
-    if (is_min_level(first, it2)) {
-      it = smallest_ancestor(first, it2, last, comp);
-      if (comp(*it, *it2)) {
-        swap(*it, *it2);
-        if (is_grandchild(first, it, it2)) {
-          const auto parent_it{parent(first, it)};
-          if (comp(*parent_it, *it)) {
-            swap(*it, *parent_it);
-          }
-        }
-        else {
-          break;
+  if (!has_children(first, it, last)) {
+    return last;
+  }
+
+  const auto it2{it};
+  if (is_min_level(first, it2)) {
+    it = smallest_ancestor(first, it2, last, comp);
+    if (comp(*it, *it2)) {
+      swap(*it, *it2);
+      if (is_grandchild(first, it, it2)) {
+        const auto parent_it{parent(first, it)};
+        if (comp(*parent_it, *it)) {
+          swap(*it, *parent_it);
         }
-      }
-      else {
-        break;
+        return it;
       }
     }
-    else {
-      it = smallest_ancestor(first, it2, last, std::bind(comp, _2, _1));
-      if (comp(*it2, *it)) {
-        swap(*it, *it2);
-        if (is_grandchild(first, it, it2)) {
-          const auto parent_it{parent(first, it)};
-          if (comp(*it, *parent_it)) {
-            swap(*it, *parent_it);
-          }
-        }
-        else {
-          break;
+  }
+  else {
+    it = smallest_ancestor(first, it2, last, std::bind(comp, _2, _1));
+    if (comp(*it2, *it)) {
+      swap(*it, *it2);
+      if (is_grandchild(first, it, it2)) {
+        const auto parent_it{parent(first, it)};
+        if (comp(*it, *parent_it)) {
+          swap(*it, *parent_it);
         }
-      }
-      else {
-        break;
+        return it;
       }
     }
   }
+  return last;
+}
+
+/// @brief Push the item at @c it down into the heap [@c first, @c last) using
+/// the ordering functor @c comp.
+template<typename RandomIt, typename Compare>
+void heapify(RandomIt first, RandomIt it, RandomIt last, Compare comp)
+{
+  while (it != last) {
+    it = heapify_step(first, it, last, comp);
+  }
+}
+
+/// @brief Searches the subtree of @p it for an element equivalent to @p value.
+/// Subtrees whose minimum (maximum) is greater (smaller) than @p value are
+/// skipped.
+template<typename RandomIt, typename T, typename Compare>
+RandomIt find_in_subtree(RandomIt first,
+                         RandomIt it,
+                         RandomIt last,
+                         bool     min_level,
+                         const T& value,
+                         Compare  comp)
+{
+  if (min_level ? comp(value, *it) : comp(*it, value)) {
+    return last;
+  }
+  if (!comp(*it, value) && !comp(value, *it)) {
+    return it;
+  }
+  const auto child{it + std::distance(first, it) + 1};
+  for (auto c{child}; c < last && c <= child + 1; ++c) {
+    const auto found{find_in_subtree(first, c, last, !min_level, value, comp)};
+    if (found != last) {
+      return found;
+    }
+  }
+  return last;
+}
+
+/// @brief Hints the processor to load the cache line of @p p, e.g., the next
+/// node of a heap that is visited a few steps later.
+inline void prefetch(const void* p) noexcept
+{
+#if defined(_M_IX86) || defined(_M_X64)
+  _mm_prefetch(static_cast<const char*>(p), _MM_HINT_T0);
+#elif defined(__GNUC__)
+  __builtin_prefetch(p);
+#else
+  static_cast<void>(p);
+#endif
 }
 
 }
@@ -207,6 +255,11 @@ export namespace order_statistics {
 
 /// @brief Returns @c true if the heap [@c first, @c last) meets the min-max
 /// properties.
+///
+/// Every element is compared with its parent and its grandparent only, which
+/// implies the order with all its ancestors, i.e., the check takes linear
+/// time.
+///
 /// @tparam RandomIt A @c RandomAccessIterator type.
 /// @tparam Compare Type of a binary functor to compare two elements in the
 /// heap.
@@ -219,16 +272,26 @@ export namespace order_statistics {
 template<typename RandomIt, typename Compare>
 bool is_mm_heap(RandomIt first, RandomIt last, Compare comp)
 {
-  using namespace std::placeholders;
-
-  for (auto it{first}; it != last; ++it) {
-    if (is_min_level(first, it)) {
-      if (!for_all_children(first, it, last, std::bind(comp, *it, _1))) {
-        return false;
-      }
+  const auto size{std::distance(first, last)};
+  // The first node of the next level and whether the current one is a min
+  // level.
+  decltype(std::distance(first, last)) level_end{1};
+  bool                                 min_level{true};
+  for (decltype(std::distance(first, last)) i{1}; i < size; ++i) {
+    if (i == level_end) {
+      level_end = 2 * level_end + 1;
+      min_level = !min_level;
     }
-    else {
-      if (!for_all_children(first, it, last, std::bind(comp, _1, *it))) {
+    const auto& x{first[i]};
+    const auto& p{first[(i - 1) / 2]};
+    // A node on a min level must not be greater than its parent and not
+    // smaller than its grandparent, and vice versa on a max level.
+    if (min_level ? comp(p, x) : comp(x, p)) {
+      return false;
+    }
+    if (i > 2) {
+      const auto& g{first[((i - 1) / 2 - 1) / 2]};
+      if (min_level ? comp(x, g) : comp(g, x)) {
         return false;
       }
     }
@@ -345,6 +408,207 @@ void pop_mm_heap(RandomIt first, RandomIt last)
   pop_mm_heap(first, last, std::less<>{});
 }
 
+/// @brief Returns an iterator to the greatest element of the min-max heap
+/// [@c first, @c last).
+/// @tparam RandomIt A @c RandomAccessIterator type.
+/// @tparam Compare Type of a binary functor to compare two elements in the
+/// heap.
+/// @param first Iterator to the first element of the heap.
+/// @param last Iterator to the element past the last element of the heap.
+/// @param comp Functor to determine which of two items in the heap is
+/// considered smaller.
+/// @return Iterator to the greatest element, @c last if the heap is empty.
+template<typename RandomIt, typename Compare>
+RandomIt max_mm_heap(RandomIt first, RandomIt last, Compare comp)
+{
+  switch (std::distance(first, last)) {
+  case 0:
+    return last;
+  case 1:
+    return first;
+  case 2:
+    return first + 1;
+  default:
+    return comp(*(first + 1), *(first + 2)) ? first + 2 : first + 1;
+  }
+}
+
+/// @brief Returns an iterator to the greatest element of the min-max heap
+/// [@c first, @c last).
+/// @tparam RandomIt A @c RandomAccessIterator type.
+/// @param first Iterator to the first element of the heap.
+/// @param last Iterator to the element past the last element of the heap.
+/// @return Iterator to the greatest element, @c last if the heap is empty.
+template<typename RandomIt>
+RandomIt max_mm_heap(RandomIt first, RandomIt last)
+{
+  return max_mm_heap(first, last, std::less<>{});
+}
+
+/// @brief Swaps the greatest item and the item at (@c last - 1) and turns
+/// [@c first, @c last - 1) into a min-max heap.
+///
+/// Effectively, this function removes the maximum of the min-max heap.
+///
+/// @tparam RandomIt A @c RandomAccessIterator type.
+/// @tparam Compare Functor to determine which of two items in the heap is
+/// considered smaller.
+/// @param first Iterator to the first element of the heap.
+/// @param last Iterator to the element past the last element of the heap.
+/// @param comp Functor to determine which of two items in the heap is
+/// considered smaller.
+template<typename RandomIt, typename Compare>
+void pop_max_mm_heap(RandomIt first, RandomIt last, Compare comp)
+{
+  using std::swap;
+
+  // Expects(first == last || is_mm_heap(first, last));
+
+  if (std::distance(first, last) > 2) {
+    const auto max_it{max_mm_heap(first, last, comp)};
+    swap(*max_it, *(last - 1));
+    heapify(first, max_it, last - 1, comp);
+  }
+
+  // Ensures(first == last || is_mm_heap(first, last - 1));
+}
+
+/// @brief Swaps the greatest item and the item at (@c last - 1) and turns
+/// [@c first, @c last - 1) into a min-max heap.
+///
+/// Effectively, this function removes the maximum of the min-max heap.
+///
+/// @tparam RandomIt A @c RandomAccessIterator type.
+/// @param first Iterator to the first element of the heap.
+/// @param last Iterator to the element past the last element of the heap.
+template<typename RandomIt>
+void pop_max_mm_heap(RandomIt first, RandomIt last)
+{
+  pop_max_mm_heap(first, last, std::less<>{});
+}
+
+/// @brief Swaps the items at @c it and (@c last - 1) and turns [@c first,
+/// @c last - 1) into a min-max heap.
+///
+/// Effectively, this function removes the item at @c it from the min-max heap.
+///
+/// @tparam RandomIt A @c RandomAccessIterator type.
+/// @tparam Compare Functor to determine which of two items in the heap is
+/// considered smaller.
+/// @param first Iterator to the first element of the heap.
+/// @param it Iterator to the element to remove.
+/// @param last Iterator to the element past the last element of the heap.
+/// @param comp Functor to determine which of two items in the heap is
+/// considered smaller.
+template<typename RandomIt, typename Compare>
+void erase_mm_heap(RandomIt first, RandomIt it, RandomIt last, Compare comp)
+{
+  using std::swap;
+  using namespace std::placeholders;
+
+  // Expects(first <= it && it < last && is_mm_heap(first, last));
+
+  --last;
+  if (it == last) {
+    return;
+  }
+  swap(*it, *last);
+  if (it == first) {
+    heapify(first, it, last, comp);
+    return;
+  }
+
+  // The item moved to it may belong above it, either in place of its parent
+  // or further up the min (max) levels, or below it.
+  const auto parent_it{parent(first, it)};
+  if (is_min_level(first, it)) {
+    if (comp(*parent_it, *it)) {
+      swap(*it, *parent_it);
+      push_mm_heap_impl(first, parent_it + 1, std::bind(comp, _2, _1));
+      heapify(first, it, last, comp);
+    }
+    else if (std::distance(first, it) > 2
+             && comp(*it, *grandparent(first, it))) {
+      push_mm_heap_impl(first, it + 1, comp);
+    }
+    else {
+      heapify(first, it, last, comp);
+    }
+  }
+  else {
+    if (comp(*it, *parent_it)) {
+      swap(*it, *parent_it);
+      push_mm_heap_impl(first, parent_it + 1, comp);
+      heapify(first, it, last, comp);
+    }
+    else if (std::distance(first, it) > 2
+             && comp(*grandparent(first, it), *it)) {
+      push_mm_heap_impl(first, it + 1, std::bind(comp, _2, _1));
+    }
+    else {
+      heapify(first, it, last, comp);
+    }
+  }
+
+  // Ensures(is_mm_heap(first, last));
+}
+
+/// @brief Swaps the items at @c it and (@c last - 1) and turns [@c first,
+/// @c last - 1) into a min-max heap.
+///
+/// Effectively, this function removes the item at @c it from the min-max heap.
+///
+/// @tparam RandomIt A @c RandomAccessIterator type.
+/// @param first Iterator to the first element of the heap.
+/// @param it Iterator to the element to remove.
+/// @param last Iterator to the element past the last element of the heap.
+template<typename RandomIt>
+void erase_mm_heap(RandomIt first, RandomIt it, RandomIt last)
+{
+  erase_mm_heap(first, it, last, std::less<>{});
+}
+
+/// @brief Returns an iterator to an element of the min-max heap [@c first,
+/// @c last) that is equivalent to @p value.
+///
+/// Subtrees that cannot contain @p value are skipped: The node on a min level
+/// is the smallest and the node on a max level the greatest element of its
+/// subtree. Values close to the minimum or the maximum of the heap are found
+/// after visiting few nodes, the worst case complexity is <tt>O(n)</tt>.
+///
+/// @tparam RandomIt A @c RandomAccessIterator type.
+/// @tparam T Type of the value to find.
+/// @tparam Compare Type of a binary functor to compare two elements in the
+/// heap.
+/// @param first Iterator to the first element of the heap.
+/// @param last Iterator to the element past the last element of the heap.
+/// @param value The value to find.
+/// @param comp Functor to determine which of two items in the heap is
+/// considered smaller.
+/// @return Iterator to the element found, @c last if there is none.
+template<typename RandomIt, typename T, typename Compare>
+RandomIt
+find_mm_heap(RandomIt first, RandomIt last, const T& value, Compare comp)
+{
+  return first == last
+           ? last
+           : find_in_subtree(first, first, last, true, value, comp);
+}
+
+/// @brief Returns an iterator to an element of the min-max heap [@c first,
+/// @c last) that is equal to @p value.
+/// @tparam RandomIt A @c RandomAccessIterator type.
+/// @tparam T Type of the value to find.
+/// @param first Iterator to the first element of the heap.
+/// @param last Iterator to the element past the last element of the heap.
+/// @param value The value to find.
+/// @return Iterator to the element found, @c last if there is none.
+template<typename RandomIt, typename T>
+RandomIt find_mm_heap(RandomIt first, RandomIt last, const T& value)
+{
+  return find_mm_heap(first, last, value, std::less<>{});
+}
+
 /// @brief Turn the sequence [@c first, @c last) into a min-max heap.
 /// @tparam RandomIt A @c RandomAccessIterator type.
 /// @tparam Compare Type of a binary functor to compare two elements in the
@@ -0,0 +1,160 @@
+/// @file
+/// Detection of the NUMA topology.
+///
+/// On a multi-socket machine every socket is a NUMA node with its own memory.
+/// A page of memory is placed on the node of the thread that first touches
+/// it. The topology is read from /sys/devices/system/node on Linux, other
+/// systems and machines without that directory are treated as a single node
+/// of all hardware threads.
+
+/// @cond
+module;
+/// @endcond
+
+// C++ Standard Library.
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// POSIX.
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+/// @cond
+export module order_statistics:numa;
+/// @endcond
+
+namespace order_statistics {
+
+/// @brief Parses a list of CPUs like "0-3,8,10-11" as found in
+/// /sys/devices/system/node/node0/cpulist.
+/// @return The CPUs, empty if @p list is malformed.
+inline std::vector<unsigned> parse_cpu_list(std::string_view list)
+{
+  std::vector<unsigned> cpus;
+  while (!list.empty() && list.back() == '\n') {
+    list.remove_suffix(1);
+  }
+  while (!list.empty()) {
+    const auto range{list.substr(0, list.find(','))};
+    list.remove_prefix(std::min(list.size(), range.size() + 1));
+
+    unsigned   first{0};
+    const auto end{range.data() + range.size()};
+    auto       result{std::from_chars(range.data(), end, first)};
+    auto       last{first};
+    if (result.ec == std::errc{} && result.ptr != end && *result.ptr == '-') {
+      result = std::from_chars(result.ptr + 1, end, last);
+    }
+    if (result.ec != std::errc{} || result.ptr != end || last < first) {
+      return {};
+    }
+    for (auto cpu{first}; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+}
+
+export namespace order_statistics {
+
+/// @brief A NUMA node and its hardware threads.
+struct numa_node {
+  unsigned              id{0};
+  std::vector<unsigned> cpus;
+};
+
+/// @brief The NUMA nodes of a machine, at least one with at least one CPU.
+struct numa_topology {
+  std::vector<numa_node> nodes;
+
+  /// @brief Returns the number of CPUs of all nodes.
+  std::size_t cpus() const noexcept
+  {
+    std::size_t count{0};
+    for (const auto& node : nodes) {
+      count += node.cpus.size();
+    }
+    return count;
+  }
+};
+
+/// @brief Returns a single node of all hardware threads.
+inline numa_topology single_node_topology()
+{
+  numa_node  node;
+  const auto threads{std::max(1u, std::thread::hardware_concurrency())};
+  for (unsigned cpu{0}; cpu < threads; ++cpu) {
+    node.cpus.push_back(cpu);
+  }
+  return {{node}};
+}
+
+/// @brief Returns the NUMA nodes with CPUs of this machine, see
+/// single_node_topology() for the fallback.
+inline numa_topology detect_numa_topology()
+{
+#if defined(__linux__)
+  namespace fs = std::filesystem;
+
+  numa_topology   topology;
+  std::error_code error;
+  for (const auto& entry :
+       fs::directory_iterator{"/sys/devices/system/node", error}) {
+    const auto name{entry.path().filename().string()};
+    unsigned   id{0};
+    if (name.size() <= 4 || name.compare(0, 4, "node") != 0
+        || std::from_chars(name.data() + 4, name.data() + name.size(), id).ptr
+             != name.data() + name.size()) {
+      continue;
+    }
+    std::ifstream file{entry.path() / "cpulist"};
+    std::string   list;
+    std::getline(file, list);
+    auto cpus{parse_cpu_list(list)};
+    // Nodes of memory only have no CPUs.
+    if (!cpus.empty()) {
+      topology.nodes.push_back({id, std::move(cpus)});
+    }
+  }
+  if (!error && !topology.nodes.empty()) {
+    std::sort(topology.nodes.begin(),
+              topology.nodes.end(),
+              [](const auto& a, const auto& b) { return a.id < b.id; });
+    return topology;
+  }
+#endif
+  return single_node_topology();
+}
+
+/// @brief Restricts the calling thread to @p cpus, does nothing on systems
+/// other than Linux.
+/// @return @c false if the thread could not be restricted.
+inline bool pin_current_thread(const std::vector<unsigned>& cpus) noexcept
+{
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (const auto cpu : cpus) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+  static_cast<void>(cpus);
+  return false;
+#endif
+}
+
+}
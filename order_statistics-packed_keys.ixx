@@ -0,0 +1,115 @@
+/// @file
+/// Numeric keys and 32 bit payloads packed into a single 64 bit integer.
+///
+/// Heaps of (key, id) pairs are usually ordered by a functor that compares the
+/// keys only. Such a functor cannot be vectorized and the pairs have to be
+/// moved around as a whole anyway. A packed element stores the key in the upper
+/// and the payload in the lower 32 bits of an unsigned 64 bit integer. The
+/// bits of the key are transformed such that comparing the integers orders
+/// like comparing the keys. Hence, min-max heaps and order statistics trees of
+/// packed elements only need integer comparisons that compile to conditional
+/// moves and SIMD min / max instructions.
+
+/// @cond
+module;
+/// @endcond
+
+// C++ Standard Library.
+#include <bit>
+#include <compare>
+#include <cstdint>
+#include <type_traits>
+
+/// @cond
+export module order_statistics:packed_keys;
+/// @endcond
+
+export namespace order_statistics {
+
+/// @brief Returns the bits of @p key such that comparing the bits as unsigned
+/// integers orders like comparing the keys.
+///
+/// Negative numbers have all bits flipped, positive numbers only the sign bit.
+/// Thus -0.0f is ordered before 0.0f. NaNs are ordered beyond the infinities
+/// of the same sign.
+constexpr std::uint32_t order_preserving_bits(float key) noexcept
+{
+  const auto bits{std::bit_cast<std::uint32_t>(key)};
+  return bits & 0x80000000u ? ~bits : bits | 0x80000000u;
+}
+
+/// @brief Returns the bits of @p key such that comparing the bits as unsigned
+/// integers orders like comparing the keys.
+constexpr std::uint32_t order_preserving_bits(std::int32_t key) noexcept
+{
+  return static_cast<std::uint32_t>(key) ^ 0x80000000u;
+}
+
+/// @brief Returns @p key, unsigned integers already have the required order.
+constexpr std::uint32_t order_preserving_bits(std::uint32_t key) noexcept
+{
+  return key;
+}
+
+/// @brief Reverts order_preserving_bits().
+/// @tparam Key One of @c float, @c std::int32_t or @c std::uint32_t.
+template<typename Key>
+constexpr Key from_order_preserving_bits(std::uint32_t bits) noexcept
+{
+  if constexpr (std::is_same_v<Key, float>) {
+    return std::bit_cast<float>(bits & 0x80000000u ? bits & 0x7fffffffu
+                                                   : ~bits);
+  }
+  else if constexpr (std::is_same_v<Key, std::int32_t>) {
+    return static_cast<std::int32_t>(bits ^ 0x80000000u);
+  }
+  else {
+    return bits;
+  }
+}
+
+/// @brief A numeric key and a 32 bit payload packed into 64 bits.
+///
+/// Packed elements are ordered by their key first and by their payload on a
+/// tie. Use them with the default ordering @c std::less<> (min-max heaps) or
+/// @c std::greater<> (max-min heaps).
+///
+/// @tparam Key One of @c float, @c std::int32_t or @c std::uint32_t.
+template<typename Key>
+struct packed_element {
+  static_assert(std::is_same_v<Key, float> || std::is_same_v<Key, std::int32_t>
+                  || std::is_same_v<Key, std::uint32_t>,
+                "Key must be float, std::int32_t or std::uint32_t");
+
+  using key_type     = Key;
+  using payload_type = std::uint32_t;
+
+  /// The key in the upper and the payload in the lower 32 bits.
+  std::uint64_t bits{0};
+
+  constexpr packed_element() noexcept = default;
+
+  /// @brief Packs @p key and @p payload.
+  constexpr packed_element(Key key, std::uint32_t payload) noexcept :
+    bits{std::uint64_t{order_preserving_bits(key)} << 32 | payload}
+  {
+  }
+
+  /// @brief Returns the unpacked key.
+  constexpr Key key() const noexcept
+  {
+    return from_order_preserving_bits<Key>(
+      static_cast<std::uint32_t>(bits >> 32));
+  }
+
+  /// @brief Returns the payload. Decoding is a plain truncation.
+  constexpr std::uint32_t payload() const noexcept
+  {
+    return static_cast<std::uint32_t>(bits);
+  }
+
+  friend constexpr auto operator<=>(const packed_element&,
+                                    const packed_element&) noexcept = default;
+};
+
+}
@@ -0,0 +1,486 @@
+/// @file
+/// Builds order statistics trees with a task scheduler.
+///
+/// The ranks are selected recursively: The middle rank of a subproblem is
+/// selected, which splits it into the subproblems left and right of that rank.
+/// A subproblem without ranks is a single segment and is turned into a
+/// min-max heap. Ranks that cluster at the tail, e.g., p99, p99.9 and p99.99,
+/// make the subproblems very unequal: Almost all elements end up in the first
+/// segment. A large segment is therefore split as well, the subtrees of its
+/// heap below a certain depth are heapified by separate tasks and the last
+/// of them heapifies the levels above.
+///
+/// Every subproblem and every subtree is a task of an executor, e.g., a
+/// work_stealing_pool, which balances the tasks across its threads.
+/// Subproblems of at most @c cutoff elements are solved by a single task.
+///
+/// The few largest subproblems at the top would still be partitioned by a
+/// single thread each. Their ranks are selected by parallel_nth_element()
+/// instead, whose partitions are split into blocks: Every block is
+/// partitioned by its own task, then the elements on the wrong side of the
+/// final partition point are swapped in parallel, in place.
+///
+/// An executor may place the tasks near their elements, e.g., the executor of
+/// a first_touch_array on a NUMA machine: Every block and subproblem is then
+/// partitioned on the node that holds it, and only the misplaced elements
+/// cross nodes when they are swapped.
+
+/// @cond
+module;
+/// @endcond
+
+// C++ Standard Library.
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/// @cond
+export module order_statistics:parallel_trees;
+
+import :minmax_heaps;
+import :trees;
+/// @endcond
+
+namespace order_statistics {
+
+/// @brief Maximum number of blocks parallel_partition() splits a sequence
+/// into.
+inline constexpr std::size_t parallel_partition_blocks{256};
+
+/// @brief Half-open range of offsets from the first element of a sequence.
+using offset_range = std::pair<std::ptrdiff_t, std::ptrdiff_t>;
+
+/// @brief Swaps the elements [@p k, @p k_last) of the concatenation of the
+/// ranges @p left with those of the ranges @p right.
+/// @param left_offsets Prefix sums of the sizes of @p left.
+/// @param right_offsets Prefix sums of the sizes of @p right.
+template<typename RandomIt>
+void swap_ranges_of(RandomIt                        first,
+                    std::span<const offset_range>   left,
+                    std::span<const std::ptrdiff_t> left_offsets,
+                    std::span<const offset_range>   right,
+                    std::span<const std::ptrdiff_t> right_offsets,
+                    std::ptrdiff_t                  k,
+                    std::ptrdiff_t                  k_last)
+{
+  auto l{static_cast<std::size_t>(
+    std::upper_bound(left_offsets.begin(), left_offsets.end(), k)
+    - left_offsets.begin() - 1)};
+  auto r{static_cast<std::size_t>(
+    std::upper_bound(right_offsets.begin(), right_offsets.end(), k)
+    - right_offsets.begin() - 1)};
+  while (k < k_last) {
+    const auto l_pos{left[l].first + (k - left_offsets[l])};
+    const auto r_pos{right[r].first + (k - right_offsets[r])};
+    const auto n{std::min({left[l].second - l_pos,
+                           right[r].second - r_pos,
+                           k_last - k})};
+    std::swap_ranges(first + l_pos, first + l_pos + n, first + r_pos);
+    k += n;
+    l += left_offsets[l + 1] == k ? 1 : 0;
+    r += right_offsets[r + 1] == k ? 1 : 0;
+  }
+}
+
+/// @brief Returns the number of workers of @p executor, i.e., the result of
+/// its member function @c size() if it has one, the number of hardware
+/// threads otherwise.
+template<typename Executor>
+std::size_t executor_threads(Executor& executor)
+{
+  if constexpr (requires { executor.size(); }) {
+    return std::max<std::size_t>(executor.size(), 1);
+  }
+  else {
+    return std::max(1u, std::thread::hardware_concurrency());
+  }
+}
+
+/// @brief Spawns @p task on @p executor near the element @p it, i.e., with
+/// the member function @c spawn_near(address, task) of @p executor if it has
+/// one, see first_touch_array.
+template<typename Executor, typename Iterator, typename F>
+void spawn_near(Executor& executor, Iterator it, F&& task)
+{
+  if constexpr (requires {
+                  executor.spawn_near(
+                    static_cast<const void*>(std::to_address(it)), task);
+                }) {
+    executor.spawn_near(static_cast<const void*>(std::to_address(it)),
+                        std::forward<F>(task));
+  }
+  else {
+    executor.spawn(std::forward<F>(task));
+  }
+}
+
+/// @brief The tasks of a parallel_make_order_statistics_tree() call.
+template<typename RankIt, typename Compare, typename Executor>
+class parallel_tree_build {
+public:
+  using iterator = typename std::iterator_traits<RankIt>::value_type;
+
+  parallel_tree_build(Compare comp, Executor& executor, std::size_t cutoff) :
+    comp{comp}, executor{executor}, cutoff{std::max<std::size_t>(cutoff, 1)}
+  {
+  }
+
+  /// @brief Turns [@p first, @p last) into an order statistics tree with the
+  /// ranks [@p ranks_first, @p ranks_last).
+  void select(iterator first,
+              iterator last,
+              RankIt   ranks_first,
+              RankIt   ranks_last) const
+  {
+    if (ranks_first == ranks_last) {
+      make_heap(first, last);
+    }
+    else if (static_cast<std::size_t>(last - first) <= cutoff) {
+      make_order_statistics_tree(first, last, ranks_first, ranks_last, comp);
+    }
+    else {
+      const auto mid{ranks_first + (ranks_last - ranks_first) / 2};
+      std::nth_element(first, *mid, last, comp);
+      spawn_near(executor, first, [=, this] {
+        select(first, *mid, ranks_first, mid);
+      });
+      spawn_near(executor, *mid, [=, this] {
+        select(*mid, last, mid + 1, ranks_last);
+      });
+    }
+  }
+
+private:
+  /// @brief Turns [@p first, @p last) into a min-max heap.
+  void make_heap(iterator first, iterator last) const
+  {
+    const auto size{static_cast<std::size_t>(last - first)};
+    if (size <= cutoff) {
+      make_mm_heap(first, last, comp);
+      return;
+    }
+
+    // The subtrees of the nodes at depth are at most cutoff large.
+    std::size_t depth{0};
+    while ((size >> depth) > cutoff) {
+      ++depth;
+    }
+    const auto subtrees{std::size_t{1} << depth};
+    const auto remaining{std::make_shared<std::atomic<std::size_t>>(subtrees)};
+    for (std::size_t j{0}; j < subtrees; ++j) {
+      executor.spawn([=, this] {
+        heapify_subtree(first, last, subtrees - 1 + j);
+        if (remaining->fetch_sub(1, std::memory_order_acq_rel) == 1) {
+          // The nodes above depth, bottom-up.
+          for (auto node{first + static_cast<std::ptrdiff_t>(subtrees - 1)};
+               node != first;) {
+            --node;
+            heapify(first, node, last, comp);
+          }
+        }
+      });
+    }
+  }
+
+  /// @brief Heapifies all nodes of the subtree of @p root bottom-up.
+  void heapify_subtree(iterator first, iterator last, std::size_t root) const
+  {
+    const auto size{static_cast<std::size_t>(last - first)};
+    // The nodes of the subtree at k levels below the root are
+    // [(root + 1) * 2^k - 1, (root + 2) * 2^k - 1).
+    std::size_t levels{0};
+    while (((root + 1) << levels) - 1 < size / 2) {
+      ++levels;
+    }
+    for (auto k{levels + 1}; k > 0;) {
+      --k;
+      const auto level_first{((root + 1) << k) - 1};
+      const auto level_last{std::min(((root + 2) << k) - 1, size / 2 + 1)};
+      for (auto node{level_last}; node > level_first;) {
+        --node;
+        heapify(first, first + static_cast<std::ptrdiff_t>(node), last, comp);
+      }
+    }
+  }
+
+  Compare     comp;
+  Executor&   executor;
+  std::size_t cutoff;
+};
+
+}
+
+export namespace order_statistics {
+
+/// @brief Default number of elements below which
+/// parallel_make_order_statistics_tree() does not split a subproblem.
+inline constexpr std::size_t parallel_tree_cutoff{1 << 15};
+
+/// @brief Reorders [@p first, @p last) such that the elements for which
+/// @p pred returns @c true precede the others, like std::partition().
+///
+/// The sequence is split into blocks of at least @p cutoff elements, every
+/// block is partitioned by its own task. Of the elements before the final
+/// partition point, those for which @p pred returns @c false are swapped
+/// with the elements after the point for which it returns @c true, again by
+/// several tasks. No extra memory proportional to the size of the sequence is
+/// needed. Every task is spawned near the first element it partitions or
+/// swaps, see first_touch_array.
+///
+/// @tparam RandomIt A @c RandomAccessIterator type.
+/// @tparam UnaryPredicate Type of a predicate, it is called concurrently.
+/// @tparam Executor See parallel_make_order_statistics_tree().
+/// @return Iterator to the first element for which @p pred returns @c false.
+template<typename RandomIt, typename UnaryPredicate, typename Executor>
+RandomIt parallel_partition(RandomIt       first,
+                            RandomIt       last,
+                            UnaryPredicate pred,
+                            Executor&      executor,
+                            std::size_t    cutoff = parallel_tree_cutoff)
+{
+  const auto size{last - first};
+  const auto blocks{std::clamp<std::size_t>(
+    static_cast<std::size_t>(size) / std::max<std::size_t>(cutoff, 1),
+    1,
+    parallel_partition_blocks)};
+  if (blocks == 1) {
+    return std::partition(first, last, pred);
+  }
+
+  std::vector<std::ptrdiff_t> bounds(blocks + 1);
+  for (std::size_t i{0}; i <= blocks; ++i) {
+    bounds[i] = static_cast<std::ptrdiff_t>(
+      static_cast<std::size_t>(size) * i / blocks);
+  }
+  std::vector<std::ptrdiff_t> splits(blocks);
+  executor.run([&] {
+    for (std::size_t i{0}; i < blocks; ++i) {
+      spawn_near(executor, first + bounds[i], [&, i] {
+        splits[i] =
+          std::partition(first + bounds[i], first + bounds[i + 1], pred)
+          - first;
+      });
+    }
+  });
+
+  std::ptrdiff_t mid{0};
+  for (std::size_t i{0}; i < blocks; ++i) {
+    mid += splits[i] - bounds[i];
+  }
+  // The elements on the wrong side of mid, the same number on both sides.
+  std::vector<offset_range>   left;
+  std::vector<offset_range>   right;
+  std::vector<std::ptrdiff_t> left_offsets{0};
+  std::vector<std::ptrdiff_t> right_offsets{0};
+  for (std::size_t i{0}; i < blocks; ++i) {
+    if (splits[i] < std::min(bounds[i + 1], mid)) {
+      left.emplace_back(splits[i], std::min(bounds[i + 1], mid));
+      left_offsets.push_back(left_offsets.back() + left.back().second
+                             - left.back().first);
+    }
+    if (std::max(bounds[i], mid) < splits[i]) {
+      right.emplace_back(std::max(bounds[i], mid), splits[i]);
+      right_offsets.push_back(right_offsets.back() + right.back().second
+                              - right.back().first);
+    }
+  }
+
+  const auto misplaced{left_offsets.back()};
+  const auto pieces{static_cast<std::ptrdiff_t>(std::clamp<std::size_t>(
+    static_cast<std::size_t>(misplaced) / std::max<std::size_t>(cutoff, 1),
+    1,
+    blocks))};
+  if (misplaced > 0) {
+    executor.run([&] {
+      for (std::ptrdiff_t i{0}; i < pieces; ++i) {
+        // The misplaced elements before the partition point that the piece
+        // starts with.
+        const auto k{misplaced * i / pieces};
+        const auto l{std::upper_bound(
+                       left_offsets.begin(), left_offsets.end(), k)
+                     - left_offsets.begin() - 1};
+        const auto start{first + left[static_cast<std::size_t>(l)].first
+                         + (k - left_offsets[static_cast<std::size_t>(l)])};
+        spawn_near(executor, start, [&, i] {
+          swap_ranges_of(first,
+                         std::span<const offset_range>{left},
+                         std::span<const std::ptrdiff_t>{left_offsets},
+                         std::span<const offset_range>{right},
+                         std::span<const std::ptrdiff_t>{right_offsets},
+                         misplaced * i / pieces,
+                         misplaced * (i + 1) / pieces);
+        });
+      }
+    });
+  }
+  return first + mid;
+}
+
+/// @brief Rearranges [@p first, @p last) like std::nth_element() with the
+/// partitions of parallel_partition().
+///
+/// The pivot of every round is the element of a sample at the relative
+/// position of @p nth. Once at most 2 * @p cutoff elements are left, they are
+/// selected by std::nth_element().
+///
+/// @tparam RandomIt A @c RandomAccessIterator type.
+/// @tparam Compare Type of a binary functor to compare two elements, it is
+/// called concurrently.
+/// @tparam Executor See parallel_make_order_statistics_tree().
+template<typename RandomIt, typename Compare, typename Executor>
+void parallel_nth_element(RandomIt    first,
+                          RandomIt    nth,
+                          RandomIt    last,
+                          Compare     comp,
+                          Executor&   executor,
+                          std::size_t cutoff = parallel_tree_cutoff)
+{
+  using value_type = typename std::iterator_traits<RandomIt>::value_type;
+  constexpr std::ptrdiff_t samples{255};
+
+  while (nth != last && static_cast<std::size_t>(last - first) > 2 * cutoff) {
+    const auto              size{last - first};
+    std::vector<value_type> sample;
+    sample.reserve(samples);
+    for (std::ptrdiff_t i{0}; i < samples; ++i) {
+      sample.push_back(first[size * (2 * i + 1) / (2 * samples)]);
+    }
+    const auto k{sample.begin() + (nth - first) * samples / size};
+    std::nth_element(sample.begin(), k, sample.end(), comp);
+    const auto& pivot{*k};
+
+    const auto mid{parallel_partition(
+      first,
+      last,
+      [&](const auto& x) { return comp(x, pivot); },
+      executor,
+      cutoff)};
+    if (nth < mid) {
+      last = mid;
+      continue;
+    }
+    // Elements equivalent to the pivot may be all that is left.
+    const auto greater{parallel_partition(
+      mid,
+      last,
+      [&](const auto& x) { return !comp(pivot, x); },
+      executor,
+      cutoff)};
+    if (nth < greater) {
+      return;
+    }
+    first = greater;
+  }
+  std::nth_element(first, nth, last, comp);
+}
+
+/// @brief Turns the sequence [@c first, @c last) into an order statistics
+/// tree using the tasks of @p executor.
+///
+/// The ranks of subproblems larger than the size of the tree over the number
+/// of workers of @p executor are selected by parallel_nth_element(), one
+/// after the other. The smaller subproblems are tasks.
+///
+/// The result is an order statistics tree like the one of
+/// make_order_statistics_tree(), though not necessarily the same permutation.
+///
+/// @tparam RandomIt A @c RandomAccessIterator type whose values are the
+/// iterators to the ranks.
+/// @tparam Compare Type of a binary functor to compare two elements, it is
+/// called concurrently.
+/// @tparam Executor A type with a member function @c run(f), which executes
+/// @c f and all tasks spawned by it and returns when they are finished, and a
+/// member function @c spawn(f), which schedules the task @c f, see
+/// work_stealing_pool. Its member function @c size() is the number of
+/// workers if it has one, otherwise the number of hardware threads is
+/// assumed. If it has a member function @c spawn_near(address, f), the tasks
+/// are spawned near their elements, see first_touch_array.
+/// @param first Iterator to the first element of the tree.
+/// @param last Iterator to the element past the last element of the tree.
+/// @param ranks_first Iterator to the first rank. The ranks must be sorted.
+/// @param ranks_last Iterator past the last rank.
+/// @param comp Functor to determine which of two elements is considered
+/// smaller.
+/// @param executor Executes the tasks.
+/// @param cutoff Subproblems and heaps of at most @p cutoff elements are not
+/// split any further.
+template<typename RandomIt, typename Compare, typename Executor>
+void parallel_make_order_statistics_tree(
+  typename std::iterator_traits<RandomIt>::value_type first,
+  typename std::iterator_traits<RandomIt>::value_type last,
+  RandomIt                                            ranks_first,
+  RandomIt                                            ranks_last,
+  Compare                                             comp,
+  Executor&                                           executor,
+  std::size_t cutoff = parallel_tree_cutoff)
+{
+  using iterator = typename std::iterator_traits<RandomIt>::value_type;
+  struct subproblem {
+    iterator first;
+    iterator last;
+    RandomIt ranks_first;
+    RandomIt ranks_last;
+  };
+
+  const auto threads{executor_threads(executor)};
+  const auto top_size{std::max<std::size_t>(
+    static_cast<std::size_t>(last - first) / threads, 2 * cutoff)};
+  std::vector<subproblem> subproblems{{first, last, ranks_first, ranks_last}};
+  for (std::size_t i{0}; i < subproblems.size();) {
+    const auto p{subproblems[i]};
+    if (p.ranks_first == p.ranks_last
+        || static_cast<std::size_t>(p.last - p.first) <= top_size) {
+      ++i;
+      continue;
+    }
+    const auto mid{p.ranks_first + (p.ranks_last - p.ranks_first) / 2};
+    parallel_nth_element(p.first, *mid, p.last, comp, executor, cutoff);
+    subproblems[i] = {p.first, *mid, p.ranks_first, mid};
+    subproblems.push_back({*mid, p.last, mid + 1, p.ranks_last});
+  }
+
+  const parallel_tree_build<RandomIt, Compare, Executor> build{
+    comp, executor, cutoff};
+  executor.run([&] {
+    for (const auto& p : subproblems) {
+      spawn_near(executor, p.first, [&build, p] {
+        build.select(p.first, p.last, p.ranks_first, p.ranks_last);
+      });
+    }
+  });
+}
+
+/// @brief Turns the sequence [@c first, @c last) into an order statistics
+/// tree using the tasks of @p executor.
+///
+/// Uses std::less to determine the order of elements, see
+/// parallel_make_order_statistics_tree().
+///
+/// @tparam RandomIt A @c RandomAccessIterator type whose values are the
+/// iterators to the ranks.
+/// @tparam Executor See parallel_make_order_statistics_tree().
+/// @param first Iterator to the first element of the tree.
+/// @param last Iterator to the element past the last element of the tree.
+/// @param ranks_first Iterator to the first rank. The ranks must be sorted.
+/// @param ranks_last Iterator past the last rank.
+/// @param executor Executes the tasks.
+template<typename RandomIt, typename Executor>
+void parallel_make_order_statistics_tree(
+  typename std::iterator_traits<RandomIt>::value_type first,
+  typename std::iterator_traits<RandomIt>::value_type last,
+  RandomIt                                            ranks_first,
+  RandomIt                                            ranks_last,
+  Executor&                                           executor)
+{
+  parallel_make_order_statistics_tree(
+    first, last, ranks_first, ranks_last, std::less<>{}, executor);
+}
+
+}
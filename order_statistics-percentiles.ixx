@@ -0,0 +1,84 @@
+/// @file
+/// The ranks of percentiles.
+///
+/// The percentile p of n elements is the element of rank round(p * (n - 1)),
+/// i.e., the nearest rank without interpolation, such that every percentile
+/// is an element and can be selected exactly. All containers and tools of the
+/// library map percentiles to ranks with percentile_rank().
+
+/// @cond
+module;
+/// @endcond
+
+// C++ Standard Library.
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+/// @cond
+export module order_statistics:percentiles;
+/// @endcond
+
+export namespace order_statistics {
+
+/// @brief Returns the rank round(@p p * (@p size - 1)) of the percentile
+/// @p p in [0, 1] among @p size elements, 0 if there are none.
+constexpr std::size_t percentile_rank(double p, std::size_t size) noexcept
+{
+  return size == 0 ? 0
+                   : static_cast<std::size_t>(
+                       p * static_cast<double>(size - 1) + 0.5);
+}
+
+/// @brief The ranks of a list of percentiles among the elements of a tree.
+struct percentile_ranks {
+  /// @brief Marks a percentile of the greatest element, which is the maximum
+  /// of the last segment rather than a rank of the tree.
+  static constexpr std::size_t greatest{
+    std::numeric_limits<std::size_t>::max()};
+
+  /// The strictly increasing ranks of the tree.
+  std::vector<std::size_t> ranks;
+  /// The index into ranks of the rank of every percentile, or greatest.
+  std::vector<std::size_t> index;
+};
+
+/// @brief Returns the ranks of @p percentiles among @p size elements.
+/// @param percentiles Percentiles in [0, 1] in any order.
+/// @param size Number of elements.
+/// @param rank_greatest If @c false, the rank @p size - 1 is not among the
+/// ranks and its percentiles have the index percentile_ranks::greatest.
+/// @throws std::invalid_argument if a percentile is not in [0, 1].
+inline percentile_ranks make_percentile_ranks(
+  std::span<const double> percentiles,
+  std::size_t             size,
+  bool                    rank_greatest = true)
+{
+  percentile_ranks result;
+  for (const auto p : percentiles) {
+    if (!(p >= 0.0 && p <= 1.0)) {
+      throw std::invalid_argument{"percentile must lie in [0, 1]"};
+    }
+    const auto rank{percentile_rank(p, size)};
+    if (rank_greatest || rank + 1 < size) {
+      result.ranks.push_back(rank);
+    }
+  }
+  auto& ranks{result.ranks};
+  std::sort(ranks.begin(), ranks.end());
+  ranks.erase(std::unique(ranks.begin(), ranks.end()), ranks.end());
+
+  for (const auto p : percentiles) {
+    const auto rank{percentile_rank(p, size)};
+    const auto it{std::lower_bound(ranks.begin(), ranks.end(), rank)};
+    result.index.push_back(it == ranks.end() || *it != rank
+                             ? percentile_ranks::greatest
+                             : static_cast<std::size_t>(it - ranks.begin()));
+  }
+  return result;
+}
+
+}
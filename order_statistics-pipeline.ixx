@@ -0,0 +1,472 @@
+/// @file
+/// Construction of an order statistics tree while its input is still read.
+///
+/// The input flows through three stages connected by bounded queues:
+///
+/// 1. A reader thread reads blocks of bytes from the source.
+/// 2. A parser thread cuts the blocks at line breaks and parses the lines
+///    with parse_column().
+/// 3. The calling thread draws splitters from a sample of the first values
+///    and distributes all values into the bands between the splitters.
+///
+/// When the input ends, the bands are concatenated in order. Every rank then
+/// lies in a known band and is selected within that band only, and the
+/// segments between the ranks are turned into min-max heaps. Only these
+/// band fixups wait for the end of the input.
+///
+/// The splitters are drawn from the start of the input. If the input is
+/// sorted or drifts, the bands get unbalanced and the fixups select among
+/// more elements, the result stays exact.
+
+/// @cond
+module;
+/// @endcond
+
+// C++ Standard Library.
+#include <algorithm>
+#include <concepts>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/// @cond
+export module order_statistics:pipeline;
+
+import :containers;
+import :ingest;
+import :minmax_heaps;
+import :percentiles;
+/// @endcond
+
+namespace order_statistics {
+
+/// @brief A queue between two threads that blocks the producer while it is
+/// full and the consumer while it is empty.
+template<typename T>
+class bounded_queue {
+public:
+  explicit bounded_queue(std::size_t capacity) : capacity{capacity}
+  {
+  }
+
+  /// @brief Appends @p item, waits while the queue is full.
+  /// @return @c false if the queue was closed.
+  bool push(T item)
+  {
+    std::unique_lock lock{mutex};
+    not_full.wait(lock, [&] { return closed || items.size() < capacity; });
+    if (closed) {
+      return false;
+    }
+    items.push_back(std::move(item));
+    not_empty.notify_one();
+    return true;
+  }
+
+  /// @brief Removes the first item, waits while the queue is empty.
+  /// @return No item if the queue is empty and closed.
+  std::optional<T> pop()
+  {
+    std::unique_lock lock{mutex};
+    not_empty.wait(lock, [&] { return closed || !items.empty(); });
+    if (items.empty()) {
+      return std::nullopt;
+    }
+    auto item{std::move(items.front())};
+    items.pop_front();
+    not_full.notify_one();
+    return item;
+  }
+
+  /// @brief Ends the input, pop() returns the remaining items and push()
+  /// fails.
+  void close()
+  {
+    const std::scoped_lock lock{mutex};
+    closed = true;
+    not_full.notify_all();
+    not_empty.notify_all();
+  }
+
+private:
+  std::size_t             capacity;
+  std::deque<T>           items;
+  bool                    closed{false};
+  std::mutex              mutex;
+  std::condition_variable not_full;
+  std::condition_variable not_empty;
+};
+
+/// @brief A block of bytes read from the source.
+struct input_block {
+  std::unique_ptr<char[]> bytes;
+  std::size_t             size{0};
+};
+
+}
+
+export namespace order_statistics {
+
+/// @brief Counters of a pipelined_tree_build.
+struct pipeline_statistics {
+  /// Blocks read from the source.
+  std::size_t blocks{0};
+  /// Bytes read from the source.
+  std::size_t bytes{0};
+  /// Elements of the bands the ranks were selected in at the end.
+  std::size_t fixup_elements{0};
+};
+
+/// @brief Builds an order statistics tree of the numbers in a column of a
+/// CSV stream while the stream is read.
+///
+/// @code
+/// pipelined_tree_build<double> build{{0.5, 0.99}, {',', 1, true}};
+/// build.run(std::cin);
+/// const auto p99{build.quantile(1)};
+/// @endcode
+///
+/// @tparam T An arithmetic type std::from_chars() supports.
+/// @tparam Compare Type of a binary functor to compare two elements.
+template<typename T, typename Compare = std::less<>>
+class pipelined_tree_build {
+public:
+  using value_type = T;
+  using size_type  = std::size_t;
+
+  /// @brief Number of blocks and of parsed chunks each queue holds at most.
+  static constexpr size_type queue_depth{4};
+
+  /// @brief Number of splitters between the bands.
+  static constexpr size_type splitter_count{255};
+
+  /// @brief Number of values the splitters are drawn from.
+  static constexpr size_type sample_size{16 * (splitter_count + 1)};
+
+  /// @brief Prepares a build, no input is read yet.
+  /// @param percentiles Percentiles in [0, 1] to select, e.g., 0.5 and 0.99.
+  /// @param format Where the numbers are in the lines of the stream.
+  /// @param comp Functor to determine which of two elements is considered
+  /// smaller.
+  /// @param block_size Number of bytes read from the source at a time.
+  /// @throws std::invalid_argument if a percentile is not in [0, 1].
+  explicit pipelined_tree_build(std::vector<double> percentiles,
+                                csv_format          format     = {},
+                                Compare             comp       = {},
+                                size_type block_size = ingest_chunk_size) :
+    comp{comp},
+    format{format},
+    block_size{std::max<size_type>(block_size, 1)},
+    percentiles{std::move(percentiles)}
+  {
+    for (const auto p : this->percentiles) {
+      if (!(p >= 0.0 && p <= 1.0)) {
+        throw std::invalid_argument{"percentile must lie in [0, 1]"};
+      }
+    }
+  }
+
+  /// @brief Reads the stream from @p read and builds the tree.
+  /// @tparam Source Type of a functor <tt>std::size_t(char* buffer,
+  /// std::size_t size)</tt> that reads at most @c size bytes into @c buffer
+  /// and returns their number, zero at the end of the stream.
+  /// @throws std::invalid_argument if a line holds no number in the column.
+  /// @throws Any exception of @p read.
+  template<typename Source>
+    requires std::invocable<Source&, char*, size_type>
+  void run(Source read)
+  {
+    bounded_queue<input_block>        blocks{queue_depth};
+    bounded_queue<ingested_column<T>> columns{queue_depth};
+    std::mutex                        failure_mutex;
+    std::exception_ptr                failure;
+    const auto                        fail{[&] {
+      {
+        const std::scoped_lock lock{failure_mutex};
+        if (!failure) {
+          failure = std::current_exception();
+        }
+      }
+      blocks.close();
+      columns.close();
+    }};
+
+    counters = {};
+    std::jthread reader{[&] {
+      try {
+        for (;;) {
+          input_block block{
+            std::make_unique_for_overwrite<char[]>(block_size), 0};
+          block.size = read(block.bytes.get(), block_size);
+          if (block.size == 0) {
+            break;
+          }
+          ++counters.blocks;
+          counters.bytes += block.size;
+          if (!blocks.push(std::move(block))) {
+            return;
+          }
+        }
+        blocks.close();
+      }
+      catch (...) {
+        fail();
+      }
+    }};
+    std::jthread parser{[&] {
+      try {
+        parse(blocks, columns);
+        columns.close();
+      }
+      catch (...) {
+        fail();
+      }
+    }};
+
+    try {
+      distribute(columns);
+    }
+    catch (...) {
+      fail();
+    }
+    reader.join();
+    parser.join();
+    if (failure) {
+      std::rethrow_exception(failure);
+    }
+    fix_bands();
+  }
+
+  /// @brief Reads the stream from @p in and builds the tree.
+  /// @throws std::invalid_argument if a line holds no number in the column.
+  void run(std::istream& in)
+  {
+    run([&in](char* buffer, size_type size) {
+      in.read(buffer, static_cast<std::streamsize>(size));
+      return static_cast<size_type>(in.gcount());
+    });
+  }
+
+  /// @brief Returns the element at the percentile @p i.
+  /// @param i Index into the percentiles given to the constructor.
+  /// @throws std::length_error if there are no elements.
+  T quantile(size_type i) const
+  {
+    if (!tree || tree->empty()) {
+      throw std::length_error{"no elements"};
+    }
+    const auto rank{rank_of_percentile[i]};
+    return rank == percentile_ranks::greatest ? tree->max()
+                                              : tree->at_rank(rank);
+  }
+
+  /// @brief Returns the counters of the last run().
+  const pipeline_statistics& statistics() const noexcept
+  {
+    return counters;
+  }
+
+  /// @brief Returns the tree, the build is left without one.
+  /// @throws std::logic_error if run() has not completed.
+  order_statistics_tree<T, Compare> result()
+  {
+    if (!tree) {
+      throw std::logic_error{"the build is not done"};
+    }
+    auto completed{std::move(*tree)};
+    tree.reset();
+    return completed;
+  }
+
+private:
+  /// @brief Cuts the blocks into whole lines and parses them.
+  ///
+  /// A line that spans blocks is gathered in @c carry, the rest of every
+  /// block is parsed in place.
+  void parse(bounded_queue<input_block>&        blocks,
+             bounded_queue<ingested_column<T>>& columns)
+  {
+    std::string     carry;
+    size_type       lines{0};
+    bool            first{true};
+    inline_executor executor;
+    const auto      parse_text{[&](std::string_view text) {
+      auto text_format{format};
+      text_format.header = format.header && first;
+      first              = false;
+      auto column{parse_lines<T>(
+        text, text_format, executor, text.size() + 1, lines + 1)};
+      lines += count_bytes(text.data(), text.data() + text.size(), '\n');
+      return column.size == 0 || columns.push(std::move(column));
+    }};
+
+    while (auto block{blocks.pop()}) {
+      std::string_view rest{block->bytes.get(), block->size};
+      if (!carry.empty()) {
+        const auto line_end{rest.find('\n')};
+        if (line_end == rest.npos) {
+          carry.append(rest);
+          continue;
+        }
+        carry.append(rest.substr(0, line_end + 1));
+        rest.remove_prefix(line_end + 1);
+        if (!parse_text(carry)) {
+          return;
+        }
+        carry.clear();
+      }
+      const auto last_line_end{rest.rfind('\n')};
+      if (last_line_end == rest.npos) {
+        carry.assign(rest);
+        continue;
+      }
+      if (!parse_text(rest.substr(0, last_line_end + 1))) {
+        return;
+      }
+      carry.assign(rest.substr(last_line_end + 1));
+    }
+    if (!carry.empty()) {
+      parse_text(carry);
+    }
+  }
+
+  /// @brief Draws the splitters from the first values and distributes all
+  /// values into the bands.
+  void distribute(bounded_queue<ingested_column<T>>& columns)
+  {
+    splitters.clear();
+    bands.assign(splitter_count + 1, {});
+
+    // The first columns wait until the sample is complete.
+    std::vector<ingested_column<T>> pending;
+    size_type                       pending_size{0};
+    while (auto column{columns.pop()}) {
+      if (splitters.empty()) {
+        pending_size += column->size;
+        pending.push_back(std::move(*column));
+        if (pending_size >= sample_size) {
+          draw_splitters(pending, pending_size);
+        }
+      }
+      else {
+        classify(column->elements());
+      }
+    }
+    if (splitters.empty() && pending_size > 0) {
+      draw_splitters(pending, pending_size);
+    }
+  }
+
+  void draw_splitters(std::vector<ingested_column<T>>& pending,
+                      size_type                        pending_size)
+  {
+    // Every value at the same stride, the stride of the last column may
+    // differ.
+    const auto     stride{std::max<size_type>(pending_size / sample_size, 1)};
+    std::vector<T> sample;
+    for (const auto& column : pending) {
+      for (size_type i{0}; i < column.size; i += stride) {
+        sample.push_back(column.values[i]);
+      }
+    }
+    std::sort(sample.begin(), sample.end(), comp);
+    for (size_type i{1}; i <= splitter_count; ++i) {
+      splitters.push_back(sample[i * (sample.size() - 1) / splitter_count]);
+    }
+
+    for (const auto& column : pending) {
+      classify(column.elements());
+    }
+    pending.clear();
+  }
+
+  /// @brief Appends every value to the band between the greatest splitter
+  /// not greater and the smallest splitter greater than the value.
+  void classify(std::span<const T> values)
+  {
+    for (const auto& value : values) {
+      const auto band{
+        std::upper_bound(splitters.begin(), splitters.end(), value, comp)
+        - splitters.begin()};
+      bands[static_cast<size_type>(band)].push_back(value);
+    }
+  }
+
+  /// @brief Concatenates the bands, selects every rank within its band and
+  /// heapifies the segments.
+  void fix_bands()
+  {
+    size_type size{0};
+    for (const auto& band : bands) {
+      size += band.size();
+    }
+
+    std::vector<T>         values;
+    std::vector<size_type> band_ends;
+    values.reserve(size);
+    for (auto& band : bands) {
+      values.insert(values.end(), band.begin(), band.end());
+      band_ends.push_back(values.size());
+      std::vector<T>{}.swap(band);
+    }
+
+    // The greatest element is the maximum of the last segment, no rank.
+    auto [ranks, index]{make_percentile_ranks(percentiles, size, false)};
+    rank_of_percentile = std::move(index);
+
+    // No element of a band is greater than an element of a later band, so
+    // every rank is selected among the rest of its band.
+    const auto at{[&](size_type position) {
+      return values.begin() + static_cast<std::ptrdiff_t>(position);
+    }};
+    size_type segment_begin{0};
+    size_type fixed_band{bands.size()};
+    for (const auto rank : ranks) {
+      const auto band{static_cast<size_type>(
+        std::upper_bound(band_ends.begin(), band_ends.end(), rank)
+        - band_ends.begin())};
+      const auto band_begin{band == 0 ? 0 : band_ends[band - 1]};
+      if (band != fixed_band) {
+        counters.fixup_elements += band_ends[band] - band_begin;
+        fixed_band = band;
+      }
+      std::nth_element(at(std::max(band_begin, segment_begin)),
+                       at(rank),
+                       at(band_ends[band]),
+                       comp);
+      make_mm_heap(at(segment_begin), at(rank), comp);
+      segment_begin = rank;
+    }
+    make_mm_heap(at(segment_begin), values.end(), comp);
+
+    tree.emplace(order_statistics_tree<T, Compare>{
+      std::move(values), std::move(ranks), comp, std::in_place});
+  }
+
+  Compare             comp;
+  csv_format          format;
+  size_type           block_size;
+  std::vector<double> percentiles;
+
+  std::vector<T>              splitters;
+  std::vector<std::vector<T>> bands;
+  pipeline_statistics         counters;
+
+  std::optional<order_statistics_tree<T, Compare>> tree;
+  std::vector<size_type>                           rank_of_percentile;
+};
+
+}
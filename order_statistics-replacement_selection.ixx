@@ -0,0 +1,387 @@
+/// @file
+/// Two-way replacement selection with min-max heaps for external sorting.
+///
+/// Replacement selection generates the initial sorted runs of an external
+/// merge sort. A buffer of @c M elements is kept as a heap. Whenever an element
+/// is read, an element of the current run is written and the new element joins
+/// the current run if it still fits, otherwise it is kept for the next run.
+///
+/// With a min-max heap elements can be written at either end: The minimum is
+/// appended to the lower part of the run, the maximum is prepended to its
+/// upper part. A run thus grows from its bounds towards its middle and an
+/// element fits as long as it lies between the last minimum and the last
+/// maximum written. Elements are written at the same end until a new element
+/// that fits lies beyond the other end of the heap. Ascending as well as
+/// descending input produces a single run and partially ordered input produces
+/// much longer runs than a classic replacement selection would.
+///
+/// The buffer is used in situ: The heap of the current run occupies the front
+/// of the buffer, the elements deferred to the next run its back.
+
+/// @cond
+module;
+/// @endcond
+
+// C++ Standard Library.
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/// @cond
+export module order_statistics:replacement_selection;
+
+import :minmax_heaps;
+/// @endcond
+
+export namespace order_statistics {
+
+/// @brief Generates sorted runs with two-way replacement selection.
+///
+/// The runs are handed to a sink that provides the following member functions:
+/// @arg @c push_low(value) appends @c value to the lower part of the current
+/// run. Successive values are ascending.
+/// @arg @c push_high(value) prepends @c value to the upper part of the current
+/// run. Successive values are descending and never smaller than any value of
+/// the lower part.
+/// @arg @c finish_run() ends the current run. The run consists of the lower
+/// part followed by the upper part in reverse order.
+///
+/// @tparam T Type of the elements.
+/// @tparam Compare Type of a binary functor to compare two elements.
+template<typename T, typename Compare = std::less<>>
+class replacement_selection {
+public:
+  /// @brief Creates a generator that buffers up to @p capacity elements.
+  explicit replacement_selection(std::size_t capacity, Compare comp = {}) :
+    capacity{capacity}, comp{comp}
+  {
+    if (capacity == 0) {
+      throw std::invalid_argument{"capacity must not be 0"};
+    }
+    buffer.reserve(capacity);
+  }
+
+  /// @brief Reads @p value, writes at most one element to @p sink.
+  template<typename Sink>
+  void push(T value, Sink& sink)
+  {
+    if (buffer.size() < capacity) {
+      buffer.push_back(std::move(value));
+      push_mm_heap(buffer.begin(), buffer.end(), comp);
+      heap_size = buffer.size();
+      return;
+    }
+
+    // Keep writing at the same end until an element that fits into the run
+    // lies beyond the other end of the heap.
+    const auto first{buffer.begin()};
+    if (fits(value)) {
+      if (comp(value, *first)) {
+        pop_low = false;
+      }
+      else if (comp(*max_mm_heap(first, first + heap_size, comp), value)) {
+        pop_low = true;
+      }
+    }
+
+    if (pop_low) {
+      pop_mm_heap(first, first + heap_size, comp);
+    }
+    else {
+      pop_max_mm_heap(first, first + heap_size, comp);
+    }
+    --heap_size;
+
+    auto& slot{buffer[heap_size]};
+    if (pop_low) {
+      sink.push_low(slot);
+      low     = slot;
+      has_low = true;
+    }
+    else {
+      sink.push_high(slot);
+      high     = slot;
+      has_high = true;
+    }
+
+    slot = std::move(value);
+    if (fits(slot)) {
+      ++heap_size;
+      push_mm_heap(first, first + heap_size, comp);
+    }
+
+    if (heap_size == 0) {
+      next_run(sink);
+    }
+  }
+
+  /// @brief Writes all buffered elements to @p sink and finishes the last
+  /// runs.
+  template<typename Sink>
+  void flush(Sink& sink)
+  {
+    while (!buffer.empty()) {
+      for (auto last{buffer.begin() + heap_size}; last != buffer.begin();
+           --last) {
+        pop_mm_heap(buffer.begin(), last, comp);
+        sink.push_low(*(last - 1));
+      }
+      next_run(sink);
+    }
+  }
+
+private:
+  /// @brief Returns @c true if @p value lies between the last elements written
+  /// at both ends of the current run.
+  bool fits(const T& value) const
+  {
+    return (!has_low || !comp(value, low)) && (!has_high || !comp(high, value));
+  }
+
+  /// @brief Finishes the current run and turns the deferred elements into the
+  /// heap of the next run.
+  template<typename Sink>
+  void next_run(Sink& sink)
+  {
+    sink.finish_run();
+    buffer.erase(buffer.begin(), buffer.begin() + heap_size);
+    make_mm_heap(buffer.begin(), buffer.end(), comp);
+    heap_size = buffer.size();
+    has_low   = false;
+    has_high  = false;
+  }
+
+  std::size_t    capacity;
+  Compare        comp;
+  std::vector<T> buffer;
+  std::size_t    heap_size{0};
+  T              low{};
+  T              high{};
+  bool           has_low{false};
+  bool           has_high{false};
+  bool           pop_low{true};
+};
+
+}
+
+namespace order_statistics {
+
+/// @brief Creates a directory in @p parent whose name no other directory
+/// has, e.g., of another run_file_sink, and returns its path.
+/// @throws std::filesystem::filesystem_error if it cannot be created.
+inline std::filesystem::path
+create_unique_directory(const std::filesystem::path& parent)
+{
+  static std::atomic<std::uint64_t> counter{0};
+  std::random_device                random;
+  for (;;) {
+    const auto path{parent
+                    / ("runs_" + std::to_string(random()) + "_"
+                       + std::to_string(counter.fetch_add(1)))};
+    // A directory that exists already is not reused.
+    if (std::filesystem::create_directory(path)) {
+      return path;
+    }
+  }
+}
+
+}
+
+export namespace order_statistics {
+
+/// @brief Description of a run written by run_file_sink.
+struct run_file {
+  /// Path of the file holding the run.
+  std::filesystem::path path;
+  /// Number of elements in the run.
+  std::uintmax_t size{0};
+};
+
+/// @brief A sink for replacement_selection that writes every run as raw
+/// binary elements to a file of its own.
+///
+/// The upper part of a run is buffered in a second file and appended in
+/// reverse order when the run is finished.
+///
+/// @tparam T A trivially copyable type of the elements.
+template<typename T>
+class run_file_sink {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "T must be trivially copyable");
+
+public:
+  /// @brief Creates a sink that writes the runs to a new directory in
+  /// @p parent, see directory().
+  ///
+  /// Every sink has a directory of its own, so sinks in the same @p parent,
+  /// even of different processes, never overwrite each other's runs.
+  /// @throws std::filesystem::filesystem_error if the directory cannot be
+  /// created.
+  explicit run_file_sink(
+    const std::filesystem::path& parent =
+      std::filesystem::temp_directory_path(),
+    std::size_t block_size = 1 << 16) :
+    run_directory{create_unique_directory(parent)}, block_size{block_size}
+  {
+    low_block.reserve(block_size);
+    high_block.reserve(block_size);
+    low_file.exceptions(std::ios::badbit | std::ios::failbit);
+    high_file.exceptions(std::ios::badbit | std::ios::failbit);
+  }
+
+  void push_low(const T& value)
+  {
+    low_block.push_back(value);
+    if (low_block.size() == block_size) {
+      write_low();
+    }
+  }
+
+  void push_high(const T& value)
+  {
+    high_block.push_back(value);
+    if (high_block.size() == block_size) {
+      if (!high_file.is_open()) {
+        high_file.open(high_path(),
+                       std::ios::binary | std::ios::in | std::ios::out
+                         | std::ios::trunc);
+      }
+      write(high_file, high_block);
+      ++high_blocks;
+      high_block.clear();
+    }
+  }
+
+  void finish_run()
+  {
+    // Append the upper part from its end to its beginning, i.e., the block in
+    // memory first and the blocks on disk in reverse order.
+    low_block.insert(low_block.end(), high_block.rbegin(), high_block.rend());
+    high_block.clear();
+    while (high_blocks > 0) {
+      --high_blocks;
+      write_low();
+      low_block.resize(block_size);
+      high_file.seekg(static_cast<std::streamoff>(high_blocks * block_size
+                                                  * sizeof(T)));
+      high_file.read(reinterpret_cast<char*>(low_block.data()),
+                     static_cast<std::streamsize>(block_size * sizeof(T)));
+      std::reverse(low_block.begin(), low_block.end());
+    }
+    write_low();
+    if (high_file.is_open()) {
+      high_file.close();
+      std::filesystem::remove(high_path());
+    }
+
+    low_file.close();
+    runs.push_back({run_path(), run_size});
+    run_size = 0;
+  }
+
+  /// @brief Returns the runs written so far.
+  const std::vector<run_file>& files() const noexcept
+  {
+    return runs;
+  }
+
+  /// @brief Returns the directory of the runs, the caller removes it when
+  /// the runs are merged.
+  const std::filesystem::path& directory() const noexcept
+  {
+    return run_directory;
+  }
+
+private:
+  std::filesystem::path run_path() const
+  {
+    return run_directory / ("run_" + std::to_string(runs.size()) + ".bin");
+  }
+
+  std::filesystem::path high_path() const
+  {
+    return run_directory / ("run_" + std::to_string(runs.size()) + ".high");
+  }
+
+  static void write(std::ostream& file, const std::vector<T>& block)
+  {
+    file.write(reinterpret_cast<const char*>(block.data()),
+               static_cast<std::streamsize>(block.size() * sizeof(T)));
+  }
+
+  void write_low()
+  {
+    if (!low_file.is_open()) {
+      low_file.open(run_path(), std::ios::binary | std::ios::trunc);
+    }
+    write(low_file, low_block);
+    run_size += low_block.size();
+    low_block.clear();
+  }
+
+  std::filesystem::path run_directory;
+  std::size_t           block_size;
+  std::vector<T>        low_block;
+  std::vector<T>        high_block;
+  std::uintmax_t        high_blocks{0};
+  std::uintmax_t        run_size{0};
+  std::ofstream         low_file;
+  std::fstream          high_file;
+  std::vector<run_file> runs;
+};
+
+/// @brief Reads raw binary elements from @p input until its end and writes
+/// sorted runs to a new directory in @p directory, see run_file_sink.
+///
+/// On POSIX systems a file descriptor can be turned into @p input with
+/// @c fdopen.
+///
+/// @tparam T A trivially copyable type of the elements.
+/// @tparam Compare Type of a binary functor to compare two elements.
+/// @param input Stream to read the elements from.
+/// @param capacity Number of elements kept in memory.
+/// @param directory Directory to create the directory of the runs in.
+/// @param comp Functor to determine which of two elements is considered
+/// smaller.
+/// @return The runs in the order they were written.
+template<typename T, typename Compare = std::less<>>
+std::vector<run_file> generate_runs(std::FILE*                   input,
+                                    std::size_t                  capacity,
+                                    const std::filesystem::path& directory,
+                                    Compare                      comp = {})
+{
+  replacement_selection<T, Compare> selection{capacity, comp};
+  run_file_sink<T>                  sink{directory};
+
+  std::vector<T> block(1 << 16);
+  for (;;) {
+    const auto n{std::fread(block.data(), sizeof(T), block.size(), input)};
+    for (std::size_t i{0}; i < n; ++i) {
+      selection.push(block[i], sink);
+    }
+    if (n < block.size()) {
+      if (std::ferror(input)) {
+        throw std::system_error{errno, std::generic_category(), "fread"};
+      }
+      break;
+    }
+  }
+  selection.flush(sink);
+
+  return sink.files();
+}
+
+}
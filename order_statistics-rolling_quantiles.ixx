@@ -0,0 +1,309 @@
+/// @file
+/// Rolling quantiles over many independent streams of samples.
+///
+/// Every stream keeps a window of its latest samples in an order statistics
+/// tree whose ranks are the requested quantiles. Instead of one container per
+/// stream, the windows of all streams live in a single arena of fixed-size
+/// slots. The samples are packed_element objects whose payload is the slot of
+/// the sample in the ring buffer of its window. The oldest sample is found
+/// through the recorded positions (see tracking_iterator), replaced by the new
+/// sample and the tree is restored.
+///
+/// Updating a random stream misses the cache several times in a row: The
+/// state of the stream, the position of its oldest sample and the tree nodes
+/// around it. A batch of updates is therefore processed in blocks of streams.
+/// Each block is swept several times and every sweep prefetches what the next
+/// sweep needs for all streams of the block, such that the misses of the block
+/// overlap instead of adding up.
+
+/// @cond
+module;
+/// @endcond
+
+// C++ Standard Library.
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+/// @cond
+export module order_statistics:rolling_quantiles;
+
+import :minmax_heaps;
+import :packed_keys;
+import :percentiles;
+import :tracking;
+import :trees;
+/// @endcond
+
+namespace order_statistics {
+
+/// @brief Returns the payload of a packed_element as its handle.
+struct payload_handle {
+  template<typename Key>
+  std::size_t operator()(const packed_element<Key>& element) const noexcept
+  {
+    return element.payload();
+  }
+};
+
+}
+
+export namespace order_statistics {
+
+/// @brief Rolling quantiles over the windows of many independent streams.
+///
+/// Until a stream has seen @c window samples, its quantiles are selected from
+/// the samples seen so far, all at once by the first read after a new sample,
+/// and cached until the next sample. Afterwards every new sample replaces the
+/// oldest one in <tt>O(m log n)</tt> for @c m quantiles and the quantiles are
+/// read in constant time. Because of the cache, quantile() must not be called
+/// concurrently.
+///
+/// @tparam T One of @c float, @c std::int32_t or @c std::uint32_t.
+template<typename T>
+class rolling_quantiles {
+public:
+  using value_type = T;
+  using size_type  = std::size_t;
+
+  /// @brief Number of streams a batch update processes at once.
+  static constexpr size_type block_size{16};
+
+  /// @brief Creates @p streams empty windows of @p window samples each.
+  /// @param streams Number of streams.
+  /// @param window Number of samples per window.
+  /// @param percentiles Percentiles in [0, 1] to maintain, e.g., 0.5 and 0.95.
+  rolling_quantiles(size_type               streams,
+                    size_type               window,
+                    std::span<const double> percentiles) :
+    stream_count{streams}, window_size{window}
+  {
+    if (window == 0 || window > std::numeric_limits<std::uint32_t>::max()) {
+      throw std::invalid_argument{"window must lie in [1, 2^32)"};
+    }
+    if (percentiles.empty()) {
+      throw std::invalid_argument{"no percentiles"};
+    }
+    // The greatest sample is the maximum of the last segment, no rank.
+    auto [window_ranks, index]{
+      make_percentile_ranks(percentiles, window, false)};
+    this->percentiles.assign(percentiles.begin(), percentiles.end());
+    for (const auto rank : window_ranks) {
+      rank_offsets.push_back(static_cast<std::uint32_t>(rank));
+    }
+    rank_index = std::move(index);
+    percentile_order.resize(this->percentiles.size());
+    std::iota(percentile_order.begin(), percentile_order.end(), size_type{0});
+    std::sort(percentile_order.begin(),
+              percentile_order.end(),
+              [&](size_type a, size_type b) {
+                return this->percentiles[a] < this->percentiles[b];
+              });
+
+    elements.resize(streams * window);
+    positions.resize(streams * window);
+    states.resize(streams);
+    ranks.resize(rank_offsets.size());
+  }
+
+  /// @brief Returns the number of streams.
+  size_type streams() const noexcept
+  {
+    return stream_count;
+  }
+
+  /// @brief Returns the number of samples per window.
+  size_type window() const noexcept
+  {
+    return window_size;
+  }
+
+  /// @brief Returns the number of samples in the window of @p stream.
+  size_type size(size_type stream) const
+  {
+    return states[stream].size;
+  }
+
+  /// @brief Adds @p value to the window of @p stream, the oldest sample drops
+  /// out of a full window.
+  void push(size_type stream, T value)
+  {
+    auto&      state{states[stream]};
+    const auto slot{state.head};
+    const packed_element<T> element{value, slot};
+
+    if (state.size < window_size) {
+      elements[stream * window_size + slot] = element;
+      positions[stream * window_size + slot] = slot;
+      if (++state.size == window_size) {
+        build(stream);
+      }
+    }
+    else {
+      const auto first{begin(stream)};
+      const auto it{first + positions[stream * window_size + slot]};
+      *it = element;
+      fill_ranks(first);
+      update_order_statistics_tree(
+        first, it, end(stream), ranks.begin(), ranks.end());
+    }
+    state.head = slot + 1 == window_size ? 0 : slot + 1;
+  }
+
+  /// @brief Adds @p values[i] to the window of @p streams[i] for all @c i.
+  ///
+  /// The updates are applied in order, a stream may occur several times.
+  /// Blocks of block_size updates are prefetched together.
+  ///
+  /// @param streams The streams to update.
+  /// @param values The new samples, same size as @p streams.
+  void push(std::span<const std::uint32_t> streams, std::span<const T> values)
+  {
+    if (streams.size() != values.size()) {
+      throw std::invalid_argument{"streams and values differ in size"};
+    }
+
+    for (size_type b{0}; b < streams.size(); b += block_size) {
+      const auto block{streams.subspan(
+        b, std::min(block_size, streams.size() - b))};
+
+      for (const auto stream : block) {
+        prefetch(&states[stream]);
+      }
+      for (const auto stream : block) {
+        prefetch(&positions[stream * window_size + states[stream].head]);
+      }
+      for (const auto stream : block) {
+        const auto& state{states[stream]};
+        if (state.size == window_size) {
+          const auto base{stream * window_size};
+          prefetch(&elements[base + positions[base + state.head]]);
+          for (const auto offset : rank_offsets) {
+            prefetch(&elements[base + offset]);
+          }
+        }
+      }
+      for (size_type i{0}; i < block.size(); ++i) {
+        push(block[i], values[b + i]);
+      }
+    }
+  }
+
+  /// @brief Returns the percentile @p i of the window of @p stream.
+  /// @param stream The stream, its window must not be empty.
+  /// @param i Index into the percentiles given to the constructor.
+  T quantile(size_type stream, size_type i) const
+  {
+    const auto& state{states[stream]};
+    if (state.size < window_size) {
+      return partial_quantiles(stream)[i];
+    }
+
+    const auto first{elements.begin()
+                     + static_cast<std::ptrdiff_t>(stream * window_size)};
+    const auto last{first + static_cast<std::ptrdiff_t>(state.size)};
+    const auto index{rank_index[i]};
+    if (index == percentile_ranks::greatest) {
+      const auto last_segment{
+        rank_offsets.empty() ? first : first + rank_offsets.back()};
+      return max_mm_heap(last_segment, last)->key();
+    }
+    return (first + static_cast<std::ptrdiff_t>(rank_offsets[index]))->key();
+  }
+
+private:
+  using element_iterator  = typename std::vector<packed_element<T>>::iterator;
+  using position_iterator = std::vector<std::uint32_t>::iterator;
+  using iterator =
+    tracking_iterator<element_iterator, position_iterator, payload_handle>;
+
+  /// @brief Ring buffer state of the window of a stream.
+  struct stream_state {
+    /// Slot of the oldest sample, i.e., the next slot to overwrite.
+    std::uint32_t head{0};
+    /// Number of samples in the window.
+    std::uint32_t size{0};
+  };
+
+  /// @brief Returns the percentiles of the window of @p stream, which is not
+  /// full, selected once per sample.
+  std::span<const T> partial_quantiles(size_type stream) const
+  {
+    const auto m{percentiles.size()};
+    if (cached_sizes.empty()) {
+      cached_sizes.resize(stream_count, 0);
+      cached_quantiles.resize(stream_count * m);
+    }
+    const std::span<T> cached{cached_quantiles.data() + stream * m, m};
+    const auto         size{states[stream].size};
+    if (cached_sizes[stream] != size) {
+      const auto first{elements.begin()
+                       + static_cast<std::ptrdiff_t>(stream * window_size)};
+      scratch.assign(first, first + size);
+      // Each selection only partitions the elements above the previous one.
+      auto prev{scratch.begin()};
+      for (const auto i : percentile_order) {
+        const auto nth{scratch.begin()
+                       + static_cast<std::ptrdiff_t>(
+                         percentile_rank(percentiles[i], size))};
+        std::nth_element(prev, nth, scratch.end());
+        cached[i] = nth->key();
+        prev      = nth;
+      }
+      cached_sizes[stream] = size;
+    }
+    return cached;
+  }
+
+  iterator begin(size_type stream)
+  {
+    const auto base{static_cast<std::ptrdiff_t>(stream * window_size)};
+    return {elements.begin() + base,
+            elements.begin() + base,
+            positions.begin() + base};
+  }
+
+  iterator end(size_type stream)
+  {
+    return begin(stream) + static_cast<std::ptrdiff_t>(window_size);
+  }
+
+  void fill_ranks(iterator first)
+  {
+    for (size_type i{0}; i < rank_offsets.size(); ++i) {
+      ranks[i] = first + rank_offsets[i];
+    }
+  }
+
+  /// @brief Turns the full window of @p stream into an order statistics tree.
+  void build(size_type stream)
+  {
+    const auto first{begin(stream)};
+    fill_ranks(first);
+    make_order_statistics_tree(first, end(stream), ranks.begin(), ranks.end());
+  }
+
+  size_type                      stream_count;
+  size_type                      window_size;
+  std::vector<double>            percentiles;
+  std::vector<std::uint32_t>     rank_offsets;
+  std::vector<size_type>         rank_index;
+  std::vector<packed_element<T>> elements;
+  std::vector<std::uint32_t>     positions;
+  std::vector<stream_state>      states;
+  std::vector<iterator>          ranks;
+  std::vector<size_type>         percentile_order;
+
+  // The cached percentiles of the windows that are not full yet, valid while
+  // the size of the window equals its entry in cached_sizes.
+  mutable std::vector<std::uint32_t>     cached_sizes;
+  mutable std::vector<T>                 cached_quantiles;
+  mutable std::vector<packed_element<T>> scratch;
+};
+
+}
@@ -0,0 +1,204 @@
+/// @file
+/// A running median of two min-max heaps.
+///
+/// The lower half of the elements is kept in one min-max heap, the upper half
+/// in another one. The median is the minimum of the upper half. Since both
+/// halves are min-max heaps, the greatest element of the lower half and the
+/// second smallest element of the upper half, i.e., the neighbours of the
+/// median, are found in constant time as well.
+///
+/// Compared to an order statistics tree with a single rank, the halves move
+/// at most one element between each other per insertion or removal and the
+/// element to remove is searched in one half only.
+
+/// @cond
+module;
+/// @endcond
+
+// C++ Standard Library.
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+/// @cond
+export module order_statistics:running_median;
+
+import :minmax_heaps;
+/// @endcond
+
+namespace order_statistics {
+
+/// @brief Returns an iterator to the second smallest element of the min-max
+/// heap [@p first, @p last) of at least two elements.
+///
+/// The second smallest element is the smallest element of the subtrees of the
+/// children of the root. A child on a max level is the greatest element of its
+/// subtree, so the candidates are the children and the grandchildren.
+template<typename RandomIt, typename Compare>
+RandomIt second_min_mm_heap(RandomIt first, RandomIt last, Compare comp)
+{
+  const auto candidates{std::min<std::ptrdiff_t>(last - first, 7)};
+  return std::min_element(first + 1, first + candidates, comp);
+}
+
+}
+
+export namespace order_statistics {
+
+/// @brief The running median of a multiset of elements.
+///
+/// The median of @c n elements is the element of rank <tt>n / 2</tt>, i.e.,
+/// the upper median for an even @c n.
+///
+/// @tparam T Type of the elements.
+/// @tparam Compare Type of a binary functor to compare two elements.
+template<typename T, typename Compare = std::less<>>
+class running_median {
+public:
+  using value_type      = T;
+  using size_type       = std::size_t;
+  using const_reference = const T&;
+
+  /// @brief Creates an empty running median.
+  explicit running_median(Compare comp = {}) : comp{comp}
+  {
+  }
+
+  /// @brief Returns @c true if there are no elements.
+  bool empty() const noexcept
+  {
+    return upper.empty();
+  }
+
+  /// @brief Returns the number of elements.
+  size_type size() const noexcept
+  {
+    return lower.size() + upper.size();
+  }
+
+  /// @brief Returns the median. There must be at least one element.
+  const_reference median() const
+  {
+    return upper.front();
+  }
+
+  /// @brief Returns @c true if there is an element of rank <tt>n / 2 - 1</tt>.
+  bool has_predecessor() const noexcept
+  {
+    return !lower.empty();
+  }
+
+  /// @brief Returns the element of rank <tt>n / 2 - 1</tt>, i.e., the
+  /// greatest element smaller than or equal to the median.
+  const_reference predecessor() const
+  {
+    return *max_mm_heap(lower.begin(), lower.end(), comp);
+  }
+
+  /// @brief Returns @c true if there is an element of rank <tt>n / 2 + 1</tt>.
+  bool has_successor() const noexcept
+  {
+    return upper.size() > 1;
+  }
+
+  /// @brief Returns the element of rank <tt>n / 2 + 1</tt>, i.e., the
+  /// smallest element greater than or equal to the median.
+  const_reference successor() const
+  {
+    return *second_min_mm_heap(upper.begin(), upper.end(), comp);
+  }
+
+  /// @brief Adds @p value.
+  void insert(T value)
+  {
+    auto& half{belongs_to_lower(value) ? lower : upper};
+    half.push_back(std::move(value));
+    push_mm_heap(half.begin(), half.end(), comp);
+    rebalance();
+  }
+
+  /// @brief Removes an element equivalent to @p value.
+  /// @return @c false if there is no such element.
+  bool erase(const T& value)
+  {
+    auto&      half{belongs_to_lower(value) ? lower : upper};
+    const auto it{find_mm_heap(half.begin(), half.end(), value, comp)};
+    if (it == half.end()) {
+      return false;
+    }
+    erase_mm_heap(half.begin(), it, half.end(), comp);
+    half.pop_back();
+    rebalance();
+    return true;
+  }
+
+  /// @brief Replaces an element equivalent to @p out by @p in, e.g., when a
+  /// window slides over a signal.
+  ///
+  /// If both belong to the same half, @p in takes the place of @p out in that
+  /// half and no element moves between the halves.
+  ///
+  /// @return @c false if there is no element equivalent to @p out, @p in is
+  /// not inserted then.
+  bool slide(const T& out, T in)
+  {
+    auto&      half{belongs_to_lower(out) ? lower : upper};
+    const auto same_half{belongs_to_lower(out) == belongs_to_lower(in)};
+    const auto it{find_mm_heap(half.begin(), half.end(), out, comp)};
+    if (it == half.end()) {
+      return false;
+    }
+    erase_mm_heap(half.begin(), it, half.end(), comp);
+
+    if (same_half) {
+      half.back() = std::move(in);
+      push_mm_heap(half.begin(), half.end(), comp);
+    }
+    else {
+      half.pop_back();
+      insert(std::move(in));
+    }
+    return true;
+  }
+
+  /// @brief Removes all elements.
+  void clear() noexcept
+  {
+    lower.clear();
+    upper.clear();
+  }
+
+private:
+  /// @brief Returns @c true if @p value is smaller than the median, i.e., it
+  /// belongs to the lower half.
+  bool belongs_to_lower(const T& value) const
+  {
+    return !upper.empty() && comp(value, upper.front());
+  }
+
+  /// @brief Moves elements between the halves until the upper half has the
+  /// same number of elements as the lower half or one more.
+  void rebalance()
+  {
+    while (lower.size() > upper.size()) {
+      pop_max_mm_heap(lower.begin(), lower.end(), comp);
+      upper.push_back(std::move(lower.back()));
+      lower.pop_back();
+      push_mm_heap(upper.begin(), upper.end(), comp);
+    }
+    while (upper.size() > lower.size() + 1) {
+      pop_mm_heap(upper.begin(), upper.end(), comp);
+      lower.push_back(std::move(upper.back()));
+      upper.pop_back();
+      push_mm_heap(lower.begin(), lower.end(), comp);
+    }
+  }
+
+  Compare        comp;
+  std::vector<T> lower;
+  std::vector<T> upper;
+};
+
+}
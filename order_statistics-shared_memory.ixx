@@ -0,0 +1,573 @@
+/// @file
+/// An order statistics tree in a POSIX shared-memory segment.
+///
+/// One writer process maintains the tree, any number of reader processes map
+/// the segment and read the elements of the ranks. The segment holds no
+/// pointers, only offsets from its start, so every process may map it at a
+/// different address. It consists of
+///
+/// 1. a header with the layout of the segment, the number of elements and a
+///    sequence number,
+/// 2. the positions of the ranks,
+/// 3. the pivots: copies of the elements of the ranks, the smallest and the
+///    greatest element,
+/// 4. the elements of the tree, up to a fixed capacity.
+///
+/// The pivots are protected by a seqlock: The writer increments the sequence
+/// number before and after it copies new pivots, a reader retries until it
+/// saw the same even sequence number before and after reading. Readers
+/// neither block the writer nor each other and read a rank in O(1) without a
+/// system call. A reader gives up after a timeout if the sequence number stays
+/// odd, e.g., since the writer died while it copied the pivots.
+
+/// @cond
+module;
+/// @endcond
+
+// C++ Standard Library.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// POSIX.
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// @cond
+export module order_statistics:shared_memory;
+
+import :containers;
+import :minmax_heaps;
+import :trees;
+/// @endcond
+
+#if defined(__unix__) || defined(__APPLE__)
+namespace order_statistics {
+
+/// @brief The header at the start of a shared-memory segment.
+struct shared_tree_header {
+  static constexpr std::uint64_t format_magic{0x5453544154534f53};
+  static constexpr std::uint64_t format_version{1};
+
+  std::uint64_t magic;
+  std::uint64_t version;
+  std::uint64_t element_size;
+  std::uint64_t capacity;
+  std::uint64_t rank_count;
+  std::uint64_t positions_offset;
+  std::uint64_t pivots_offset;
+  std::uint64_t elements_offset;
+  /// Odd while the writer updates the pivots.
+  alignas(64) std::atomic<std::uint64_t> sequence;
+  std::atomic<std::uint64_t> size;
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free);
+
+/// @brief Rounds @p offset up to a multiple of @p alignment.
+constexpr std::uint64_t align_offset(std::uint64_t offset,
+                                     std::uint64_t alignment) noexcept
+{
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+/// @brief A mapping of a shared-memory segment, unmapped on destruction.
+class shared_mapping {
+public:
+  shared_mapping() = default;
+
+  shared_mapping(void* address, std::size_t size) noexcept :
+    address{address}, length{size}
+  {
+  }
+
+  shared_mapping(shared_mapping&& other) noexcept :
+    address{std::exchange(other.address, nullptr)},
+    length{std::exchange(other.length, 0)}
+  {
+  }
+
+  shared_mapping& operator=(shared_mapping&& other) noexcept
+  {
+    std::swap(address, other.address);
+    std::swap(length, other.length);
+    return *this;
+  }
+
+  ~shared_mapping()
+  {
+    if (address != nullptr) {
+      ::munmap(address, length);
+    }
+  }
+
+  std::byte* data() const noexcept
+  {
+    return static_cast<std::byte*>(address);
+  }
+
+  std::size_t size() const noexcept
+  {
+    return length;
+  }
+
+private:
+  void*       address{nullptr};
+  std::size_t length{0};
+};
+
+/// @brief Maps the shared-memory segment @p name.
+/// @param size Size of a new segment, 0 to open an existing one.
+/// @param writable Maps the segment for reading and writing.
+/// @throws std::system_error if the segment cannot be created or opened.
+inline shared_mapping
+map_segment(const std::string& name, std::size_t size, bool writable)
+{
+  const auto create{size > 0};
+  const auto fd{::shm_open(name.c_str(),
+                           create ? O_RDWR | O_CREAT | O_EXCL
+                                    : (writable ? O_RDWR : O_RDONLY),
+                           0600)};
+  if (fd < 0) {
+    throw std::system_error{errno, std::generic_category(), name};
+  }
+  struct stat status {};
+  if ((create && ::ftruncate(fd, static_cast<off_t>(size)) != 0)
+      || (!create && ::fstat(fd, &status) != 0)) {
+    const auto error{errno};
+    ::close(fd);
+    if (create) {
+      ::shm_unlink(name.c_str());
+    }
+    throw std::system_error{error, std::generic_category(), name};
+  }
+  if (!create) {
+    size = static_cast<std::size_t>(status.st_size);
+  }
+  const auto address{::mmap(nullptr,
+                            size,
+                            writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                            MAP_SHARED,
+                            fd,
+                            0)};
+  const auto error{errno};
+  ::close(fd);
+  if (address == MAP_FAILED) {
+    if (create) {
+      ::shm_unlink(name.c_str());
+    }
+    throw std::system_error{error, std::generic_category(), name};
+  }
+  return {address, size};
+}
+
+}
+#endif
+
+export namespace order_statistics {
+
+#if defined(__unix__) || defined(__APPLE__)
+/// @brief An order statistics tree in the shared-memory segment @c name,
+/// maintained by a single writer.
+///
+/// The segment is created by the constructor and removed by the destructor.
+/// Readers open it with shared_order_statistics_reader.
+///
+/// @tparam T Type of the elements, must be trivially copyable.
+/// @tparam Compare Type of a binary functor to compare two elements.
+template<typename T, typename Compare = std::less<>>
+class shared_order_statistics_tree {
+  static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+  using value_type      = T;
+  using size_type       = std::size_t;
+  using const_reference = const T&;
+
+  /// @brief Creates the segment @p name and builds a tree of @p elements in
+  /// it.
+  /// @param name Name of the segment, e.g., "/latencies".
+  /// @param elements The elements of the tree.
+  /// @param ranks Strictly increasing positions less than the number of
+  /// elements.
+  /// @param capacity Maximum number of elements.
+  /// @param comp Functor to determine which of two elements is considered
+  /// smaller.
+  /// @throws std::invalid_argument if the ranks are invalid.
+  /// @throws std::length_error if there are more elements than @p capacity.
+  /// @throws std::system_error if the segment cannot be created, e.g., since
+  /// it exists.
+  shared_order_statistics_tree(std::string            name,
+                               std::span<const T>     elements,
+                               std::vector<size_type> ranks,
+                               size_type              capacity,
+                               Compare                comp = {}) :
+    comp{comp}, segment_name{std::move(name)}, positions{std::move(ranks)}
+  {
+    check_ranks(elements.size(), positions);
+    if (elements.size() > capacity) {
+      throw std::length_error{"more elements than capacity"};
+    }
+
+    const auto pivot_alignment{std::max<std::uint64_t>(alignof(T), 8)};
+    const auto positions_offset{
+      align_offset(sizeof(shared_tree_header), alignof(std::uint64_t))};
+    const auto pivots_offset{align_offset(
+      positions_offset + positions.size() * sizeof(std::uint64_t),
+      pivot_alignment)};
+    const auto elements_offset{align_offset(
+      pivots_offset + (positions.size() + 2) * sizeof(T), 64)};
+    mapping = map_segment(
+      segment_name,
+      static_cast<std::size_t>(elements_offset + capacity * sizeof(T)),
+      true);
+
+    header = new (mapping.data()) shared_tree_header{
+      shared_tree_header::format_magic,
+      shared_tree_header::format_version,
+      sizeof(T),
+      capacity,
+      positions.size(),
+      positions_offset,
+      pivots_offset,
+      elements_offset,
+      {0},
+      {0}};
+    std::uninitialized_copy(
+      positions.begin(),
+      positions.end(),
+      reinterpret_cast<std::uint64_t*>(mapping.data() + positions_offset));
+    pivots = reinterpret_cast<T*>(mapping.data() + pivots_offset);
+    values = reinterpret_cast<T*>(mapping.data() + elements_offset);
+    std::uninitialized_copy(elements.begin(), elements.end(), values);
+    count = elements.size();
+
+    const auto& rank_its{rank_iterators()};
+    make_order_statistics_tree(
+      values, values + count, rank_its.begin(), rank_its.end(), comp);
+    publish();
+  }
+
+  shared_order_statistics_tree(const shared_order_statistics_tree&) = delete;
+  shared_order_statistics_tree&
+  operator=(const shared_order_statistics_tree&) = delete;
+
+  /// @brief Removes the segment, mapped segments stay valid.
+  ~shared_order_statistics_tree()
+  {
+    ::shm_unlink(segment_name.c_str());
+  }
+
+  /// @brief Returns the name of the segment.
+  const std::string& name() const noexcept
+  {
+    return segment_name;
+  }
+
+  /// @brief Returns the number of elements.
+  size_type size() const noexcept
+  {
+    return count;
+  }
+
+  /// @brief Returns the maximum number of elements.
+  size_type capacity() const noexcept
+  {
+    return static_cast<size_type>(header->capacity);
+  }
+
+  /// @brief Returns the positions of the ranks.
+  std::span<const size_type> ranks() const noexcept
+  {
+    return positions;
+  }
+
+  /// @brief Returns the element of the rank @p i.
+  const_reference at_rank(size_type i) const
+  {
+    return values[positions[i]];
+  }
+
+  /// @brief Returns all elements, the elements between two ranks are
+  /// consecutive (range-query).
+  std::span<const T> elements() const noexcept
+  {
+    return {values, count};
+  }
+
+  /// @brief Adds @p value and publishes the new pivots.
+  /// @throws std::length_error if the tree is full.
+  void push(const T& value)
+  {
+    insert(std::span<const T>{&value, 1});
+  }
+
+  /// @brief Adds all @p batch and publishes the new pivots once.
+  /// @throws std::length_error if the elements do not fit.
+  void insert(std::span<const T> batch)
+  {
+    if (batch.size() > capacity() - count) {
+      throw std::length_error{"more elements than capacity"};
+    }
+    std::uninitialized_copy(batch.begin(), batch.end(), values + count);
+    const auto& rank_its{rank_iterators()};
+    for (const auto last{count + batch.size()}; count < last;) {
+      ++count;
+      push_order_statistics_tree(
+        values, values + count, rank_its.begin(), rank_its.end(), comp);
+    }
+    publish();
+  }
+
+private:
+  const std::vector<T*>& rank_iterators()
+  {
+    iterators.resize(positions.size());
+    for (size_type i{0}; i < positions.size(); ++i) {
+      iterators[i] = values + positions[i];
+    }
+    return iterators;
+  }
+
+  /// @brief Copies the pivots to the header under the seqlock.
+  void publish() noexcept
+  {
+    const auto sequence{header->sequence.load(std::memory_order_relaxed)};
+    header->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (size_type i{0}; i < positions.size(); ++i) {
+      std::memcpy(&pivots[i], &values[positions[i]], sizeof(T));
+    }
+    if (count > 0) {
+      const auto last_segment{positions.empty() ? 0 : positions.back()};
+      std::memcpy(&pivots[positions.size()], values, sizeof(T));
+      std::memcpy(&pivots[positions.size() + 1],
+                  max_mm_heap(values + last_segment, values + count, comp),
+                  sizeof(T));
+    }
+    header->size.store(count, std::memory_order_relaxed);
+
+    header->sequence.store(sequence + 2, std::memory_order_release);
+  }
+
+  Compare                comp;
+  std::string            segment_name;
+  std::vector<size_type> positions;
+  std::vector<T*>        iterators;
+  shared_mapping         mapping;
+  shared_tree_header*    header{nullptr};
+  T*                     pivots{nullptr};
+  T*                     values{nullptr};
+  size_type              count{0};
+};
+
+/// @brief The pivots of a shared_order_statistics_tree, read consistently.
+template<typename T>
+struct shared_tree_snapshot {
+  /// Number of elements of the tree.
+  std::size_t size{0};
+  /// The element of every rank.
+  std::vector<T> ranks;
+  /// The smallest and the greatest element, undefined if the tree is empty.
+  T min{};
+  T max{};
+};
+
+/// @brief Reads the pivots of a shared_order_statistics_tree of another
+/// process.
+///
+/// All reads are lock-free and wait only while the writer copies the pivots,
+/// at most for the timeout of the reader.
+///
+/// @tparam T Type of the elements, the same as the writer's.
+template<typename T>
+class shared_order_statistics_reader {
+  static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+  using value_type = T;
+  using size_type  = std::size_t;
+
+  /// @brief Maps the segment @p name.
+  /// @param name Name of the segment.
+  /// @param timeout How long a read waits for the writer to finish copying
+  /// the pivots.
+  /// @throws std::system_error if the segment cannot be opened.
+  /// @throws std::runtime_error if the segment holds no tree of @c T or its
+  /// positions or pivots lie outside of the segment.
+  explicit shared_order_statistics_reader(
+    const std::string&                  name,
+    std::chrono::steady_clock::duration timeout = std::chrono::seconds{1}) :
+    mapping{map_segment(name, 0, false)},
+    header{reinterpret_cast<const shared_tree_header*>(mapping.data())},
+    timeout{timeout}
+  {
+    if (mapping.size() < sizeof(shared_tree_header)
+        || header->magic != shared_tree_header::format_magic
+        || header->version != shared_tree_header::format_version
+        || header->element_size != sizeof(T)) {
+      throw std::runtime_error{"segment holds no tree of this type"};
+    }
+    // The header is the writer's, but a segment of the same name may be
+    // anybody's: Every offset is checked against the size of the mapping.
+    const std::uint64_t size{mapping.size()};
+    const auto          ranks{header->rank_count};
+    if (ranks > size
+        || !fits<std::uint64_t>(header->positions_offset, ranks, size)
+        || !fits<T>(header->pivots_offset, ranks + 2, size)) {
+      throw std::runtime_error{"segment is too small for its tree"};
+    }
+    positions = reinterpret_cast<const std::uint64_t*>(
+      mapping.data() + header->positions_offset);
+    pivots = reinterpret_cast<const T*>(mapping.data() + header->pivots_offset);
+  }
+
+  /// @brief Returns the number of ranks.
+  size_type rank_count() const noexcept
+  {
+    return static_cast<size_type>(header->rank_count);
+  }
+
+  /// @brief Returns the position of the rank @p i.
+  /// @throws std::out_of_range unless @p i < rank_count().
+  size_type position(size_type i) const
+  {
+    if (i >= rank_count()) {
+      throw std::out_of_range{"rank out of range"};
+    }
+    return static_cast<size_type>(positions[i]);
+  }
+
+  /// @brief Returns the number of elements.
+  size_type size() const noexcept
+  {
+    return static_cast<size_type>(
+      header->size.load(std::memory_order_acquire));
+  }
+
+  /// @brief Returns the element of the rank @p i, or min() and max() for
+  /// rank_count() and rank_count() + 1.
+  /// @throws std::out_of_range unless @p i <= rank_count() + 1.
+  /// @throws std::system_error with std::errc::timed_out if the writer does
+  /// not finish copying the pivots within the timeout.
+  T at_rank(size_type i) const
+  {
+    if (i > rank_count() + 1) {
+      throw std::out_of_range{"rank out of range"};
+    }
+    return pivot(i);
+  }
+
+  /// @brief Returns the smallest element, undefined if the tree is empty.
+  /// @throws std::system_error on a timeout, see at_rank().
+  T min() const
+  {
+    return pivot(rank_count());
+  }
+
+  /// @brief Returns the greatest element, undefined if the tree is empty.
+  /// @throws std::system_error on a timeout, see at_rank().
+  T max() const
+  {
+    return pivot(rank_count() + 1);
+  }
+
+  /// @brief Returns all pivots and the size of the same version of the tree.
+  /// @throws std::system_error on a timeout, see at_rank().
+  shared_tree_snapshot<T> snapshot() const
+  {
+    shared_tree_snapshot<T> result;
+    result.ranks.resize(rank_count());
+    read([&] {
+      result.size = static_cast<size_type>(
+        header->size.load(std::memory_order_relaxed));
+      std::memcpy(result.ranks.data(), pivots, rank_count() * sizeof(T));
+      std::memcpy(&result.min, &pivots[rank_count()], sizeof(T));
+      std::memcpy(&result.max, &pivots[rank_count() + 1], sizeof(T));
+    });
+    return result;
+  }
+
+private:
+  /// @brief Returns @c true if @p count objects of type @c U at @p offset
+  /// are aligned and lie within the first @p size bytes.
+  template<typename U>
+  static bool
+  fits(std::uint64_t offset, std::uint64_t count, std::uint64_t size) noexcept
+  {
+    return offset % alignof(U) == 0 && offset <= size
+           && count <= (size - offset) / sizeof(U);
+  }
+
+  /// @brief Returns the pivot @p i, which must lie in the segment.
+  T pivot(size_type i) const
+  {
+    T value;
+    read([&] { std::memcpy(&value, &pivots[i], sizeof(T)); });
+    return value;
+  }
+
+  /// @brief Calls @p copy until it ran while the writer left the pivots
+  /// alone.
+  ///
+  /// The writer copies the pivots in far less than a time slice: The first
+  /// attempts retry at once, later ones yield until the timeout expires.
+  /// @throws std::system_error with std::errc::timed_out on a timeout.
+  template<typename Copy>
+  void read(Copy copy) const
+  {
+    constexpr unsigned                    spins{64};
+    std::chrono::steady_clock::time_point deadline;
+    for (unsigned attempt{0};; ++attempt) {
+      const auto before{header->sequence.load(std::memory_order_acquire)};
+      if (before % 2 == 0) {
+        copy();
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header->sequence.load(std::memory_order_relaxed) == before) {
+          return;
+        }
+      }
+      if (attempt < spins) {
+        continue;
+      }
+      const auto now{std::chrono::steady_clock::now()};
+      if (attempt == spins) {
+        deadline = now + timeout;
+      }
+      else if (now >= deadline) {
+        throw std::system_error{std::make_error_code(std::errc::timed_out),
+                                "the writer did not finish publishing"};
+      }
+      std::this_thread::yield();
+    }
+  }
+
+  shared_mapping                      mapping;
+  const shared_tree_header*           header;
+  std::chrono::steady_clock::duration timeout;
+  const std::uint64_t*                positions{nullptr};
+  const T*                            pivots{nullptr};
+};
+#endif
+
+}
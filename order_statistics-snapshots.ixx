@@ -0,0 +1,416 @@
+/// @file
+/// A binary snapshot format for order statistics trees.
+///
+/// An order statistics tree is a flat sequence, so a snapshot stores the
+/// elements exactly as they are laid out and is loaded without rebuilding
+/// the tree. A snapshot file consists of
+///
+/// 1. a header: a magic number, which also tells the byte order, the format
+///    version, the size of an element, the number of elements and ranks, a
+///    hash of the identity of the comparator, a checksum and the offset of
+///    the elements,
+/// 2. the positions of the ranks as 64-bit integers,
+/// 3. the elements, at an offset that is a multiple of 64.
+///
+/// Loading maps the file and checks the header, the checksum and the order
+/// statistics tree properties, all in linear time.
+
+/// @cond
+module;
+/// @endcond
+
+// C++ Standard Library.
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+// POSIX.
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// @cond
+export module order_statistics:snapshots;
+
+import :containers;
+import :minmax_heaps;
+import :shared_memory;
+import :trees;
+/// @endcond
+
+export namespace order_statistics {
+
+/// @brief The name under which snapshots identify the comparator @c Compare.
+///
+/// A snapshot is only loaded with the comparator it was saved with.
+/// Specialize it for other comparators or pass the name explicitly.
+template<typename Compare>
+struct comparator_identity {
+  static constexpr std::string_view name{};
+};
+
+template<typename T>
+struct comparator_identity<std::less<T>> {
+  static constexpr std::string_view name{"std::less"};
+};
+
+template<typename T>
+struct comparator_identity<std::greater<T>> {
+  static constexpr std::string_view name{"std::greater"};
+};
+
+}
+
+namespace order_statistics {
+
+/// @brief The header of a snapshot file.
+struct snapshot_header {
+  static constexpr std::uint64_t format_magic{0x544f4e5350415453};
+  static constexpr std::uint64_t format_version{1};
+  static constexpr std::uint64_t elements_alignment{64};
+
+  std::uint64_t magic;
+  std::uint64_t version;
+  std::uint64_t element_size;
+  std::uint64_t size;
+  std::uint64_t rank_count;
+  std::uint64_t comparator;
+  std::uint64_t checksum;
+  std::uint64_t elements_offset;
+};
+
+/// @brief Returns the FNV-1a hash of @p name.
+constexpr std::uint64_t comparator_hash(std::string_view name) noexcept
+{
+  std::uint64_t hash{0xcbf29ce484222325};
+  for (const auto c : name) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3;
+  }
+  return hash;
+}
+
+/// @brief Returns a checksum of @p bytes.
+///
+/// Four independent lanes of 64-bit words, each word is mixed in with a
+/// multiplication and a rotation.
+inline std::uint64_t snapshot_checksum(std::span<const std::byte> bytes,
+                                       std::uint64_t seed) noexcept
+{
+  constexpr std::uint64_t prime{0x9e3779b97f4a7c15};
+
+  std::uint64_t lanes[4]{seed, seed + 1, seed + 2, seed + 3};
+  std::size_t   i{0};
+  for (; i + sizeof(lanes) <= bytes.size(); i += sizeof(lanes)) {
+    for (std::size_t lane{0}; lane < 4; ++lane) {
+      std::uint64_t word;
+      std::memcpy(&word, bytes.data() + i + lane * sizeof(word), sizeof(word));
+      lanes[lane] = std::rotl((lanes[lane] ^ word) * prime, 31);
+    }
+  }
+  std::uint64_t hash{bytes.size()};
+  for (const auto lane : lanes) {
+    hash = std::rotl((hash ^ lane) * prime, 27);
+  }
+  for (; i < bytes.size(); ++i) {
+    hash = (hash ^ std::to_integer<std::uint64_t>(bytes[i])) * prime;
+  }
+  return hash ^ (hash >> 32);
+}
+
+/// @brief Returns the checksum of the ranks, padding included, and the
+/// elements of a snapshot.
+inline std::uint64_t snapshot_checksum(std::span<const std::byte> ranks,
+                                       std::span<const std::byte> elements)
+{
+  return snapshot_checksum(elements, snapshot_checksum(ranks, 0));
+}
+
+/// @brief Returns the bytes of the file at @p path, mapped if possible.
+class snapshot_file {
+public:
+  /// @throws std::system_error if the file cannot be read.
+  explicit snapshot_file(const std::filesystem::path& path)
+  {
+#if defined(__unix__) || defined(__APPLE__)
+    const auto fd{::open(path.c_str(), O_RDONLY)};
+    if (fd < 0) {
+      throw std::system_error{errno, std::generic_category(), path.string()};
+    }
+    struct stat status {};
+    if (::fstat(fd, &status) != 0) {
+      const auto error{errno};
+      ::close(fd);
+      throw std::system_error{error, std::generic_category(), path.string()};
+    }
+    length = static_cast<std::size_t>(status.st_size);
+    if (length > 0) {
+      const auto address{
+        ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0)};
+      const auto error{errno};
+      ::close(fd);
+      if (address == MAP_FAILED) {
+        throw std::system_error{error, std::generic_category(), path.string()};
+      }
+      mapping = {address, length};
+    }
+    else {
+      ::close(fd);
+    }
+#else
+    std::ifstream file{path, std::ios::binary};
+    if (!file) {
+      throw std::system_error{std::make_error_code(std::errc::io_error),
+                              path.string()};
+    }
+    length = static_cast<std::size_t>(std::filesystem::file_size(path));
+    buffer.resize((length + sizeof(std::max_align_t) - 1)
+                  / sizeof(std::max_align_t));
+    if (!file.read(reinterpret_cast<char*>(buffer.data()),
+                   static_cast<std::streamsize>(length))) {
+      throw std::system_error{std::make_error_code(std::errc::io_error),
+                              path.string()};
+    }
+#endif
+  }
+
+  std::span<const std::byte> bytes() const noexcept
+  {
+#if defined(__unix__) || defined(__APPLE__)
+    return {mapping.data(), length};
+#else
+    return {reinterpret_cast<const std::byte*>(buffer.data()), length};
+#endif
+  }
+
+private:
+  std::size_t length{0};
+#if defined(__unix__) || defined(__APPLE__)
+  shared_mapping mapping;
+#else
+  std::vector<std::max_align_t> buffer;
+#endif
+};
+
+}
+
+export namespace order_statistics {
+
+/// @brief Writes @p tree to a snapshot file at @p path.
+///
+/// @tparam T Type of the elements, must be trivially copyable.
+/// @param comparator Identity of the comparator, see comparator_identity.
+/// @throws std::invalid_argument if @p comparator is empty.
+/// @throws std::runtime_error if the file cannot be written.
+template<typename T, typename Compare>
+void save_snapshot(
+  const std::filesystem::path&             path,
+  const order_statistics_tree<T, Compare>& tree,
+  std::string_view comparator = comparator_identity<Compare>::name)
+{
+  static_assert(std::is_trivially_copyable_v<T>);
+  if (comparator.empty()) {
+    throw std::invalid_argument{"comparator has no identity"};
+  }
+
+  constexpr auto alignment{snapshot_header::elements_alignment};
+  const auto     elements_offset{
+    (sizeof(snapshot_header) + tree.ranks().size() * sizeof(std::uint64_t)
+     + alignment - 1)
+    / alignment * alignment};
+  std::vector<std::byte>     ranks(elements_offset - sizeof(snapshot_header));
+  std::vector<std::uint64_t> positions(tree.ranks().begin(),
+                                       tree.ranks().end());
+  std::memcpy(ranks.data(),
+              positions.data(),
+              positions.size() * sizeof(std::uint64_t));
+  const auto elements{std::as_bytes(tree.elements())};
+
+  const snapshot_header header{snapshot_header::format_magic,
+                               snapshot_header::format_version,
+                               sizeof(T),
+                               tree.size(),
+                               tree.ranks().size(),
+                               comparator_hash(comparator),
+                               snapshot_checksum(ranks, elements),
+                               elements_offset};
+  std::ofstream file{path, std::ios::binary | std::ios::trunc};
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(ranks.data()),
+             static_cast<std::streamsize>(ranks.size()));
+  file.write(reinterpret_cast<const char*>(elements.data()),
+             static_cast<std::streamsize>(elements.size()));
+  file.close();
+  if (!file) {
+    throw std::runtime_error{"cannot write snapshot " + path.string()};
+  }
+}
+
+/// @brief A read-only order statistics tree loaded from a snapshot file.
+///
+/// The elements stay in the mapped file, nothing is copied or rebuilt.
+///
+/// @tparam T Type of the elements, must be trivially copyable.
+/// @tparam Compare Type of a binary functor to compare two elements.
+template<typename T, typename Compare = std::less<>>
+class order_statistics_snapshot {
+  static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+  using value_type      = T;
+  using size_type       = std::size_t;
+  using const_reference = const T&;
+
+  /// @brief Loads the snapshot at @p path and checks it in linear time.
+  /// @param comp Functor to determine which of two elements is considered
+  /// smaller.
+  /// @param comparator Identity of the comparator, see comparator_identity.
+  /// @throws std::system_error if the file cannot be read.
+  /// @throws std::runtime_error if the file is no valid snapshot of a tree of
+  /// @c T with this comparator.
+  explicit order_statistics_snapshot(
+    const std::filesystem::path& path,
+    Compare                      comp = {},
+    std::string_view comparator = comparator_identity<Compare>::name) :
+    comp{comp}, file{path}
+  {
+    const auto bytes{file.bytes()};
+    snapshot_header header{};
+    if (bytes.size() < sizeof(header)) {
+      throw std::runtime_error{"not a snapshot"};
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (header.magic != snapshot_header::format_magic) {
+      throw std::runtime_error{"not a snapshot of this byte order"};
+    }
+    if (header.version != snapshot_header::format_version) {
+      throw std::runtime_error{"unsupported snapshot version"};
+    }
+    if (header.element_size != sizeof(T)) {
+      throw std::runtime_error{"snapshot of another element type"};
+    }
+    if (comparator.empty()
+        || header.comparator != comparator_hash(comparator)) {
+      throw std::runtime_error{"snapshot of another comparator"};
+    }
+    if (header.elements_offset % snapshot_header::elements_alignment != 0
+        || header.elements_offset < sizeof(header)
+        || (header.elements_offset - sizeof(header)) / sizeof(std::uint64_t)
+             < header.rank_count
+        || header.elements_offset > bytes.size()
+        || (bytes.size() - header.elements_offset) / sizeof(T) != header.size
+        || (bytes.size() - header.elements_offset) % sizeof(T) != 0) {
+      throw std::runtime_error{"truncated snapshot"};
+    }
+    const auto rank_bytes{bytes.subspan(
+      sizeof(header), header.elements_offset - sizeof(header))};
+    const auto element_bytes{bytes.subspan(header.elements_offset)};
+    if (snapshot_checksum(rank_bytes, element_bytes) != header.checksum) {
+      throw std::runtime_error{"snapshot checksum mismatch"};
+    }
+
+    positions.resize(header.rank_count);
+    for (size_type i{0}; i < positions.size(); ++i) {
+      std::uint64_t position;
+      std::memcpy(&position,
+                  rank_bytes.data() + i * sizeof(position),
+                  sizeof(position));
+      if (position >= header.size || (i > 0 && positions[i - 1] >= position)) {
+        throw std::runtime_error{"invalid snapshot ranks"};
+      }
+      positions[i] = static_cast<size_type>(position);
+    }
+    values = {reinterpret_cast<const T*>(element_bytes.data()),
+              static_cast<size_type>(header.size)};
+
+    std::vector<const T*> rank_its;
+    for (const auto position : positions) {
+      rank_its.push_back(values.data() + position);
+    }
+    if (!is_order_statistics_tree(values.data(),
+                                  values.data() + values.size(),
+                                  rank_its.begin(),
+                                  rank_its.end(),
+                                  comp)) {
+      throw std::runtime_error{"snapshot is no order statistics tree"};
+    }
+  }
+
+  /// @brief Returns @c true if the tree has no elements.
+  bool empty() const noexcept
+  {
+    return values.empty();
+  }
+
+  /// @brief Returns the number of elements.
+  size_type size() const noexcept
+  {
+    return values.size();
+  }
+
+  /// @brief Returns the positions of the ranks.
+  std::span<const size_type> ranks() const noexcept
+  {
+    return positions;
+  }
+
+  /// @brief Returns the element of the rank @p i.
+  const_reference at_rank(size_type i) const
+  {
+    return values[positions[i]];
+  }
+
+  /// @brief Returns the smallest element. The tree must not be empty.
+  const_reference min() const
+  {
+    return values.front();
+  }
+
+  /// @brief Returns the greatest element. The tree must not be empty.
+  const_reference max() const
+  {
+    const auto last_segment{positions.empty() ? 0 : positions.back()};
+    return *max_mm_heap(
+      values.data() + last_segment, values.data() + values.size(), comp);
+  }
+
+  /// @brief Returns all elements, the elements between two ranks are
+  /// consecutive (range-query).
+  std::span<const T> elements() const noexcept
+  {
+    return values;
+  }
+
+  /// @brief Copies the elements into an order_statistics_tree, e.g., to add
+  /// elements, without rebuilding it.
+  order_statistics_tree<T, Compare> to_tree() const
+  {
+    return order_statistics_tree<T, Compare>::adopt(
+      {values.begin(), values.end()},
+      {positions.begin(), positions.end()},
+      comp);
+  }
+
+private:
+  Compare                comp;
+  snapshot_file          file;
+  std::vector<size_type> positions;
+  std::span<const T>     values;
+};
+
+}
@@ -0,0 +1,293 @@
+/// @file
+/// Structure of arrays layout for min-max heaps and order statistics trees.
+///
+/// If the elements are large structs with a small key, every swap in the heap
+/// and tree algorithms moves the whole struct through the cache. Storing the
+/// keys and the payloads in two parallel sequences keeps the hot keys dense.
+/// The zip_iterator joins both sequences so that all algorithms of this
+/// library (and @c std::nth_element) operate on the pair of sequences like on a
+/// single one. Comparisons only look at the keys, see by_key.
+///
+/// Alternatively, the payload moves can be deferred: Zip the keys with a
+/// sequence of indices, build the heap or tree and apply the resulting
+/// permutation to the payloads once with apply_permutation().
+
+/// @cond
+module;
+/// @endcond
+
+// C++ Standard Library.
+#include <compare>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
+/// @cond
+export module order_statistics:soa;
+/// @endcond
+
+export namespace order_statistics {
+
+/// @brief A key and a payload held by value, the @c value_type of
+/// zip_iterator.
+template<typename Key, typename Payload>
+struct zip_value {
+  Key     key;
+  Payload payload;
+};
+
+/// @brief A key and a payload held by reference, the @c reference type of
+/// zip_iterator.
+///
+/// Assigning to a zip_reference assigns to the referenced elements, it never
+/// rebinds the references.
+template<typename Key, typename Payload>
+struct zip_reference {
+  Key&     key;
+  Payload& payload;
+
+  zip_reference(Key& k, Payload& p) noexcept : key{k}, payload{p}
+  {
+  }
+
+  zip_reference(const zip_reference&) = default;
+
+  operator zip_value<Key, Payload>() const&
+  {
+    return {key, payload};
+  }
+
+  operator zip_value<Key, Payload>() &&
+  {
+    return {std::move(key), std::move(payload)};
+  }
+
+  const zip_reference& operator=(const zip_reference& other) const
+  {
+    key     = other.key;
+    payload = other.payload;
+    return *this;
+  }
+
+  const zip_reference& operator=(zip_reference&& other) const
+  {
+    key     = std::move(other.key);
+    payload = std::move(other.payload);
+    return *this;
+  }
+
+  const zip_reference& operator=(const zip_value<Key, Payload>& value) const
+  {
+    key     = value.key;
+    payload = value.payload;
+    return *this;
+  }
+
+  const zip_reference& operator=(zip_value<Key, Payload>&& value) const
+  {
+    key     = std::move(value.key);
+    payload = std::move(value.payload);
+    return *this;
+  }
+
+  friend void swap(zip_reference lhs, zip_reference rhs)
+  {
+    using std::swap;
+    swap(lhs.key, rhs.key);
+    swap(lhs.payload, rhs.payload);
+  }
+};
+
+/// @brief Random access iterator over two parallel sequences of keys and
+/// payloads.
+/// @tparam KeyIt A @c RandomAccessIterator type of the keys.
+/// @tparam PayloadIt A @c RandomAccessIterator type of the payloads.
+template<typename KeyIt, typename PayloadIt>
+class zip_iterator {
+public:
+  using key_type     = typename std::iterator_traits<KeyIt>::value_type;
+  using payload_type = typename std::iterator_traits<PayloadIt>::value_type;
+
+  using iterator_category = std::random_access_iterator_tag;
+  using difference_type   = std::ptrdiff_t;
+  using value_type        = zip_value<key_type, payload_type>;
+  using reference         = zip_reference<key_type, payload_type>;
+  using pointer           = void;
+
+  zip_iterator() = default;
+
+  zip_iterator(KeyIt key_it, PayloadIt payload_it) :
+    key_it{key_it}, payload_it{payload_it}
+  {
+  }
+
+  /// @brief Returns the iterator into the keys.
+  KeyIt key_iterator() const
+  {
+    return key_it;
+  }
+
+  /// @brief Returns the iterator into the payloads.
+  PayloadIt payload_iterator() const
+  {
+    return payload_it;
+  }
+
+  reference operator*() const
+  {
+    return {*key_it, *payload_it};
+  }
+
+  reference operator[](difference_type n) const
+  {
+    return {key_it[n], payload_it[n]};
+  }
+
+  zip_iterator& operator++()
+  {
+    ++key_it;
+    ++payload_it;
+    return *this;
+  }
+
+  zip_iterator operator++(int)
+  {
+    auto tmp{*this};
+    ++*this;
+    return tmp;
+  }
+
+  zip_iterator& operator--()
+  {
+    --key_it;
+    --payload_it;
+    return *this;
+  }
+
+  zip_iterator operator--(int)
+  {
+    auto tmp{*this};
+    --*this;
+    return tmp;
+  }
+
+  zip_iterator& operator+=(difference_type n)
+  {
+    key_it += n;
+    payload_it += n;
+    return *this;
+  }
+
+  zip_iterator& operator-=(difference_type n)
+  {
+    key_it -= n;
+    payload_it -= n;
+    return *this;
+  }
+
+  friend zip_iterator operator+(zip_iterator it, difference_type n)
+  {
+    return it += n;
+  }
+
+  friend zip_iterator operator+(difference_type n, zip_iterator it)
+  {
+    return it += n;
+  }
+
+  friend zip_iterator operator-(zip_iterator it, difference_type n)
+  {
+    return it -= n;
+  }
+
+  friend difference_type operator-(const zip_iterator& lhs,
+                                   const zip_iterator& rhs)
+  {
+    return lhs.key_it - rhs.key_it;
+  }
+
+  friend bool operator==(const zip_iterator& lhs, const zip_iterator& rhs)
+  {
+    return lhs.key_it == rhs.key_it;
+  }
+
+  friend auto operator<=>(const zip_iterator& lhs, const zip_iterator& rhs)
+  {
+    return lhs.key_it <=> rhs.key_it;
+  }
+
+private:
+  KeyIt     key_it{};
+  PayloadIt payload_it{};
+};
+
+/// @brief Returns a zip_iterator over the keys at @p key_it and the payloads
+/// at @p payload_it.
+template<typename KeyIt, typename PayloadIt>
+zip_iterator<KeyIt, PayloadIt> make_zip_iterator(KeyIt     key_it,
+                                                 PayloadIt payload_it)
+{
+  return {key_it, payload_it};
+}
+
+/// @brief Adapts a binary functor on keys to the elements of a zip_iterator.
+///
+/// Both zip_value and zip_reference are accepted, so the adapted functor can
+/// be passed to the algorithms of this library as well as to
+/// @c std::nth_element.
+///
+/// @tparam Compare Type of a binary functor to compare two keys.
+template<typename Compare>
+struct by_key {
+  Compare comp{};
+
+  template<typename Lhs, typename Rhs>
+  bool operator()(const Lhs& lhs, const Rhs& rhs) const
+  {
+    return comp(lhs.key, rhs.key);
+  }
+};
+
+/// @brief Deduction guide to write @c by_key{comp}.
+template<typename Compare>
+by_key(Compare) -> by_key<Compare>;
+
+/// @brief Rearranges the payloads [@p first, @p last) such that the payload
+/// at position @c i is the one previously at position @p indices[i].
+///
+/// Use this after running an algorithm on keys zipped with the indices
+/// 0, ..., n - 1 to move every payload only once. Each cycle of the
+/// permutation is followed in place, the indices are restored to
+/// 0, ..., n - 1 on return.
+///
+/// @tparam RandomIt A @c RandomAccessIterator type of the payloads.
+/// @tparam IndexIt A @c RandomAccessIterator type of the indices.
+/// @param [in,out] first Iterator to the first payload.
+/// @param [in,out] last Iterator past the last payload.
+/// @param [in,out] indices Iterator to the first index of the permutation.
+template<typename RandomIt, typename IndexIt>
+void apply_permutation(RandomIt first, RandomIt last, IndexIt indices)
+{
+  using index_type = typename std::iterator_traits<IndexIt>::value_type;
+
+  const auto size{std::distance(first, last)};
+  for (std::ptrdiff_t i{0}; i < size; ++i) {
+    if (static_cast<std::ptrdiff_t>(indices[i]) == i) {
+      continue;
+    }
+    auto tmp{std::move(first[i])};
+    auto j{i};
+    for (;;) {
+      const auto k{static_cast<std::ptrdiff_t>(indices[j])};
+      indices[j] = static_cast<index_type>(j);
+      if (k == i) {
+        first[j] = std::move(tmp);
+        break;
+      }
+      first[j] = std::move(first[k]);
+      j        = k;
+    }
+  }
+}
+
+}
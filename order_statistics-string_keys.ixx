@@ -0,0 +1,128 @@
+/// @file
+/// String keys with cached fixed-width prefixes.
+///
+/// Ordering @c std::string elements requires to follow the pointer to the
+/// character data and to call @c memcmp for every single comparison. The heap
+/// and tree algorithms compare a lot, so this quickly dominates the run time.
+/// A prefixed string stores the first eight characters of the string as a
+/// big-endian unsigned integer right next to the string object. Two prefixed
+/// strings are ordered by comparing the integers first and only fall back to
+/// the characters if the prefixes are equal.
+
+/// @cond
+module;
+/// @endcond
+
+// C++ Standard Library.
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+/// @cond
+export module order_statistics:string_keys;
+/// @endcond
+
+export namespace order_statistics {
+
+/// @brief Returns the first eight characters of @p s packed into an unsigned
+/// integer such that comparing two prefixes orders like comparing the strings.
+///
+/// The first character ends up in the most significant byte (big-endian).
+/// Strings shorter than eight characters are padded with zeros.
+///
+/// @param [in] s The string to compute the prefix for.
+/// @return The prefix of @p s.
+constexpr std::uint64_t string_prefix(std::string_view s) noexcept
+{
+  std::uint64_t prefix{0};
+  for (std::size_t i{0}; i < 8; ++i) {
+    prefix <<= 8;
+    if (i < s.size()) {
+      prefix |= static_cast<unsigned char>(s[i]);
+    }
+  }
+  return prefix;
+}
+
+/// @brief A string together with its cached prefix.
+///
+/// Use it as the element type of min-max heaps and order statistics trees
+/// instead of @c std::string. The prefix is computed once on construction.
+/// The string must not be modified afterwards, use assign() to replace it.
+struct prefixed_string {
+  /// The first eight characters of @c value, see string_prefix().
+  std::uint64_t prefix{0};
+  /// The full string.
+  std::string value;
+
+  prefixed_string() = default;
+
+  /// @brief Wraps @p s and computes its prefix.
+  explicit prefixed_string(std::string s) :
+    prefix{string_prefix(s)}, value{std::move(s)}
+  {
+  }
+
+  /// @brief Replaces the string by @p s and recomputes the prefix.
+  void assign(std::string s)
+  {
+    prefix = string_prefix(s);
+    value  = std::move(s);
+  }
+
+  /// @brief Returns a view of the full string.
+  std::string_view view() const noexcept
+  {
+    return value;
+  }
+
+  friend bool operator==(const prefixed_string& lhs,
+                         const prefixed_string& rhs) noexcept
+  {
+    return lhs.prefix == rhs.prefix && lhs.value == rhs.value;
+  }
+
+  /// @brief Orders by prefix first, by the full strings on a tie.
+  friend std::strong_ordering operator<=>(const prefixed_string& lhs,
+                                          const prefixed_string& rhs) noexcept
+  {
+    if (lhs.prefix != rhs.prefix) {
+      return lhs.prefix <=> rhs.prefix;
+    }
+    return lhs.view().compare(rhs.view()) <=> 0;
+  }
+
+  friend void swap(prefixed_string& lhs, prefixed_string& rhs) noexcept
+  {
+    using std::swap;
+    swap(lhs.prefix, rhs.prefix);
+    swap(lhs.value, rhs.value);
+  }
+};
+
+/// @brief Binary functor to order prefixed strings.
+///
+/// Equivalent to @c std::less<> on prefixed_string but usable wherever only
+/// the order is needed, e.g., in a max-min heap via prefix_greater.
+struct prefix_less {
+  bool operator()(const prefixed_string& lhs,
+                  const prefixed_string& rhs) const noexcept
+  {
+    return lhs.prefix < rhs.prefix
+           || (lhs.prefix == rhs.prefix && lhs.view() < rhs.view());
+  }
+};
+
+/// @brief Binary functor to order prefixed strings in descending order.
+struct prefix_greater {
+  bool operator()(const prefixed_string& lhs,
+                  const prefixed_string& rhs) const noexcept
+  {
+    return prefix_less{}(rhs, lhs);
+  }
+};
+
+}
@@ -0,0 +1,247 @@
+/// @file
+/// Iterators that keep track of the positions of the elements they move.
+///
+/// Removing an element from a min-max heap or an order statistics tree needs
+/// its position, but the heap and tree algorithms constantly move the elements.
+/// A tracking_iterator wraps an iterator into the elements and writes the new
+/// position of every element it assigns to an index, e.g., an array indexed by
+/// a handle that is stored inside the element. Thus the position of any
+/// element can be looked up in constant time.
+
+/// @cond
+module;
+/// @endcond
+
+// C++ Standard Library.
+#include <compare>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
+/// @cond
+export module order_statistics:tracking;
+/// @endcond
+
+export namespace order_statistics {
+
+/// @brief The @c reference type of tracking_iterator.
+///
+/// Assigning to a tracking_reference assigns to the referenced element and
+/// records the position of the element.
+template<typename T, typename PositionIt, typename Handle>
+struct tracking_reference {
+  T&             value;
+  std::ptrdiff_t position;
+  PositionIt     positions;
+  Handle         handle;
+
+  tracking_reference(const tracking_reference&) = default;
+
+  tracking_reference(T&             value,
+                     std::ptrdiff_t position,
+                     PositionIt     positions,
+                     Handle         handle) :
+    value{value}, position{position}, positions{positions}, handle{handle}
+  {
+  }
+
+  operator const T&() const noexcept
+  {
+    return value;
+  }
+
+  const tracking_reference& operator=(const tracking_reference& other) const
+  {
+    return *this = static_cast<const T&>(other.value);
+  }
+
+  const tracking_reference& operator=(tracking_reference&& other) const
+  {
+    return *this = std::move(other.value);
+  }
+
+  const tracking_reference& operator=(const T& other) const
+  {
+    value = other;
+    track();
+    return *this;
+  }
+
+  const tracking_reference& operator=(T&& other) const
+  {
+    value = std::move(other);
+    track();
+    return *this;
+  }
+
+  friend void swap(tracking_reference lhs, tracking_reference rhs)
+  {
+    using std::swap;
+    swap(lhs.value, rhs.value);
+    lhs.track();
+    rhs.track();
+  }
+
+private:
+  void track() const
+  {
+    positions[handle(value)] =
+      static_cast<std::iter_value_t<PositionIt>>(position);
+  }
+};
+
+/// @brief Random access iterator that records the position of every element
+/// assigned through it.
+///
+/// Dereferencing yields a tracking_reference. Comparison functors receive it
+/// where they would receive a <tt>const T&</tt>, it converts implicitly.
+///
+/// @tparam RandomIt A @c RandomAccessIterator type of the elements.
+/// @tparam PositionIt A @c RandomAccessIterator type of the positions, indexed
+/// by the handles of the elements.
+/// @tparam Handle Type of a unary functor that returns the handle of an
+/// element.
+template<typename RandomIt, typename PositionIt, typename Handle>
+class tracking_iterator {
+public:
+  using element_type = typename std::iterator_traits<RandomIt>::value_type;
+  using reference    = tracking_reference<element_type, PositionIt, Handle>;
+
+  using iterator_category = std::random_access_iterator_tag;
+  using difference_type   = std::ptrdiff_t;
+  using value_type        = element_type;
+  using pointer           = void;
+
+  tracking_iterator() = default;
+
+  /// @brief Creates an iterator to @p it. Positions are counted from @p first
+  /// and stored into @p positions at the handle of the element.
+  tracking_iterator(RandomIt   first,
+                    RandomIt   it,
+                    PositionIt positions,
+                    Handle     handle = {}) :
+    first{first}, it{it}, positions{positions}, handle{handle}
+  {
+  }
+
+  /// @brief Returns the wrapped iterator.
+  RandomIt base() const
+  {
+    return it;
+  }
+
+  reference operator*() const
+  {
+    return {*it, it - first, positions, handle};
+  }
+
+  reference operator[](difference_type n) const
+  {
+    return *(*this + n);
+  }
+
+  tracking_iterator& operator++()
+  {
+    ++it;
+    return *this;
+  }
+
+  tracking_iterator operator++(int)
+  {
+    auto tmp{*this};
+    ++it;
+    return tmp;
+  }
+
+  tracking_iterator& operator--()
+  {
+    --it;
+    return *this;
+  }
+
+  tracking_iterator operator--(int)
+  {
+    auto tmp{*this};
+    --it;
+    return tmp;
+  }
+
+  tracking_iterator& operator+=(difference_type n)
+  {
+    it += n;
+    return *this;
+  }
+
+  tracking_iterator& operator-=(difference_type n)
+  {
+    it -= n;
+    return *this;
+  }
+
+  friend tracking_iterator operator+(tracking_iterator lhs, difference_type n)
+  {
+    return lhs += n;
+  }
+
+  friend tracking_iterator operator+(difference_type n, tracking_iterator rhs)
+  {
+    return rhs += n;
+  }
+
+  friend tracking_iterator operator-(tracking_iterator lhs, difference_type n)
+  {
+    return lhs -= n;
+  }
+
+  friend difference_type operator-(const tracking_iterator& lhs,
+                                   const tracking_iterator& rhs)
+  {
+    return lhs.it - rhs.it;
+  }
+
+  friend bool operator==(const tracking_iterator& lhs,
+                         const tracking_iterator& rhs)
+  {
+    return lhs.it == rhs.it;
+  }
+
+  friend auto operator<=>(const tracking_iterator& lhs,
+                          const tracking_iterator& rhs)
+  {
+    return lhs.it <=> rhs.it;
+  }
+
+private:
+  RandomIt   first{};
+  RandomIt   it{};
+  PositionIt positions{};
+  Handle     handle{};
+};
+
+/// @brief Returns a tracking_iterator to @p it that counts the positions from
+/// @p first.
+template<typename RandomIt, typename PositionIt, typename Handle>
+tracking_iterator<RandomIt, PositionIt, Handle> make_tracking_iterator(
+  RandomIt   first,
+  RandomIt   it,
+  PositionIt positions,
+  Handle     handle)
+{
+  return {first, it, positions, handle};
+}
+
+/// @brief Records the positions of all elements of [@p first, @p last).
+template<typename RandomIt, typename PositionIt, typename Handle>
+void track_positions(RandomIt   first,
+                     RandomIt   last,
+                     PositionIt positions,
+                     Handle     handle)
+{
+  using position_type = std::iter_value_t<PositionIt>;
+
+  for (auto it{first}; it != last; ++it) {
+    positions[handle(*it)] = static_cast<position_type>(it - first);
+  }
+}
+
+}
@@ -0,0 +1,459 @@
+/// @file
+/// Operations to create and maintain order statistics trees in situ.
+///
+/// An order statistics tree over the sequence [@c first, @c last) with the
+/// ranks @c r_1 <= ... <= @c r_m consists of the segments [@c first, @c r_1),
+/// [@c r_1, @c r_2), ..., [@c r_m, @c last). Every segment is a min-max heap
+/// and no element of a segment is greater than an element of a later segment.
+/// Hence, the root of the segment starting at @c r_i is the element of rank
+/// @c r_i. Equal ranks leave empty segments between them.
+///
+/// The ranks are given as a sequence of iterators into [@c first, @c last).
+/// They keep their positions when elements are inserted or removed, i.e., the
+/// last segment grows or shrinks and the elements are moved across the segments
+/// to restore the order.
+
+/// @cond
+module;
+/// @endcond
+
+// C++ Standard Library.
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+/// @cond
+export module order_statistics:trees;
+
+import :minmax_heaps;
+/// @endcond
+
+namespace order_statistics {
+
+/// @brief Returns the iterator to the first element of the segment @p i of the
+/// order statistics tree starting at @p first.
+template<typename RandomIt, typename RankIt>
+RandomIt segment_begin(RandomIt first, RankIt ranks_first, std::ptrdiff_t i)
+{
+  return i == 0 ? first : *(ranks_first + (i - 1));
+}
+
+/// @brief Returns the iterator past the last element of the segment @p i of
+/// the order statistics tree ending at @p last.
+template<typename RandomIt, typename RankIt>
+RandomIt segment_end(RandomIt       last,
+                     RankIt         ranks_first,
+                     RankIt         ranks_last,
+                     std::ptrdiff_t i)
+{
+  return i == std::distance(ranks_first, ranks_last) ? last
+                                                     : *(ranks_first + i);
+}
+
+}
+
+export namespace order_statistics {
+
+/// @brief Turns the sequence [@c first, @c last) into an order statistics
+/// tree.
+/// @tparam RandomIt A @c RandomAccessIterator type whose values are the
+/// iterators to the ranks.
+/// @tparam Compare Type of a binary functor to compare two elements.
+/// @param first Iterator to the first element of the tree.
+/// @param last Iterator to the element past the last element of the tree.
+/// @param ranks_first Iterator to the first rank. The ranks must be sorted.
+/// @param ranks_last Iterator past the last rank.
+/// @param comp Functor to determine which of two elements is considered
+/// smaller.
+template<typename RandomIt, typename Compare>
+void make_order_statistics_tree(
+  typename std::iterator_traits<RandomIt>::value_type first,
+  typename std::iterator_traits<RandomIt>::value_type last,
+  RandomIt                                            ranks_first,
+  RandomIt                                            ranks_last,
+  Compare                                             comp)
+{
+  auto prev_nth{first};
+  for (auto rank{ranks_first}; rank != ranks_last; ++rank) {
+    std::nth_element(prev_nth, *rank, last, comp);
+    make_mm_heap(prev_nth, *rank, comp);
+    prev_nth = *rank;
+  }
+  make_mm_heap(prev_nth, last, comp);
+}
+
+/// @brief Turns the sequence [@c first, @c last) into an order statistics
+/// tree.
+/// @tparam RandomIt A @c RandomAccessIterator type whose values are the
+/// iterators to the ranks.
+/// @param first Iterator to the first element of the tree.
+/// @param last Iterator to the element past the last element of the tree.
+/// @param ranks_first Iterator to the first rank. The ranks must be sorted.
+/// @param ranks_last Iterator past the last rank.
+template<typename RandomIt>
+void make_order_statistics_tree(
+  typename std::iterator_traits<RandomIt>::value_type first,
+  typename std::iterator_traits<RandomIt>::value_type last,
+  RandomIt                                            ranks_first,
+  RandomIt                                            ranks_last)
+{
+  make_order_statistics_tree(first,
+                             last,
+                             ranks_first,
+                             ranks_last,
+                             std::less<>{});
+}
+
+/// @brief Returns @c true if [@c first, @c last) is an order statistics tree
+/// with the ranks [@p ranks_first, @p ranks_last).
+///
+/// Every segment must be a min-max heap and the greatest element of a segment
+/// must not be greater than the smallest element of the next one. The check
+/// takes linear time.
+///
+/// @tparam RandomIt A @c RandomAccessIterator type whose values are the
+/// iterators to the ranks.
+/// @tparam Compare Type of a binary functor to compare two elements.
+/// @param ranks_first Iterator to the first rank. The ranks must be sorted.
+/// @param comp Functor to determine which of two elements is considered
+/// smaller.
+template<typename RandomIt, typename Compare>
+bool is_order_statistics_tree(
+  typename std::iterator_traits<RandomIt>::value_type first,
+  typename std::iterator_traits<RandomIt>::value_type last,
+  RandomIt                                            ranks_first,
+  RandomIt                                            ranks_last,
+  Compare                                             comp)
+{
+  auto segment_first{first};
+  auto prev_max{last};
+  for (auto rank{ranks_first};; ++rank) {
+    const auto segment_last{rank == ranks_last ? last : *rank};
+    if (segment_first != segment_last) {
+      if (!is_mm_heap(segment_first, segment_last, comp)
+          || (prev_max != last && comp(*segment_first, *prev_max))) {
+        return false;
+      }
+      prev_max = max_mm_heap(segment_first, segment_last, comp);
+    }
+    if (rank == ranks_last) {
+      return true;
+    }
+    segment_first = segment_last;
+  }
+}
+
+/// @brief Returns @c true if [@c first, @c last) is an order statistics tree
+/// with the ranks [@p ranks_first, @p ranks_last).
+///
+/// Uses std::less to determine the order of elements.
+///
+/// @tparam RandomIt A @c RandomAccessIterator type whose values are the
+/// iterators to the ranks.
+template<typename RandomIt>
+bool is_order_statistics_tree(
+  typename std::iterator_traits<RandomIt>::value_type first,
+  typename std::iterator_traits<RandomIt>::value_type last,
+  RandomIt                                            ranks_first,
+  RandomIt                                            ranks_last)
+{
+  return is_order_statistics_tree(
+    first, last, ranks_first, ranks_last, std::less<>{});
+}
+
+/// @brief Inserts the element at (@c last - 1) into the order statistics tree
+/// [@c first, @c last - 1).
+///
+/// The element is added to the segment it belongs to and the greatest element
+/// of each later segment but the last moves on to the next segment. The worst
+/// case complexity is <tt>O(m log n)</tt> for @c m ranks.
+///
+/// @tparam RandomIt A @c RandomAccessIterator type whose values are the
+/// iterators to the ranks.
+/// @tparam Compare Type of a binary functor to compare two elements.
+/// @param first Iterator to the first element of the tree.
+/// @param last Iterator to the element past the last element of the tree.
+/// @param ranks_first Iterator to the first rank. All ranks must be less than
+/// (@c last - 1).
+/// @param ranks_last Iterator past the last rank.
+/// @param comp Functor to determine which of two elements is considered
+/// smaller.
+template<typename RandomIt, typename Compare>
+void push_order_statistics_tree(
+  typename std::iterator_traits<RandomIt>::value_type first,
+  typename std::iterator_traits<RandomIt>::value_type last,
+  RandomIt                                            ranks_first,
+  RandomIt                                            ranks_last,
+  Compare                                             comp)
+{
+  using std::swap;
+
+  if (first == last) {
+    return;
+  }
+
+  const auto value{last - 1};
+  const auto m{std::distance(ranks_first, ranks_last)};
+  const auto j{std::distance(
+    ranks_first,
+    std::upper_bound(ranks_first,
+                     ranks_last,
+                     value,
+                     [&comp](const auto& value_it, const auto& rank_it) {
+                       return comp(*value_it, *rank_it);
+                     }))};
+
+  for (auto i{j}; i < m; ++i) {
+    const auto seg_first{segment_begin(first, ranks_first, i)};
+    const auto seg_last{segment_end(last, ranks_first, ranks_last, i)};
+    if (seg_first == seg_last) {
+      continue;
+    }
+    const auto max_it{max_mm_heap(seg_first, seg_last, comp)};
+    if (comp(*value, *max_it)) {
+      erase_mm_heap(seg_first, max_it, seg_last, comp);
+      swap(*(seg_last - 1), *value);
+      push_mm_heap(seg_first, seg_last, comp);
+    }
+  }
+  push_mm_heap(segment_begin(first, ranks_first, m), last, comp);
+}
+
+/// @brief Inserts the element at (@c last - 1) into the order statistics tree
+/// [@c first, @c last - 1).
+/// @tparam RandomIt A @c RandomAccessIterator type whose values are the
+/// iterators to the ranks.
+/// @param first Iterator to the first element of the tree.
+/// @param last Iterator to the element past the last element of the tree.
+/// @param ranks_first Iterator to the first rank. All ranks must be less than
+/// (@c last - 1).
+/// @param ranks_last Iterator past the last rank.
+template<typename RandomIt>
+void push_order_statistics_tree(
+  typename std::iterator_traits<RandomIt>::value_type first,
+  typename std::iterator_traits<RandomIt>::value_type last,
+  RandomIt                                            ranks_first,
+  RandomIt                                            ranks_last)
+{
+  push_order_statistics_tree(first,
+                             last,
+                             ranks_first,
+                             ranks_last,
+                             std::less<>{});
+}
+
+/// @brief Swaps the element at @c it to (@c last - 1) and turns [@c first,
+/// @c last - 1) into an order statistics tree.
+///
+/// The element is removed from its segment and the smallest element of each
+/// later segment moves on to the previous segment. The worst case complexity
+/// is <tt>O(m log n)</tt> for @c m ranks.
+///
+/// @tparam RandomIt A @c RandomAccessIterator type whose values are the
+/// iterators to the ranks.
+/// @tparam Compare Type of a binary functor to compare two elements.
+/// @param first Iterator to the first element of the tree.
+/// @param it Iterator to the element to remove.
+/// @param last Iterator to the element past the last element of the tree.
+/// @param ranks_first Iterator to the first rank. All ranks must be less than
+/// (@c last - 1).
+/// @param ranks_last Iterator past the last rank.
+/// @param comp Functor to determine which of two elements is considered
+/// smaller.
+template<typename RandomIt, typename Compare>
+void erase_order_statistics_tree(
+  typename std::iterator_traits<RandomIt>::value_type first,
+  typename std::iterator_traits<RandomIt>::value_type it,
+  typename std::iterator_traits<RandomIt>::value_type last,
+  RandomIt                                            ranks_first,
+  RandomIt                                            ranks_last,
+  Compare                                             comp)
+{
+  using std::swap;
+
+  const auto m{std::distance(ranks_first, ranks_last)};
+  const auto j{std::distance(
+    ranks_first, std::upper_bound(ranks_first, ranks_last, it))};
+
+  auto prev_first{segment_begin(first, ranks_first, j)};
+  erase_mm_heap(prev_first,
+                it,
+                segment_end(last, ranks_first, ranks_last, j),
+                comp);
+  for (auto i{j + 1}; i <= m; ++i) {
+    // The removed element sits at the end of the previous non-empty segment,
+    // exchange it for the smallest element of segment i, which is its root.
+    const auto seg_first{segment_begin(first, ranks_first, i)};
+    const auto seg_last{segment_end(last, ranks_first, ranks_last, i)};
+    if (seg_first == seg_last) {
+      continue;
+    }
+    swap(*(seg_first - 1), *seg_first);
+    push_mm_heap(prev_first, seg_first, comp);
+    pop_mm_heap(seg_first, seg_last, comp);
+    prev_first = seg_first;
+  }
+}
+
+/// @brief Swaps the element at @c it to (@c last - 1) and turns [@c first,
+/// @c last - 1) into an order statistics tree.
+/// @tparam RandomIt A @c RandomAccessIterator type whose values are the
+/// iterators to the ranks.
+/// @param first Iterator to the first element of the tree.
+/// @param it Iterator to the element to remove.
+/// @param last Iterator to the element past the last element of the tree.
+/// @param ranks_first Iterator to the first rank. All ranks must be less than
+/// (@c last - 1).
+/// @param ranks_last Iterator past the last rank.
+template<typename RandomIt>
+void erase_order_statistics_tree(
+  typename std::iterator_traits<RandomIt>::value_type first,
+  typename std::iterator_traits<RandomIt>::value_type it,
+  typename std::iterator_traits<RandomIt>::value_type last,
+  RandomIt                                            ranks_first,
+  RandomIt                                            ranks_last)
+{
+  erase_order_statistics_tree(first,
+                              it,
+                              last,
+                              ranks_first,
+                              ranks_last,
+                              std::less<>{});
+}
+
+/// @brief Restores the order statistics tree [@c first, @c last) after the
+/// element at @c it has been changed.
+///
+/// If the new value still belongs to the segment of @c it, only the min-max
+/// heap of that segment is restored. Otherwise the element is removed and
+/// inserted again, see erase_order_statistics_tree() and
+/// push_order_statistics_tree().
+///
+/// @tparam RandomIt A @c RandomAccessIterator type whose values are the
+/// iterators to the ranks.
+/// @tparam Compare Type of a binary functor to compare two elements.
+/// @param first Iterator to the first element of the tree.
+/// @param it Iterator to the changed element.
+/// @param last Iterator to the element past the last element of the tree.
+/// @param ranks_first Iterator to the first rank. All ranks must be less than
+/// (@c last - 1).
+/// @param ranks_last Iterator past the last rank.
+/// @param comp Functor to determine which of two elements is considered
+/// smaller.
+template<typename RandomIt, typename Compare>
+void update_order_statistics_tree(
+  typename std::iterator_traits<RandomIt>::value_type first,
+  typename std::iterator_traits<RandomIt>::value_type it,
+  typename std::iterator_traits<RandomIt>::value_type last,
+  RandomIt                                            ranks_first,
+  RandomIt                                            ranks_last,
+  Compare                                             comp)
+{
+  const auto m{std::distance(ranks_first, ranks_last)};
+  const auto j{std::distance(
+    ranks_first, std::upper_bound(ranks_first, ranks_last, it))};
+  const auto seg_first{segment_begin(first, ranks_first, j)};
+  const auto seg_last{segment_end(last, ranks_first, ranks_last, j)};
+
+  // The previous non-empty segment, empty segments are skipped.
+  auto k{j};
+  while (k > 0 && segment_begin(first, ranks_first, k - 1) == seg_first) {
+    --k;
+  }
+  auto fits{true};
+  if (k > 0) {
+    const auto prev_first{segment_begin(first, ranks_first, k - 1)};
+    fits = !comp(*it, *max_mm_heap(prev_first, seg_first, comp));
+  }
+  // The element at seg_last is the root of the next non-empty segment.
+  if (fits && j < m) {
+    fits = !comp(*seg_last, *it);
+  }
+
+  if (fits) {
+    erase_mm_heap(seg_first, it, seg_last, comp);
+    push_mm_heap(seg_first, seg_last, comp);
+  }
+  else {
+    erase_order_statistics_tree(
+      first, it, last, ranks_first, ranks_last, comp);
+    push_order_statistics_tree(first, last, ranks_first, ranks_last, comp);
+  }
+}
+
+/// @brief Restores the order statistics tree [@c first, @c last) after the
+/// element at @c it has been changed.
+/// @tparam RandomIt A @c RandomAccessIterator type whose values are the
+/// iterators to the ranks.
+/// @param first Iterator to the first element of the tree.
+/// @param it Iterator to the changed element.
+/// @param last Iterator to the element past the last element of the tree.
+/// @param ranks_first Iterator to the first rank. All ranks must be less than
+/// (@c last - 1).
+/// @param ranks_last Iterator past the last rank.
+template<typename RandomIt>
+void update_order_statistics_tree(
+  typename std::iterator_traits<RandomIt>::value_type first,
+  typename std::iterator_traits<RandomIt>::value_type it,
+  typename std::iterator_traits<RandomIt>::value_type last,
+  RandomIt                                            ranks_first,
+  RandomIt                                            ranks_last)
+{
+  update_order_statistics_tree(first,
+                               it,
+                               last,
+                               ranks_first,
+                               ranks_last,
+                               std::less<>{});
+}
+
+/// @brief Swaps the smallest element to (@c last - 1) and turns [@c first,
+/// @c last - 1) into an order statistics tree.
+/// @tparam RandomIt A @c RandomAccessIterator type whose values are the
+/// iterators to the ranks.
+/// @tparam Compare Type of a binary functor to compare two elements.
+/// @param first Iterator to the first element of the tree.
+/// @param last Iterator to the element past the last element of the tree.
+/// @param ranks_first Iterator to the first rank. All ranks must be less than
+/// (@c last - 1).
+/// @param ranks_last Iterator past the last rank.
+/// @param comp Functor to determine which of two elements is considered
+/// smaller.
+template<typename RandomIt, typename Compare>
+void pop_order_statistics_tree(
+  typename std::iterator_traits<RandomIt>::value_type first,
+  typename std::iterator_traits<RandomIt>::value_type last,
+  RandomIt                                            ranks_first,
+  RandomIt                                            ranks_last,
+  Compare                                             comp)
+{
+  if (first != last) {
+    erase_order_statistics_tree(
+      first, first, last, ranks_first, ranks_last, comp);
+  }
+}
+
+/// @brief Swaps the smallest element to (@c last - 1) and turns [@c first,
+/// @c last - 1) into an order statistics tree.
+/// @tparam RandomIt A @c RandomAccessIterator type whose values are the
+/// iterators to the ranks.
+/// @param first Iterator to the first element of the tree.
+/// @param last Iterator to the element past the last element of the tree.
+/// @param ranks_first Iterator to the first rank. All ranks must be less than
+/// (@c last - 1).
+/// @param ranks_last Iterator past the last rank.
+template<typename RandomIt>
+void pop_order_statistics_tree(
+  typename std::iterator_traits<RandomIt>::value_type first,
+  typename std::iterator_traits<RandomIt>::value_type last,
+  RandomIt                                            ranks_first,
+  RandomIt                                            ranks_last)
+{
+  pop_order_statistics_tree(first,
+                            last,
+                            ranks_first,
+                            ranks_last,
+                            std::less<>{});
+}
+
+}
@@ -0,0 +1,542 @@
+/// @file
+/// A small work-stealing thread pool.
+///
+/// Every worker owns a deque of tasks. A worker pushes the tasks it spawns to
+/// the back of its own deque and takes its next task from the back as well,
+/// i.e., it works depth-first on the subproblems it has just created. An idle
+/// worker steals the oldest task from the front of another worker's deque,
+/// which is usually the largest subproblem left. The deques are guarded by a
+/// mutex each, the tasks are meant to be coarse.
+///
+/// On a machine with several NUMA nodes the workers are pinned to the CPUs of
+/// their node and steal from the workers of their own node first, such that
+/// the subproblems a node spawned stay on the node as long as it has work.
+/// A first_touch_array places the elements: Every worker writes its part of
+/// the array first, which puts the pages on its node, and the executor of the
+/// array spawns a task near an element on the worker that wrote it.
+
+/// @cond
+module;
+/// @endcond
+
+// C++ Standard Library.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/// @cond
+export module order_statistics:work_stealing;
+
+import :numa;
+/// @endcond
+
+export namespace order_statistics {
+
+/// @brief What the workers of a work_stealing_pool did during the last run().
+struct pool_statistics {
+  /// Number of tasks every worker executed.
+  std::vector<std::size_t> tasks;
+  /// Number of tasks every worker stole from other workers.
+  std::vector<std::size_t> steals;
+  /// Number of tasks every worker stole from workers of other NUMA nodes.
+  std::vector<std::size_t> remote_steals;
+  /// Time in seconds every worker spent executing tasks.
+  std::vector<double> busy_seconds;
+};
+
+/// @brief A pool of threads that execute tasks spawned by tasks.
+///
+/// run() executes a root task on the calling thread, which becomes worker 0,
+/// and returns when the root and all tasks spawned by it have finished. The
+/// pool models the executor expected by parallel_make_order_statistics_tree(),
+/// any type with the same run() and spawn() can be used instead, e.g., an
+/// adapter around another task scheduler.
+class work_stealing_pool {
+public:
+  /// @brief Starts @p threads - 1 worker threads, the thread calling run() is
+  /// worker 0. All workers belong to a single node and are not pinned.
+  /// @param threads Number of workers, 0 for one per hardware thread.
+  explicit work_stealing_pool(unsigned threads = 0)
+  {
+    if (threads == 0) {
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    start(std::vector<std::size_t>(threads, 0), {});
+  }
+
+  /// @brief Starts one worker per CPU of @p topology, ordered by node.
+  ///
+  /// The worker threads are pinned to the CPUs of their node. Worker 0 is the
+  /// thread calling run(), it counts as a worker of the first node but is not
+  /// pinned.
+  ///
+  /// @param topology The nodes, e.g., detect_numa_topology().
+  explicit work_stealing_pool(const numa_topology& topology)
+  {
+    std::vector<std::size_t> nodes;
+    for (std::size_t node{0}; node < topology.nodes.size(); ++node) {
+      nodes.insert(nodes.end(), topology.nodes[node].cpus.size(), node);
+    }
+    if (nodes.empty()) {
+      nodes.push_back(0);
+    }
+    start(nodes, topology);
+  }
+
+  work_stealing_pool(const work_stealing_pool&)            = delete;
+  work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+
+  /// @brief Stops the worker threads.
+  ~work_stealing_pool()
+  {
+    for (auto& worker : workers) {
+      worker.request_stop();
+    }
+    const std::scoped_lock lock{sleep_mutex};
+    wake.notify_all();
+  }
+
+  /// @brief Returns the number of workers.
+  std::size_t size() const noexcept
+  {
+    return queues.size();
+  }
+
+  /// @brief Returns the index of the node of @p worker into the nodes of the
+  /// topology, 0 without a topology.
+  std::size_t node_of(std::size_t worker) const
+  {
+    return queues[worker]->node;
+  }
+
+  /// @brief Executes @p root and all tasks it spawns, returns when they have
+  /// finished.
+  ///
+  /// Only one run() may be active at a time.
+  ///
+  /// @throws The first exception thrown by a task, the remaining tasks are
+  /// executed nevertheless.
+  template<typename F>
+  void run(F&& root)
+  {
+    execute([&] { spawn(std::forward<F>(root)); });
+  }
+
+  /// @brief Adds @p task to the deque of the calling worker, or to the deque
+  /// of worker 0 if not called by a worker of this pool.
+  template<typename F>
+  void spawn(F&& task)
+  {
+    push(current_pool == this ? current_index : 0, std::forward<F>(task));
+  }
+
+  /// @brief Adds @p task to the deque of @p worker, e.g., the worker whose
+  /// node holds the elements of the task.
+  ///
+  /// Like every task in a deque it may be stolen, by the workers of the same
+  /// node first.
+  template<typename F>
+  void spawn_on(std::size_t worker, F&& task)
+  {
+    push(worker, std::forward<F>(task));
+  }
+
+  /// @brief Calls @p f(i) on every worker @c i, returns when all calls have
+  /// finished.
+  ///
+  /// The calls are not stolen, e.g., to touch memory from the node of every
+  /// worker. Counts as a run(), see statistics().
+  template<typename F>
+  void for_each_worker(F f)
+  {
+    execute([&] {
+      for (std::size_t i{0}; i < queues.size(); ++i) {
+        pending.fetch_add(1, std::memory_order_relaxed);
+        {
+          auto&                  queue{*queues[i]};
+          const std::scoped_lock lock{queue.mutex};
+          queue.pinned.emplace_back([&f, i] { f(i); });
+        }
+        // Sequentially consistent, see work().
+        queues[i]->pinned_count.fetch_add(1);
+      }
+      const std::scoped_lock lock{sleep_mutex};
+      wake.notify_all();
+    });
+  }
+
+  /// @brief Returns what the workers did during the last run().
+  pool_statistics statistics() const
+  {
+    pool_statistics result;
+    for (const auto& queue : queues) {
+      result.tasks.push_back(queue->tasks_executed);
+      result.steals.push_back(queue->tasks_stolen);
+      result.remote_steals.push_back(queue->remote_steals);
+      result.busy_seconds.push_back(
+        std::chrono::duration<double>(queue->busy).count());
+    }
+    return result;
+  }
+
+private:
+  struct worker_queue {
+    std::mutex                        mutex;
+    std::deque<std::function<void()>> tasks;
+    /// Tasks that must not be stolen, see for_each_worker().
+    std::deque<std::function<void()>> pinned;
+    std::atomic<std::size_t>          pinned_count{0};
+    std::size_t                       node{0};
+    /// The other workers, those of the same node first.
+    std::vector<std::size_t> victims;
+    // Written by the owning worker only.
+    std::size_t                         tasks_executed{0};
+    std::size_t                         tasks_stolen{0};
+    std::size_t                         remote_steals{0};
+    std::chrono::steady_clock::duration busy{};
+  };
+
+  /// @brief Adds @p task to the back of the deque of @p index.
+  template<typename F>
+  void push(std::size_t index, F&& task)
+  {
+    pending.fetch_add(1, std::memory_order_relaxed);
+    // Counted before it is queued, such that queued never drops below the
+    // number of tasks in the deques. Sequentially consistent, see work().
+    queued.fetch_add(1);
+    {
+      auto&                  queue{*queues[index]};
+      const std::scoped_lock lock{queue.mutex};
+      queue.tasks.emplace_back(std::forward<F>(task));
+    }
+    if (sleeping.load() > 0) {
+      // A task in the deque of another worker wakes all sleepers, among
+      // them its owner, rather than any one of them.
+      const std::scoped_lock lock{sleep_mutex};
+      if (current_pool == this && current_index == index) {
+        wake.notify_one();
+      }
+      else {
+        wake.notify_all();
+      }
+    }
+  }
+
+  /// @brief Calls @p schedule on the calling thread as worker 0 and executes
+  /// tasks until all scheduled tasks and their tasks have finished.
+  template<typename F>
+  void execute(F schedule)
+  {
+    for (auto& queue : queues) {
+      queue->tasks_executed = 0;
+      queue->tasks_stolen   = 0;
+      queue->remote_steals  = 0;
+      queue->busy           = std::chrono::steady_clock::duration{};
+    }
+    failure = nullptr;
+
+    const auto previous_pool{current_pool};
+    const auto previous_index{current_index};
+    current_pool  = this;
+    current_index = 0;
+    schedule();
+    while (pending.load(std::memory_order_acquire) > 0) {
+      if (!execute_one(0)) {
+        std::this_thread::yield();
+      }
+    }
+    current_pool  = previous_pool;
+    current_index = previous_index;
+
+    if (failure) {
+      std::rethrow_exception(failure);
+    }
+  }
+
+  /// @brief Creates a worker per entry of @p nodes, the node of the worker,
+  /// and starts the threads of all but worker 0.
+  void start(const std::vector<std::size_t>& nodes,
+             const numa_topology&            topology)
+  {
+    for (const auto node : nodes) {
+      queues.push_back(std::make_unique<worker_queue>());
+      queues.back()->node = node;
+    }
+    for (std::size_t i{0}; i < nodes.size(); ++i) {
+      for (const auto same_node : {true, false}) {
+        for (std::size_t j{1}; j < nodes.size(); ++j) {
+          const auto victim{(i + j) % nodes.size()};
+          if ((nodes[victim] == nodes[i]) == same_node) {
+            queues[i]->victims.push_back(victim);
+          }
+        }
+      }
+    }
+    for (std::size_t i{1}; i < nodes.size(); ++i) {
+      auto cpus{topology.nodes.empty() ? std::vector<unsigned>{}
+                                       : topology.nodes[nodes[i]].cpus};
+      workers.emplace_back([this, i, cpus](std::stop_token stop) {
+        if (!cpus.empty()) {
+          pin_current_thread(cpus);
+        }
+        work(i, stop);
+      });
+    }
+  }
+
+  /// @brief Takes a pinned task or a task from the back of the own deque or
+  /// steals one from the front of another deque and executes it.
+  /// @return @c false if there was no task.
+  bool execute_one(std::size_t index)
+  {
+    auto&                 own{*queues[index]};
+    std::function<void()> task;
+    const worker_queue*   victim_queue{nullptr};
+    {
+      const std::scoped_lock lock{own.mutex};
+      if (!own.pinned.empty()) {
+        task = std::move(own.pinned.front());
+        own.pinned.pop_front();
+        own.pinned_count.fetch_sub(1);
+      }
+      else if (!own.tasks.empty()) {
+        task = std::move(own.tasks.back());
+        own.tasks.pop_back();
+        queued.fetch_sub(1, std::memory_order_relaxed);
+      }
+    }
+    for (std::size_t i{0}; !task && i < own.victims.size(); ++i) {
+      auto&                  victim{*queues[own.victims[i]]};
+      const std::scoped_lock lock{victim.mutex};
+      if (!victim.tasks.empty()) {
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        victim_queue = &victim;
+      }
+    }
+    if (!task) {
+      return false;
+    }
+
+    const auto start{std::chrono::steady_clock::now()};
+    try {
+      task();
+    }
+    catch (...) {
+      const std::scoped_lock lock{failure_mutex};
+      if (!failure) {
+        failure = std::current_exception();
+      }
+    }
+    own.busy += std::chrono::steady_clock::now() - start;
+    ++own.tasks_executed;
+    if (victim_queue) {
+      ++own.tasks_stolen;
+      own.remote_steals += victim_queue->node != own.node ? 1 : 0;
+    }
+    pending.fetch_sub(1, std::memory_order_acq_rel);
+    return true;
+  }
+
+  /// @brief Executes tasks until @p stop is requested, sleeps while there
+  /// are none.
+  void work(std::size_t index, std::stop_token stop)
+  {
+    current_pool  = this;
+    current_index = index;
+    while (!stop.stop_requested()) {
+      if (execute_one(index)) {
+        continue;
+      }
+      // Either spawn() sees this worker sleeping and wakes it or this worker
+      // sees the spawned task.
+      std::unique_lock lock{sleep_mutex};
+      sleeping.fetch_add(1);
+      wake.wait(lock, [&] {
+        return stop.stop_requested() || queued.load() > 0
+               || queues[index]->pinned_count.load() > 0;
+      });
+      sleeping.fetch_sub(1);
+    }
+  }
+
+  inline static thread_local const work_stealing_pool* current_pool{nullptr};
+  inline static thread_local std::size_t               current_index{0};
+
+  std::vector<std::unique_ptr<worker_queue>> queues;
+  /// Number of tasks spawned but not finished.
+  std::atomic<std::size_t> pending{0};
+  /// Number of tasks in the deques or about to be added.
+  std::atomic<std::size_t> queued{0};
+  std::atomic<std::size_t> sleeping{0};
+  std::mutex               sleep_mutex;
+  std::condition_variable  wake;
+  std::mutex               failure_mutex;
+  std::exception_ptr       failure;
+  std::vector<std::jthread> workers;
+};
+
+/// @brief A copy of a sequence whose parts were written first by the workers
+/// of a work_stealing_pool.
+///
+/// Linux, like most systems, places a page on the NUMA node of the thread
+/// that writes to it first. The elements are split into one contiguous part
+/// per worker, every worker copies its own part, i.e., the parts of the
+/// workers of a node lie on that node, apart from the pages at the borders.
+///
+/// executor() spawns a task near an element on the worker that copied it,
+/// e.g., every block of parallel_partition() on the node that holds it.
+///
+/// @code
+/// work_stealing_pool       pool{detect_numa_topology()};
+/// first_touch_array<float> values{pool, samples};
+/// auto                     executor{values.executor()};
+/// parallel_make_order_statistics_tree(
+///   values.begin(), values.end(), ranks.begin(), ranks.end(), executor);
+/// @endcode
+///
+/// @tparam T Type of the elements, must be trivially copyable and trivially
+/// default constructible, such that the allocation writes no element.
+template<typename T>
+class first_touch_array {
+  static_assert(std::is_trivially_copyable_v<T>
+                && std::is_trivially_default_constructible_v<T>);
+
+public:
+  /// @brief Runs the tasks of a work_stealing_pool, those spawned near an
+  /// element of the array on the worker that copied the element.
+  class placed_executor {
+  public:
+    /// @brief Returns the number of workers of the pool.
+    std::size_t size() const noexcept
+    {
+      return pool->size();
+    }
+
+    /// @brief See work_stealing_pool::run().
+    template<typename F>
+    void run(F&& root)
+    {
+      pool->run(std::forward<F>(root));
+    }
+
+    /// @brief See work_stealing_pool::spawn().
+    template<typename F>
+    void spawn(F&& task)
+    {
+      pool->spawn(std::forward<F>(task));
+    }
+
+    /// @brief Spawns @p task on the worker that copied the element at
+    /// @p address, or like spawn() if it is no element of the array.
+    template<typename F>
+    void spawn_near(const void* address, F&& task)
+    {
+      const auto element{static_cast<const std::byte*>(address)};
+      const auto first{reinterpret_cast<const std::byte*>(data)};
+      const auto last{first + count * sizeof(T)};
+      // Only std::less orders pointers into different objects.
+      if (std::less<>{}(element, first) || !std::less<>{}(element, last)) {
+        spawn(std::forward<F>(task));
+        return;
+      }
+      const auto index{static_cast<std::size_t>(element - first) / sizeof(T)};
+      pool->spawn_on(worker_of(index, pool->size(), count),
+                     std::forward<F>(task));
+    }
+
+  private:
+    friend first_touch_array;
+
+    placed_executor(work_stealing_pool& pool,
+                    const T*            data,
+                    std::size_t         count) noexcept :
+      pool{&pool}, data{data}, count{count}
+    {
+    }
+
+    work_stealing_pool* pool;
+    const T*            data;
+    std::size_t         count;
+  };
+
+  /// @brief Copies @p source, every worker of @p pool its own part.
+  /// @param pool The workers, which must outlive the executors of the array.
+  /// @param source The elements.
+  first_touch_array(work_stealing_pool& pool, std::span<const T> source) :
+    pool{&pool},
+    count{source.size()},
+    elements{std::make_unique_for_overwrite<T[]>(source.size())}
+  {
+    const auto workers{pool.size()};
+    pool.for_each_worker([&](std::size_t worker) {
+      std::copy(source.begin() + part_first(worker, workers, count),
+                source.begin() + part_first(worker + 1, workers, count),
+                elements.get() + part_first(worker, workers, count));
+    });
+  }
+
+  T* begin() const noexcept
+  {
+    return elements.get();
+  }
+
+  T* end() const noexcept
+  {
+    return elements.get() + count;
+  }
+
+  std::size_t size() const noexcept
+  {
+    return count;
+  }
+
+  /// @brief Returns the worker that copied the element @p i.
+  std::size_t worker_of(std::size_t i) const noexcept
+  {
+    return worker_of(i, pool->size(), count);
+  }
+
+  /// @brief Returns an executor that spawns tasks near the elements, see
+  /// placed_executor::spawn_near().
+  placed_executor executor() const noexcept
+  {
+    return {*pool, elements.get(), count};
+  }
+
+private:
+  /// @brief Returns the first element of the part of @p worker.
+  static std::size_t part_first(std::size_t worker,
+                                std::size_t workers,
+                                std::size_t count) noexcept
+  {
+    return count * worker / workers;
+  }
+
+  /// @brief Returns the worker whose part holds the element @p i, i.e., the
+  /// greatest worker whose part starts at or before it.
+  static std::size_t
+  worker_of(std::size_t i, std::size_t workers, std::size_t count) noexcept
+  {
+    return ((i + 1) * workers - 1) / count;
+  }
+
+  work_stealing_pool*  pool;
+  std::size_t          count;
+  std::unique_ptr<T[]> elements;
+};
+
+}
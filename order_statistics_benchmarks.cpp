@@ -0,0 +1,1848 @@
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <queue>
+#include <random>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "command_line.hpp"
+
+import order_statistics;
+import order_statistics_datasets;
+
+using namespace order_statistics;
+
+namespace {
+
+/// @brief Returns the wall time in seconds @p f takes.
+template<typename F>
+double seconds(F&& f)
+{
+  const auto start{std::chrono::steady_clock::now()};
+  f();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+    .count();
+}
+
+/// @brief Names of the events counted by perf_counters.
+constexpr std::array<const char*, 7> counter_names{
+  "cycles", "instr", "L1d miss", "LLC miss", "dTLB miss", "br miss", "faults"};
+
+#if defined(__linux__)
+constexpr std::uint64_t cache_read_misses(std::uint64_t cache)
+{
+  return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+         | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+/// @brief Types and configurations of the counter_names.
+constexpr std::array<std::pair<std::uint32_t, std::uint64_t>, 7>
+  counter_events{{
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, cache_read_misses(PERF_COUNT_HW_CACHE_L1D)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HW_CACHE, cache_read_misses(PERF_COUNT_HW_CACHE_DTLB)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+  }};
+#endif
+
+/// @brief Counts of the events, none for an event that cannot be counted,
+/// e.g., in a virtual machine or without permission.
+using counter_values = std::array<std::optional<double>, counter_names.size()>;
+
+/// @brief Counts the events of the calling thread and of the threads
+/// it starts with the perf_event interface of Linux.
+///
+/// Every event has its own counter, so an event the CPU does not support
+/// only leaves its own count empty. The counts are scaled by the time the
+/// kernel multiplexed a counter onto the CPU.
+class perf_counters {
+public:
+  perf_counters()
+  {
+    descriptors.fill(-1);
+#if defined(__linux__)
+    for (std::size_t i{0}; i < counter_events.size(); ++i) {
+      perf_event_attr attributes;
+      std::memset(&attributes, 0, sizeof(attributes));
+      attributes.type           = counter_events[i].first;
+      attributes.size           = sizeof(attributes);
+      attributes.config         = counter_events[i].second;
+      attributes.disabled       = 1;
+      attributes.inherit        = 1;
+      attributes.exclude_kernel = 1;
+      attributes.exclude_hv     = 1;
+      attributes.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED
+                               | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      descriptors[i] = static_cast<int>(
+        ::syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+    }
+#endif
+  }
+
+  perf_counters(const perf_counters&)            = delete;
+  perf_counters& operator=(const perf_counters&) = delete;
+
+  ~perf_counters()
+  {
+#if defined(__linux__)
+    for (const auto descriptor : descriptors) {
+      if (descriptor >= 0) {
+        ::close(descriptor);
+      }
+    }
+#endif
+  }
+
+  /// @brief Resets and starts the counters.
+  void start()
+  {
+#if defined(__linux__)
+    for (const auto descriptor : descriptors) {
+      if (descriptor >= 0) {
+        ::ioctl(descriptor, PERF_EVENT_IOC_RESET, 0);
+        ::ioctl(descriptor, PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+#endif
+  }
+
+  /// @brief Stops the counters and returns their counts since start().
+  counter_values stop()
+  {
+    counter_values values;
+#if defined(__linux__)
+    for (const auto descriptor : descriptors) {
+      if (descriptor >= 0) {
+        ::ioctl(descriptor, PERF_EVENT_IOC_DISABLE, 0);
+      }
+    }
+    for (std::size_t i{0}; i < counter_names.size(); ++i) {
+      // The count, the time enabled and the time running.
+      std::uint64_t count[3]{};
+      if (descriptors[i] >= 0
+          && ::read(descriptors[i], count, sizeof(count)) == sizeof(count)
+          && count[2] > 0) {
+        values[i] = static_cast<double>(count[0])
+                    * static_cast<double>(count[1])
+                    / static_cast<double>(count[2]);
+      }
+    }
+#endif
+    return values;
+  }
+
+private:
+  std::array<int, counter_names.size()> descriptors;
+};
+
+/// @brief Prints the header of the columns printed by print_counters().
+void print_counter_names()
+{
+  for (const auto name : counter_names) {
+    std::cout << std::setw(10) << name;
+  }
+}
+
+/// @brief Prints @p values divided by @p operations, "n/a" for the events
+/// that were not counted.
+void print_counters(const counter_values& values, double operations)
+{
+  for (const auto& value : values) {
+    if (value) {
+      std::cout << std::setw(10) << std::defaultfloat << std::setprecision(3)
+                << *value / operations;
+    }
+    else {
+      std::cout << std::setw(10) << "n/a";
+    }
+  }
+}
+
+/// @brief Counts the runs and their lengths instead of storing them.
+struct run_length_sink {
+  std::vector<std::size_t> lengths;
+  std::size_t              current{0};
+
+  template<typename T>
+  void push_low(const T&)
+  {
+    ++current;
+  }
+
+  template<typename T>
+  void push_high(const T&)
+  {
+    ++current;
+  }
+
+  void finish_run()
+  {
+    lengths.push_back(current);
+    current = 0;
+  }
+};
+
+/// @brief Classic replacement selection with a std::priority_queue, every
+/// element is tagged with the number of its run.
+template<typename T>
+std::vector<std::size_t> priority_queue_run_lengths(const std::vector<T>& input,
+                                                    std::size_t capacity)
+{
+  using tagged = std::pair<std::size_t, T>;
+  std::priority_queue<tagged, std::vector<tagged>, std::greater<>> heap;
+  std::vector<std::size_t>                                         lengths;
+
+  auto       it{input.begin()};
+  const auto last{input.end()};
+  for (; it != last && heap.size() < capacity; ++it) {
+    heap.emplace(0, *it);
+  }
+
+  std::size_t run{0};
+  std::size_t length{0};
+  while (!heap.empty()) {
+    const auto [r, value]{heap.top()};
+    heap.pop();
+    if (r != run) {
+      lengths.push_back(length);
+      run    = r;
+      length = 0;
+    }
+    ++length;
+    if (it != last) {
+      heap.emplace(*it < value ? run + 1 : run, *it);
+      ++it;
+    }
+  }
+  if (length > 0) {
+    lengths.push_back(length);
+  }
+  return lengths;
+}
+
+template<typename T>
+std::vector<std::size_t> minmax_heap_run_lengths(const std::vector<T>& input,
+                                                 std::size_t capacity)
+{
+  run_length_sink          sink;
+  replacement_selection<T> selection{capacity};
+  for (const auto& e : input) {
+    selection.push(e, sink);
+  }
+  selection.flush(sink);
+  return sink.lengths;
+}
+
+double average(const std::vector<std::size_t>& lengths)
+{
+  std::size_t sum{0};
+  for (const auto l : lengths) {
+    sum += l;
+  }
+  return lengths.empty() ? 0.0
+                         : static_cast<double>(sum)
+                             / static_cast<double>(lengths.size());
+}
+
+void benchmark_replacement_selection()
+{
+  constexpr std::size_t size{1 << 20};
+  constexpr std::size_t capacity{1 << 12};
+
+  std::mt19937                                      rng{42};
+  std::uniform_int_distribution<std::int32_t>       uniform;
+  std::uniform_int_distribution<std::int32_t>       noise{-4096, 4096};
+  std::vector<std::pair<std::string, std::vector<std::int32_t>>> inputs;
+
+  std::vector<std::int32_t> v(size);
+  for (auto& e : v) {
+    e = uniform(rng);
+  }
+  inputs.emplace_back("uniform", v);
+  for (std::size_t i{0}; i < size; ++i) {
+    v[i] = static_cast<std::int32_t>(i * 16) + noise(rng);
+  }
+  inputs.emplace_back("ascending with noise", v);
+  for (std::size_t i{0}; i < size; ++i) {
+    v[i] = -static_cast<std::int32_t>(i * 16) + noise(rng);
+  }
+  inputs.emplace_back("descending with noise", v);
+  for (std::size_t i{0}; i < size; ++i) {
+    const auto t{static_cast<std::int32_t>(i % (size / 8) * 16)};
+    v[i] = (i / (size / 8) % 2 ? -t : t) + noise(rng);
+  }
+  inputs.emplace_back("alternating trends", v);
+
+  std::cout << "Replacement selection, " << size << " elements, memory for "
+            << capacity << " elements, average run length / memory\n";
+  std::cout << std::left << std::setw(24) << "input" << std::right
+            << std::setw(16) << "priority_queue" << std::setw(16)
+            << "min-max heap" << '\n';
+  for (const auto& [name, input] : inputs) {
+    const auto pq{priority_queue_run_lengths(input, capacity)};
+    const auto mm{minmax_heap_run_lengths(input, capacity)};
+    std::cout << std::left << std::setw(24) << name << std::right
+              << std::fixed << std::setprecision(2) << std::setw(16)
+              << average(pq) / static_cast<double>(capacity) << std::setw(16)
+              << average(mm) / static_cast<double>(capacity) << '\n';
+  }
+}
+
+/// @brief Median filter that selects the median of every window with
+/// std::nth_element.
+template<typename Pixel>
+void nth_element_median_filter(const std::vector<Pixel>& input,
+                               std::vector<Pixel>&       output,
+                               std::size_t               width,
+                               std::size_t               radius)
+{
+  const auto         height{static_cast<std::ptrdiff_t>(input.size() / width)};
+  const auto         w{static_cast<std::ptrdiff_t>(width)};
+  const auto         r{static_cast<std::ptrdiff_t>(radius)};
+  std::vector<Pixel> window;
+  for (std::ptrdiff_t y{0}; y < height; ++y) {
+    for (std::ptrdiff_t x{0}; x < w; ++x) {
+      window.clear();
+      for (auto j{y - r}; j <= y + r; ++j) {
+        for (auto i{x - r}; i <= x + r; ++i) {
+          window.push_back(input[static_cast<std::size_t>(
+            std::clamp<std::ptrdiff_t>(j, 0, height - 1) * w
+            + std::clamp<std::ptrdiff_t>(i, 0, w - 1))]);
+        }
+      }
+      const auto median{window.begin() + window.size() / 2};
+      std::nth_element(window.begin(), median, window.end());
+      output[static_cast<std::size_t>(y * w + x)] = *median;
+    }
+  }
+}
+
+template<typename Pixel>
+void benchmark_median_filter(const char* name)
+{
+  constexpr std::size_t width{512};
+  constexpr std::size_t height{512};
+
+  std::mt19937                       rng{42};
+  std::uniform_int_distribution<int> uniform{0, 255};
+  std::vector<Pixel>                 input(width * height);
+  for (auto& p : input) {
+    p = static_cast<Pixel>(uniform(rng));
+  }
+  std::vector<Pixel> expected(input.size());
+  std::vector<Pixel> output(input.size());
+
+  for (const std::size_t radius : {1, 3, 7, 15}) {
+    const auto t0{seconds([&] {
+      nth_element_median_filter(input, expected, width, radius);
+    })};
+    const auto t1{seconds([&] {
+      median_filter<Pixel>(input, output, width, radius, 1);
+    })};
+    const auto ok{output == expected};
+    const auto tn{seconds([&] {
+      median_filter<Pixel>(input, output, width, radius);
+    })};
+    std::cout << std::left << std::setw(10) << name << std::right
+              << std::setw(4) << 2 * radius + 1 << std::fixed
+              << std::setprecision(3) << std::setw(14) << t0 << std::setw(14)
+              << t1 << std::setw(14) << tn << std::setw(8)
+              << (ok && output == expected ? "ok" : "FAILED") << '\n';
+  }
+}
+
+void benchmark_median_filters()
+{
+  std::cout << "\nMedian filter, 512 x 512 pixels, seconds\n";
+  std::cout << std::left << std::setw(10) << "pixel" << std::right
+            << std::setw(4) << "w" << std::setw(14) << "nth_element"
+            << std::setw(14) << "tree" << std::setw(14) << "tree (MT)"
+            << '\n';
+  benchmark_median_filter<std::uint8_t>("uint8");
+  benchmark_median_filter<std::uint16_t>("uint16");
+  benchmark_median_filter<float>("float");
+}
+
+void benchmark_rolling_quantiles()
+{
+  constexpr std::size_t       streams{20000};
+  constexpr std::size_t       window{1000};
+  constexpr std::size_t       updates{1 << 22};
+  const std::array<double, 2> percentiles{0.5, 0.95};
+
+  std::mt19937                                rng{42};
+  std::uniform_int_distribution<std::uint32_t> stream{0, streams - 1};
+  std::normal_distribution<float>              sample{100.0f, 15.0f};
+
+  // Fill all windows first, updates only replace samples afterwards.
+  std::vector<std::uint32_t> warm_up(streams * window);
+  std::vector<float>         warm_up_values(warm_up.size());
+  for (std::size_t i{0}; i < warm_up.size(); ++i) {
+    warm_up[i]        = static_cast<std::uint32_t>(i % streams);
+    warm_up_values[i] = sample(rng);
+  }
+  std::vector<std::uint32_t> ids(updates);
+  std::vector<float>         values(updates);
+  for (std::size_t i{0}; i < updates; ++i) {
+    ids[i]    = stream(rng);
+    values[i] = sample(rng);
+  }
+
+  std::vector<rolling_quantiles<float>> separate;
+  separate.reserve(streams);
+  for (std::size_t s{0}; s < streams; ++s) {
+    separate.emplace_back(1, window, percentiles);
+  }
+  for (std::size_t i{0}; i < warm_up.size(); ++i) {
+    separate[warm_up[i]].push(0, warm_up_values[i]);
+  }
+  const auto t0{seconds([&] {
+    for (std::size_t i{0}; i < updates; ++i) {
+      separate[ids[i]].push(0, values[i]);
+    }
+  })};
+
+  rolling_quantiles<float> single{streams, window, percentiles};
+  single.push(warm_up, warm_up_values);
+  const auto t1{seconds([&] {
+    for (std::size_t i{0}; i < updates; ++i) {
+      single.push(ids[i], values[i]);
+    }
+  })};
+
+  rolling_quantiles<float> batched{streams, window, percentiles};
+  batched.push(warm_up, warm_up_values);
+  const auto t2{seconds([&] {
+    batched.push(ids, values);
+  })};
+
+  auto ok{true};
+  for (std::size_t s{0}; s < streams; ++s) {
+    for (std::size_t i{0}; i < percentiles.size(); ++i) {
+      ok = ok && single.quantile(s, i) == separate[s].quantile(0, i)
+           && batched.quantile(s, i) == single.quantile(s, i);
+    }
+  }
+
+  std::cout << "\nRolling p50 / p95, " << streams << " streams, window of "
+            << window << ", " << updates << " updates, million updates / s\n";
+  std::cout << std::left << std::setw(24) << "separate windows"
+            << std::right << std::fixed << std::setprecision(2)
+            << std::setw(10) << updates / t0 / 1e6 << '\n';
+  std::cout << std::left << std::setw(24) << "arena" << std::right
+            << std::setw(10) << updates / t1 / 1e6 << '\n';
+  std::cout << std::left << std::setw(24) << "arena, batched" << std::right
+            << std::setw(10) << updates / t2 / 1e6 << std::setw(8)
+            << (ok ? "ok" : "FAILED") << '\n';
+}
+
+void benchmark_running_median()
+{
+  constexpr std::size_t       size{1 << 20};
+  const std::array<double, 1> median{0.5};
+
+  std::mt19937                    rng{42};
+  std::normal_distribution<float> noise{0.0f, 1.0f};
+  std::vector<float>              signal(size);
+  for (std::size_t i{0}; i < size; ++i) {
+    signal[i] = static_cast<float>(i % 1000) / 100.0f + noise(rng);
+  }
+
+  std::cout << "\nSliding median, " << size
+            << " samples, million samples / s\n";
+  std::cout << std::left << std::setw(10) << "window" << std::right
+            << std::setw(16) << "running_median" << std::setw(16)
+            << "tree" << '\n';
+  for (const std::size_t window : {15, 127, 1023}) {
+    std::vector<float> m0(size);
+    std::vector<float> m1(size);
+
+    const auto t0{seconds([&] {
+      running_median<float> m;
+      for (std::size_t i{0}; i < size; ++i) {
+        if (i < window) {
+          m.insert(signal[i]);
+        }
+        else {
+          m.slide(signal[i - window], signal[i]);
+        }
+        m0[i] = m.median();
+      }
+    })};
+    const auto t1{seconds([&] {
+      rolling_quantiles<float> q{1, window, median};
+      for (std::size_t i{0}; i < size; ++i) {
+        q.push(0, signal[i]);
+        m1[i] = q.quantile(0, 0);
+      }
+    })};
+
+    std::cout << std::left << std::setw(10) << window << std::right
+              << std::fixed << std::setprecision(2) << std::setw(16)
+              << size / t0 / 1e6 << std::setw(16) << size / t1 / 1e6
+              << std::setw(8)
+              << (std::equal(m0.begin() + window, m0.end(), m1.begin() + window)
+                    ? "ok"
+                    : "FAILED")
+              << '\n';
+  }
+}
+
+void benchmark_heap_batches()
+{
+  using iterator = std::vector<std::uint64_t>::iterator;
+
+  constexpr std::size_t heaps{1 << 14};
+  constexpr std::size_t capacity{512};
+  constexpr std::size_t rounds{64};
+
+  std::mt19937                                 rng{42};
+  std::uniform_int_distribution<std::uint64_t> uniform;
+  std::vector<std::uint64_t>                   single(heaps * capacity);
+  std::vector<std::size_t>                     sizes(heaps, capacity / 2);
+  for (std::size_t h{0}; h < heaps; ++h) {
+    const auto first{single.begin()
+                     + static_cast<std::ptrdiff_t>(h * capacity)};
+    std::generate(first, first + capacity / 2, [&] {
+      return uniform(rng);
+    });
+    make_mm_heap(first, first + capacity / 2);
+  }
+  std::vector<std::uint64_t> batched;
+
+  // Every round touches all heaps in random order, e.g., one heap per
+  // connection. A heap grows or shrinks by one element.
+  std::vector<std::uint32_t> order(heaps);
+  std::iota(order.begin(), order.end(), 0);
+  std::vector<std::vector<std::pair<std::uint32_t, heap_operation>>> plan(
+    rounds);
+  std::vector<std::vector<std::uint64_t>> values(rounds);
+  for (std::size_t r{0}; r < rounds; ++r) {
+    std::shuffle(order.begin(), order.end(), rng);
+    for (const auto h : order) {
+      const auto operation{static_cast<heap_operation>(rng() % 3)};
+      plan[r].emplace_back(h, operation);
+      values[r].push_back(uniform(rng));
+    }
+  }
+
+  const auto run{[&](std::vector<std::uint64_t>& arena, auto apply) {
+    std::fill(sizes.begin(), sizes.end(), capacity / 2);
+    std::vector<heap_task<iterator>> tasks(heaps);
+    for (std::size_t r{0}; r < rounds; ++r) {
+      for (std::size_t i{0}; i < heaps; ++i) {
+        const auto [h, operation]{plan[r][i]};
+        const auto first{arena.begin()
+                         + static_cast<std::ptrdiff_t>(h * capacity)};
+        if (operation == heap_operation::push) {
+          *(first + static_cast<std::ptrdiff_t>(sizes[h]++)) = values[r][i];
+          tasks[i] = {first, first + static_cast<std::ptrdiff_t>(sizes[h]),
+                      operation};
+        }
+        else {
+          tasks[i] = {first, first + static_cast<std::ptrdiff_t>(sizes[h]--),
+                      operation};
+        }
+      }
+      apply(std::span<const heap_task<iterator>>{tasks});
+    }
+  }};
+
+  const auto one_at_a_time{[](std::span<const heap_task<iterator>> tasks) {
+    for (const auto& [first, last, operation] : tasks) {
+      switch (operation) {
+      case heap_operation::push:
+        push_mm_heap(first, last);
+        break;
+      case heap_operation::pop:
+        pop_mm_heap(first, last);
+        break;
+      case heap_operation::pop_max:
+        pop_max_mm_heap(first, last);
+        break;
+      }
+    }
+  }};
+  const auto in_batches{[](std::span<const heap_task<iterator>> tasks) {
+    batch_mm_heap(tasks);
+  }};
+
+  // Both variants start from the same heaps, the best of three runs counts.
+  const auto initial{single};
+  auto       t0{std::numeric_limits<double>::max()};
+  auto       t1{std::numeric_limits<double>::max()};
+  for (auto repetition{0}; repetition < 3; ++repetition) {
+    single = initial;
+    t0     = std::min(t0, seconds([&] {
+      run(single, one_at_a_time);
+    }));
+    batched = initial;
+    t1      = std::min(t1, seconds([&] {
+      run(batched, in_batches);
+    }));
+  }
+
+  const auto operations{static_cast<double>(heaps * rounds)};
+  std::cout << "\nOperations on " << heaps << " heaps of up to " << capacity
+            << " elements, million operations / s\n";
+  std::cout << std::left << std::setw(24) << "one at a time" << std::right
+            << std::fixed << std::setprecision(2) << std::setw(10)
+            << operations / t0 / 1e6 << '\n';
+  std::cout << std::left << std::setw(24) << "batch_mm_heap" << std::right
+            << std::setw(10) << operations / t1 / 1e6 << std::setw(8)
+            << (batched == single ? "ok" : "FAILED") << '\n';
+}
+
+/// @brief Returns the element of rank <tt>n / 2</tt> of @p samples.
+float samples_median(std::vector<float> samples)
+{
+  const auto median{samples.begin()
+                    + static_cast<std::ptrdiff_t>(samples.size() / 2)};
+  std::nth_element(samples.begin(), median, samples.end());
+  return *median;
+}
+
+void benchmark_incremental_build()
+{
+  constexpr std::size_t size{1 << 23};
+
+  std::mt19937                    rng{42};
+  std::normal_distribution<float> sample{100.0f, 15.0f};
+  std::vector<float>              samples(size);
+  for (auto& s : samples) {
+    s = sample(rng);
+  }
+  const std::vector<std::size_t> quartiles{size / 4, size / 2, size * 3 / 4};
+
+  std::cout << "\nBuilding a tree of " << size
+            << " floats with three quartiles, milliseconds\n";
+  std::cout << std::left << std::setw(24) << "budget" << std::right
+            << std::setw(10) << "total" << std::setw(10) << "resumes"
+            << std::setw(14) << "longest" << '\n';
+
+  auto       copy{samples};
+  const auto t0{seconds([&] {
+    order_statistics_tree<float> tree{std::move(copy), quartiles};
+  })};
+  std::cout << std::left << std::setw(24) << "none (constructor)"
+            << std::right << std::fixed << std::setprecision(1)
+            << std::setw(10) << t0 * 1e3 << std::setw(10) << 1
+            << std::setw(14) << t0 * 1e3 << '\n';
+
+  for (const auto budget : {std::chrono::milliseconds{1},
+                            std::chrono::milliseconds{4},
+                            std::chrono::milliseconds{16}}) {
+    incremental_tree_build<float> build{samples, quartiles};
+    std::size_t                   resumes{0};
+    double                        longest{0.0};
+    const auto                    total{seconds([&] {
+      for (auto done{false}; !done;) {
+        longest = std::max(longest, seconds([&] {
+          done = build.resume(budget);
+        }));
+        ++resumes;
+      }
+    })};
+    const auto tree{build.result()};
+    std::cout << std::left << std::setw(24)
+              << std::to_string(budget.count()) + " ms" << std::right
+              << std::setw(10) << total * 1e3 << std::setw(10) << resumes
+              << std::setw(14) << longest * 1e3 << std::setw(8)
+              << (tree.at_rank(1) == samples_median(samples) ? "ok" : "FAILED")
+              << '\n';
+  }
+}
+
+/// @brief Pushes @p samples to @p push and calls @p rebuild every
+/// @p interval samples.
+/// @return The total time and the longest push, including rebuilds, in
+/// seconds.
+template<typename Push, typename Rebuild>
+std::pair<double, double> time_pushes(const std::vector<float>& samples,
+                                      std::size_t               interval,
+                                      Push&&                    push,
+                                      Rebuild&&                 rebuild)
+{
+  double     longest{0.0};
+  const auto total{seconds([&] {
+    for (std::size_t i{0}; i < samples.size(); ++i) {
+      longest = std::max(longest, seconds([&] {
+        push(samples[i]);
+        if ((i + 1) % interval == 0) {
+          rebuild();
+        }
+      }));
+    }
+  })};
+  return {total, longest};
+}
+
+void benchmark_double_buffering()
+{
+  constexpr std::size_t initial{1 << 22};
+  constexpr std::size_t pushes{1 << 20};
+  constexpr std::size_t interval{1 << 18};
+
+  std::mt19937                    rng{43};
+  std::normal_distribution<float> sample{100.0f, 15.0f};
+  std::vector<float>              samples(initial + pushes);
+  for (auto& s : samples) {
+    s = sample(rng);
+  }
+  const std::vector<float> first(samples.begin(),
+                                 samples.begin() + std::ptrdiff_t{initial});
+  const std::vector<float> rest(samples.begin() + std::ptrdiff_t{initial},
+                                samples.end());
+  const std::vector<double> percentiles{0.5, 0.99};
+
+  std::cout << "\nPushing " << pushes << " floats to a tree of " << initial
+            << " floats, rebuilt every " << interval
+            << " pushes, milliseconds\n";
+  std::cout << std::left << std::setw(24) << "rebuild" << std::right
+            << std::setw(10) << "total" << std::setw(14) << "longest push"
+            << '\n';
+
+  // Rebuilds the tree in place, the writer waits for it.
+  const auto ranks{[&](std::size_t size) {
+    return std::vector<std::size_t>{size / 2, size * 99 / 100};
+  }};
+  order_statistics_tree<float> tree{first, ranks(initial)};
+  const auto [t0, l0]{time_pushes(
+    rest,
+    interval,
+    [&](float s) { tree.push(s); },
+    [&] {
+      const auto size{tree.size()};
+      tree = {tree.release(), ranks(size)};
+    })};
+  std::cout << std::left << std::setw(24) << "blocking" << std::right
+            << std::fixed << std::setprecision(3) << std::setw(10) << t0 * 1e3
+            << std::setw(14) << l0 * 1e3 << '\n';
+
+  double_buffered_tree<float> buffered{percentiles};
+  for (const auto s : first) {
+    buffered.push(s);
+  }
+  buffered.rebuild();
+  buffered.wait();
+  std::size_t rebuilds{0};
+  const auto [t1, l1]{time_pushes(
+    rest,
+    interval,
+    [&](float s) { buffered.push(s); },
+    [&] {
+      rebuilds += buffered.rebuild() ? 1 : 0;
+    })};
+  buffered.wait();
+  std::cout << std::left << std::setw(24) << "double buffered" << std::right
+            << std::setw(10) << t1 * 1e3 << std::setw(14) << l1 * 1e3
+            << std::setw(6) << rebuilds << " rebuilds\n";
+}
+
+/// @brief Returns the greatest over the mean of @p loads.
+double imbalance(const std::vector<double>& loads)
+{
+  const auto total{std::accumulate(loads.begin(), loads.end(), 0.0)};
+  return total == 0.0 ? 1.0
+                      : *std::max_element(loads.begin(), loads.end())
+                          * static_cast<double>(loads.size()) / total;
+}
+
+void benchmark_parallel_build()
+{
+  constexpr std::size_t size{1 << 23};
+  constexpr unsigned    threads{4};
+
+  std::mt19937                    rng{47};
+  std::normal_distribution<float> sample{100.0f, 15.0f};
+  std::vector<float>              samples(size);
+  for (auto& s : samples) {
+    s = sample(rng);
+  }
+
+  std::cout << "\nBuilding a tree of " << size << " floats with " << threads
+            << " workers\n";
+  std::cout << std::left << std::setw(24) << "ranks" << std::right
+            << std::setw(12) << "serial ms" << std::setw(12) << "tasks ms"
+            << std::setw(10) << "tasks" << std::setw(10) << "steals"
+            << std::setw(12) << "imbalance" << std::setw(10) << "static"
+            << '\n';
+
+  work_stealing_pool pool{threads};
+  for (const auto& [name, percentiles] :
+       {std::pair{"quartiles", std::vector<double>{0.25, 0.5, 0.75}},
+        std::pair{"p99 .. p99.999",
+                  std::vector<double>{0.99, 0.999, 0.9999, 0.99999}},
+        std::pair{"p0.1, p50, p99.9",
+                  std::vector<double>{0.001, 0.5, 0.999}}}) {
+    std::vector<std::size_t> positions;
+    for (const auto p : percentiles) {
+      positions.push_back(static_cast<std::size_t>(p * double{size - 1}));
+    }
+
+    auto v{samples};
+    std::vector<std::vector<float>::iterator> ranks;
+    for (const auto position : positions) {
+      ranks.push_back(v.begin() + static_cast<std::ptrdiff_t>(position));
+    }
+    const auto t0{seconds([&] {
+      make_order_statistics_tree(
+        v.begin(), v.end(), ranks.begin(), ranks.end());
+    })};
+
+    v = samples;
+    const auto t1{seconds([&] {
+      parallel_make_order_statistics_tree(
+        v.begin(), v.end(), ranks.begin(), ranks.end(), pool);
+    })};
+    const auto statistics{pool.statistics()};
+
+    // A static split hands every worker the same number of segments.
+    std::vector<double> static_loads(threads);
+    for (std::size_t i{0}; i <= positions.size(); ++i) {
+      const auto first{i == 0 ? 0 : positions[i - 1]};
+      const auto last{i == positions.size() ? size : positions[i]};
+      static_loads[i * threads / (positions.size() + 1)] +=
+        static_cast<double>(last - first);
+    }
+
+    std::cout << std::left << std::setw(24) << name << std::right << std::fixed
+              << std::setprecision(1) << std::setw(12) << t0 * 1e3
+              << std::setw(12) << t1 * 1e3 << std::setw(10)
+              << std::accumulate(statistics.tasks.begin(),
+                                 statistics.tasks.end(),
+                                 std::size_t{0})
+              << std::setw(10)
+              << std::accumulate(statistics.steals.begin(),
+                                 statistics.steals.end(),
+                                 std::size_t{0})
+              << std::setprecision(2) << std::setw(12)
+              << imbalance(statistics.busy_seconds) << std::setw(10)
+              << imbalance(static_loads) << '\n';
+  }
+
+  // One worker per CPU of every node.
+  const auto         topology{detect_numa_topology()};
+  work_stealing_pool numa_pool{topology};
+  std::cout << topology.nodes.size() << " NUMA node(s), " << topology.cpus()
+            << " CPUs\n";
+  const auto build{[&](const char* name, float* v, auto& executor) {
+    const std::array<float*, 4> ranks{v + size * 99 / 100,
+                                      v + size * 999 / 1000,
+                                      v + size * 9999 / 10000,
+                                      v + size * 99999 / 100000};
+    const auto                  t{seconds([&] {
+      parallel_make_order_statistics_tree(
+        v, v + size, ranks.begin(), ranks.end(), executor);
+    })};
+    const auto statistics{numa_pool.statistics()};
+    std::cout << std::left << std::setw(24) << name << std::right
+              << std::setprecision(1) << std::setw(12) << "-" << std::setw(12)
+              << t * 1e3 << std::setw(10)
+              << std::accumulate(statistics.tasks.begin(),
+                                 statistics.tasks.end(),
+                                 std::size_t{0})
+              << std::setw(10)
+              << std::accumulate(statistics.remote_steals.begin(),
+                                 statistics.remote_steals.end(),
+                                 std::size_t{0})
+              << " remote steals\n";
+  }};
+  // The pages of a copy lie where the copying thread runs, those of a first
+  // touch copy on the node of the worker that partitions them.
+  auto v{samples};
+  build("p99 .. p99.999, NUMA", v.data(), numa_pool);
+  first_touch_array<float> placed{numa_pool, std::span<const float>{samples}};
+  auto                     executor{placed.executor()};
+  build("  first touch", placed.begin(), executor);
+}
+
+
+void benchmark_parallel_selection()
+{
+  constexpr std::size_t size{1 << 24};
+
+  std::mt19937                    rng{53};
+  std::normal_distribution<float> sample{100.0f, 15.0f};
+  std::vector<float>              samples(size);
+  for (auto& s : samples) {
+    s = sample(rng);
+  }
+
+  // The median alone is a single subproblem, only the partitions themselves
+  // can be split across the workers.
+  std::cout << "\nSelecting the median of " << size << " floats\n";
+  std::cout << std::left << std::setw(24) << "workers" << std::right
+            << std::setw(16) << "nth_element ms" << std::setw(14)
+            << "parallel ms" << std::setw(14) << "tree ms" << '\n';
+  auto       v{samples};
+  const auto serial{seconds(
+    [&] { std::nth_element(v.begin(), v.begin() + size / 2, v.end()); })};
+  const auto expected{v[size / 2]};
+  for (const unsigned threads : {1u, 2u, 4u}) {
+    work_stealing_pool pool{threads};
+
+    v = samples;
+    const auto select{seconds([&] {
+      parallel_nth_element(
+        v.begin(), v.begin() + size / 2, v.end(), std::less<>{}, pool);
+    })};
+    if (v[size / 2] != expected) {
+      std::cout << "wrong median\n";
+    }
+
+    v = samples;
+    const std::array ranks{v.begin() + size / 2};
+    const auto build{seconds([&] {
+      parallel_make_order_statistics_tree(
+        v.begin(), v.end(), ranks.begin(), ranks.end(), pool);
+    })};
+    std::cout << std::left << std::setw(24) << threads << std::right
+              << std::fixed << std::setprecision(1) << std::setw(16)
+              << serial * 1e3 << std::setw(14) << select * 1e3
+              << std::setw(14) << build * 1e3 << '\n';
+  }
+}
+
+
+void benchmark_distributed_quantiles()
+{
+  constexpr std::size_t workers{8};
+  constexpr std::size_t shard_size{1 << 20};
+
+  std::mt19937                    rng{59};
+  std::normal_distribution<float> sample{100.0f, 15.0f};
+  std::vector<std::vector<float>> shards(workers);
+  for (auto& shard : shards) {
+    shard.resize(shard_size);
+    for (auto& s : shard) {
+      s = sample(rng);
+    }
+  }
+  const std::vector<double> percentiles{0.5, 0.9, 0.99, 0.999, 0.9999};
+
+  std::cout << "\nQuantiles of " << workers << " shards of " << shard_size
+            << " floats\n";
+  std::cout << std::left << std::setw(24) << "transport" << std::right
+            << std::setw(12) << "setup ms" << std::setw(12) << "select ms"
+            << std::setw(10) << "rounds" << std::setw(12) << "exchanged"
+            << '\n';
+  const auto report{[](const char*                         name,
+                       double                              setup,
+                       double                              select,
+                       const distributed_selection<float>& selection) {
+    std::cout << std::left << std::setw(24) << name << std::right << std::fixed
+              << std::setprecision(1) << std::setw(12) << setup * 1e3
+              << std::setw(12) << select * 1e3 << std::setw(10)
+              << selection.rounds << std::setw(12) << selection.exchanged
+              << '\n';
+  }};
+
+  distributed_selection<float> selection;
+#if defined(__unix__) || defined(__APPLE__)
+  {
+    std::optional<pipe_transport<float>> transport;
+    const auto setup{seconds([&] {
+      transport.emplace(pipe_transport<float>::fork(shards));
+      // The workers are ready once they reply.
+      transport->broadcast(selection_message<float>{});
+    })};
+    const auto select{seconds([&] {
+      selection = distributed_quantiles<float>(
+        *transport, std::span<const double>{percentiles});
+    })};
+    report("pipes", setup, select, selection);
+  }
+#endif
+
+  std::optional<in_process_transport<float>> transport;
+  const auto setup{seconds([&] { transport.emplace(shards); })};
+  const auto select{seconds([&] {
+    selection = distributed_quantiles<float>(
+      *transport, std::span<const double>{percentiles});
+  })};
+  report("in process", setup, select, selection);
+  std::cout << workers * shard_size
+            << " values would be exchanged to gather all shards\n";
+}
+
+
+void benchmark_snapshots()
+{
+  constexpr std::size_t size{1 << 24};
+
+  std::mt19937                    rng{79};
+  std::normal_distribution<float> sample{100.0f, 15.0f};
+  std::vector<float>              samples(size);
+  for (auto& s : samples) {
+    s = sample(rng);
+  }
+  const auto path{std::filesystem::temp_directory_path()
+                  / "order_statistics_benchmarks_snapshot.bin"};
+
+  const std::vector<std::size_t> ranks{
+    size / 2, size * 9 / 10, size * 99 / 100, size * 999 / 1000};
+  std::optional<order_statistics_tree<float>> tree;
+  const auto build{seconds([&] { tree.emplace(samples, ranks); })};
+  const auto save{seconds([&] { save_snapshot(path, *tree); })};
+  std::optional<order_statistics_snapshot<float>> snapshot;
+  const auto load{seconds([&] { snapshot.emplace(path); })};
+  const auto copy{seconds([&] { tree = snapshot->to_tree(); })};
+  std::filesystem::remove(path);
+
+  std::cout << "\nSnapshot of a tree of " << size << " floats\n"
+            << std::fixed << std::setprecision(1) << "build " << build * 1e3
+            << " ms, save " << save * 1e3 << " ms, map and check "
+            << load * 1e3 << " ms, copy into a tree " << copy * 1e3
+            << " ms\n";
+}
+
+void benchmark_ingest()
+{
+  constexpr std::size_t size{1 << 22};
+
+  std::mt19937                     rng{83};
+  std::normal_distribution<double> sample{100.0, 15.0};
+  std::string                      text{"id,latency\n"};
+  for (std::size_t i{0}; i < size; ++i) {
+    text += std::to_string(i) + ',' + std::to_string(sample(rng)) + '\n';
+  }
+  const auto gigabytes{static_cast<double>(text.size()) / 1e9};
+
+  std::cout << "\nParsing the second column of " << size << " lines ("
+            << std::fixed << std::setprecision(1) << gigabytes * 1e3
+            << " MB)\n";
+  const auto report{[&](const char* name, double time, double sum) {
+    std::cout << std::setw(24) << std::left << name << std::right
+              << std::setprecision(2) << std::setw(8) << gigabytes / time
+              << " GB/s (" << sum << ")\n";
+  }};
+
+  // Line by line into a growing vector.
+  std::vector<double> values;
+  const auto          scalar{seconds([&] {
+    std::string_view rest{text};
+    rest.remove_prefix(rest.find('\n') + 1);
+    while (!rest.empty()) {
+      const auto line{rest.substr(0, rest.find('\n'))};
+      rest.remove_prefix(std::min(rest.size(), line.size() + 1));
+      const auto field{line.substr(line.find(',') + 1)};
+      double     value{0};
+      std::from_chars(field.data(), field.data() + field.size(), value);
+      values.push_back(value);
+    }
+  })};
+  report("from_chars per line",
+         scalar,
+         std::accumulate(values.begin(), values.end(), 0.0));
+
+  ingested_column<double> column;
+  const auto              sequential{seconds(
+    [&] { column = parse_column<double>(text, {',', 1, true}); })};
+  report("parse_column",
+         sequential,
+         std::accumulate(
+           column.elements().begin(), column.elements().end(), 0.0));
+
+  work_stealing_pool pool{std::max(1u, std::thread::hardware_concurrency())};
+  const auto         parallel{seconds(
+    [&] { column = parse_column<double>(text, {',', 1, true}, pool); })};
+  report(("parse_column, " + std::to_string(pool.size()) + " threads").c_str(),
+         parallel,
+         std::accumulate(
+           column.elements().begin(), column.elements().end(), 0.0));
+}
+
+void benchmark_pipeline()
+{
+  constexpr std::size_t size{1 << 22};
+  // A device that delivers 1 MB per 5 ms, i.e., 200 MB/s.
+  constexpr auto block_time{std::chrono::milliseconds{5}};
+
+  std::mt19937                     rng{89};
+  std::normal_distribution<double> sample{100.0, 15.0};
+  std::string                      text{"id,latency\n"};
+  for (std::size_t i{0}; i < size; ++i) {
+    text += std::to_string(i) + ',' + std::to_string(sample(rng)) + '\n';
+  }
+  const std::vector<double> percentiles{0.5, 0.9, 0.99, 0.999};
+
+  const auto device{[&](bool throttled) {
+    return [&text, throttled, block_time, offset = std::size_t{0}](
+             char* buffer, std::size_t size) mutable {
+      if (throttled) {
+        std::this_thread::sleep_for(block_time);
+      }
+      const auto count{std::min(size, text.size() - offset)};
+      std::copy_n(text.data() + offset, count, buffer);
+      offset += count;
+      return count;
+    };
+  }};
+
+  std::cout << "\nPercentiles of the second column of " << size
+            << " lines (" << text.size() / 1000000 << " MB)\n";
+  for (const bool throttled : {false, true}) {
+    // Reads everything, then parses and builds.
+    double     sum{0};
+    const auto load_then_build{seconds([&] {
+      std::string loaded;
+      auto        read{device(throttled)};
+      for (;;) {
+        const auto offset{loaded.size()};
+        loaded.resize(offset + ingest_chunk_size);
+        const auto count{read(loaded.data() + offset, ingest_chunk_size)};
+        loaded.resize(offset + count);
+        if (count == 0) {
+          break;
+        }
+      }
+      auto column{parse_column<double>(loaded, {',', 1, true})};
+      const std::vector<double> values(column.elements().begin(),
+                                       column.elements().end());
+      std::vector<std::size_t> ranks;
+      for (const auto p : percentiles) {
+        ranks.push_back(static_cast<std::size_t>(
+          p * static_cast<double>(values.size() - 1) + 0.5));
+      }
+      const order_statistics_tree<double> tree{values, ranks};
+      sum += tree.at_rank(0);
+    })};
+
+    pipelined_tree_build<double> build{percentiles, {',', 1, true}};
+    const auto pipelined{seconds([&] {
+      build.run(device(throttled));
+      sum += build.quantile(0);
+    })};
+
+    std::cout << (throttled ? "200 MB/s source: " : "in memory:       ")
+              << std::fixed << std::setprecision(1) << "load then build "
+              << load_then_build * 1e3 << " ms, pipelined "
+              << pipelined * 1e3 << " ms, "
+              << build.statistics().fixup_elements
+              << " elements fixed up at the end (" << sum << ")\n";
+  }
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+void benchmark_shared_memory()
+{
+  constexpr std::size_t size{1 << 20};
+  constexpr int         reads{1000000};
+  constexpr int         requests{10000};
+
+  std::mt19937                    rng{71};
+  std::normal_distribution<float> sample{100.0f, 15.0f};
+  std::vector<float>              samples(size);
+  for (auto& s : samples) {
+    s = sample(rng);
+  }
+  const auto name{"/order_statistics_benchmarks_" + std::to_string(::getpid())};
+  shared_order_statistics_tree<float> tree{name,
+                                           std::span<const float>{samples},
+                                           {size / 2, size * 99 / 100},
+                                           2 * size};
+  const shared_order_statistics_reader<float> reader{name};
+
+  std::cout << "\nReading the median of a tree of " << size
+            << " floats in another mapping\n";
+  float      sum{0};
+  const auto shared{seconds([&] {
+    for (int i{0}; i < reads; ++i) {
+      sum += reader.at_rank(static_cast<std::size_t>(i % 2));
+    }
+  })};
+  const auto push{seconds([&] {
+    for (std::size_t i{0}; i < size; ++i) {
+      tree.push(samples[i]);
+    }
+  })};
+
+  // The same request answered by a thread through a socket.
+  int sockets[2];
+  if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+    return;
+  }
+  std::thread server{[&] {
+    std::uint32_t rank{0};
+    while (::read(sockets[1], &rank, sizeof(rank)) == sizeof(rank)) {
+      const auto value{tree.at_rank(rank)};
+      if (::write(sockets[1], &value, sizeof(value)) != sizeof(value)) {
+        break;
+      }
+    }
+  }};
+  const auto socket{seconds([&] {
+    for (int i{0}; i < requests; ++i) {
+      const auto rank{static_cast<std::uint32_t>(i % 2)};
+      float      value{0};
+      if (::write(sockets[0], &rank, sizeof(rank)) != sizeof(rank)
+          || ::read(sockets[0], &value, sizeof(value)) != sizeof(value)) {
+        break;
+      }
+      sum += value;
+    }
+  })};
+  ::close(sockets[0]);
+  server.join();
+  ::close(sockets[1]);
+
+  std::cout << std::fixed << std::setprecision(1) << "seqlock read "
+            << shared / reads * 1e9 << " ns, socket request "
+            << socket / requests * 1e9 << " ns, push and publish "
+            << push / size * 1e9 << " ns (" << sum << ")\n";
+}
+#endif
+
+void benchmark_operation_counters(perf_counters& counters)
+{
+  constexpr std::size_t size{1 << 22};
+
+  std::mt19937                          rng{97};
+  std::uniform_real_distribution<float> sample{0.0f, 1.0f};
+  std::vector<float>                    samples(size);
+  for (auto& s : samples) {
+    s = sample(rng);
+  }
+
+  std::cout << "\nCounters per element or operation on " << size
+            << " floats\n"
+            << std::setw(28) << std::left << "operation" << std::right
+            << std::setw(10) << "ns";
+  print_counter_names();
+  std::cout << '\n';
+
+  std::vector<float> values;
+  const auto         count{[&](const char* name, auto operation) {
+    values = samples;
+    counters.start();
+    const auto time{seconds(operation)};
+    const auto counts{counters.stop()};
+    std::cout << std::setw(28) << std::left << name << std::right
+              << std::setw(10) << std::defaultfloat << std::setprecision(3)
+              << time / size * 1e9;
+    print_counters(counts, size);
+    std::cout << '\n';
+  }};
+
+  count("make_mm_heap",
+        [&] { make_mm_heap(values.begin(), values.end()); });
+  count("push_mm_heap", [&] {
+    for (auto last{values.begin() + 1}; last <= values.end(); ++last) {
+      push_mm_heap(values.begin(), last);
+    }
+  });
+  make_mm_heap(samples.begin(), samples.end());
+  count("pop_mm_heap", [&] {
+    for (auto last{values.end()}; last != values.begin(); --last) {
+      pop_mm_heap(values.begin(), last);
+    }
+  });
+  std::shuffle(samples.begin(), samples.end(), rng);
+
+  std::array<std::vector<float>::iterator, 4> ranks;
+  count("make_order_statistics_tree", [&] {
+    ranks = {values.begin() + size / 2,
+             values.begin() + size * 9 / 10,
+             values.begin() + size * 99 / 100,
+             values.begin() + size * 999 / 1000};
+    make_order_statistics_tree(
+      values.begin(), values.end(), ranks.begin(), ranks.end());
+  });
+  count("std::nth_element", [&] {
+    std::nth_element(values.begin(), values.begin() + size / 2, values.end());
+  });
+  work_stealing_pool pool;
+  count("parallel_nth_element", [&] {
+    parallel_nth_element(values.begin(),
+                         values.begin() + size / 2,
+                         values.end(),
+                         std::less<>{},
+                         pool);
+  });
+}
+
+void benchmark_distributions()
+{
+  using namespace order_statistics::datasets;
+  constexpr std::size_t size{1 << 22};
+
+  std::cout << "\nShapes of " << size << " floats, ns per element\n"
+            << std::setw(20) << std::left << "distribution" << std::right
+            << std::setw(14) << "make_mm_heap" << std::setw(14) << "tree"
+            << std::setw(14) << "nth_element" << std::setw(14)
+            << "comparisons" << '\n';
+  for (const auto d : distributions) {
+    const auto         samples{generate<float>(d, size)};
+    std::vector<float> values;
+    const auto         per_element{[&](auto operation) {
+      values = samples;
+      return seconds(operation) / size * 1e9;
+    }};
+
+    const auto heap{per_element(
+      [&] { make_mm_heap(values.begin(), values.end()); })};
+    const auto tree{per_element([&] {
+      const std::array ranks{values.begin() + size / 2,
+                             values.begin() + size * 9 / 10,
+                             values.begin() + size * 99 / 100,
+                             values.begin() + size * 999 / 1000};
+      make_order_statistics_tree(
+        values.begin(), values.end(), ranks.begin(), ranks.end());
+    })};
+    std::size_t comparisons{0};
+    const auto  nth{per_element([&] {
+      std::nth_element(values.begin(),
+                       values.begin() + size / 2,
+                       values.end(),
+                       [&](float a, float b) {
+                         ++comparisons;
+                         return a < b;
+                       });
+    })};
+
+    std::cout << std::setw(20) << std::left << name(d) << std::right
+              << std::fixed << std::setprecision(1) << std::setw(14) << heap
+              << std::setw(14) << tree << std::setw(14) << nth
+              << std::setw(14)
+              << static_cast<double>(comparisons) / static_cast<double>(size)
+              << '\n';
+  }
+}
+
+void benchmark_latencies()
+{
+  using namespace order_statistics::datasets;
+  constexpr std::size_t size{1 << 20};
+  const auto samples{generate<float>(distribution::uniform, size)};
+
+  std::cout << "\nLatencies of " << size << " operations each, ns"
+            << (record_latencies ? "" : " (not recorded)") << '\n'
+            << std::setw(20) << std::left << "operation" << std::right
+            << std::setw(10) << "mean" << std::setw(10) << "p50"
+            << std::setw(10) << "p99" << std::setw(10) << "p99.9"
+            << std::setw(10) << "max" << '\n';
+  const auto print{
+    [](const char* name, double time, const latency_histogram& latencies) {
+      std::cout << std::setw(20) << std::left << name << std::right
+                << std::fixed << std::setprecision(1) << std::setw(10)
+                << time / size * 1e9;
+      for (const auto p : {0.5, 0.99, 0.999, 1.0}) {
+        std::cout << std::setw(10) << latencies.quantile(p);
+      }
+      std::cout << '\n';
+    }};
+
+  minmax_priority_queue<float> queue;
+  queue.reserve(size);
+  const auto push{seconds([&] {
+    for (const auto s : samples) {
+      queue.push(s);
+    }
+  })};
+  const auto pop{seconds([&] {
+    for (std::size_t i{0}; i < size; ++i) {
+      if (i % 2 == 0) {
+        queue.pop_min();
+      }
+      else {
+        queue.pop_max();
+      }
+    }
+  })};
+  print("queue push", push, queue.latencies(queue_operation::push));
+  print("queue pop_min", pop, queue.latencies(queue_operation::pop_min));
+  print("queue pop_max", pop, queue.latencies(queue_operation::pop_max));
+
+  order_statistics_tree<float> tree{
+    {samples.begin(), samples.begin() + size / 2},
+    {size / 4, size * 9 / 20, size * 99 / 200}};
+  tree.reserve(size);
+  const auto tree_push{seconds([&] {
+    for (auto it{samples.begin() + size / 2}; it != samples.end(); ++it) {
+      tree.push(*it);
+    }
+  })};
+  print("tree push", tree_push * 2, tree.latencies(tree_operation::push));
+}
+
+/// @brief Runs @p benchmark and prints the counts of its events.
+template<typename F>
+void run_benchmark(perf_counters& counters, F&& benchmark)
+{
+  counters.start();
+  benchmark();
+  const auto counts{counters.stop()};
+  std::cout << "counters:";
+  for (std::size_t i{0}; i < counts.size(); ++i) {
+    std::cout << ' ' << counter_names[i] << ' ';
+    if (counts[i]) {
+      std::cout << std::defaultfloat << std::setprecision(3) << *counts[i];
+    }
+    else {
+      std::cout << "n/a";
+    }
+  }
+  std::cout << '\n';
+}
+
+/// @brief Number of elements of the inputs of the regression gate.
+constexpr std::size_t regression_size{1 << 20};
+
+/// @brief Operations whose throughput the regression gate compares.
+constexpr std::array<std::string_view, 3> regression_operations{
+  "make_mm_heap", "pop_mm_heap", "make_order_statistics_tree"};
+
+/// @brief Throughputs in elements per second, one per repetition, of every
+/// regression operation.
+using throughputs =
+  std::array<std::vector<double>, regression_operations.size()>;
+
+/// @brief Measures the regression_operations @p repetitions times on uniform
+/// floats.
+///
+/// The operations take turns, so a drift of the clock or of the load of the
+/// machine affects all of them alike. The first round warms the caches and
+/// the allocator and is discarded.
+throughputs measure_throughputs(std::size_t repetitions)
+{
+  using namespace order_statistics::datasets;
+  const auto samples{generate<float>(distribution::uniform, regression_size)};
+  auto       heap{samples};
+  make_mm_heap(heap.begin(), heap.end());
+
+  throughputs        result;
+  std::vector<float> values;
+  const auto         measure{
+    [&](std::size_t operation, const std::vector<float>& input, auto f) {
+      values = input;
+      result[operation].push_back(regression_size / seconds(f));
+    }};
+  for (std::size_t round{0}; round <= repetitions; ++round) {
+    measure(0, samples, [&] { make_mm_heap(values.begin(), values.end()); });
+    measure(1, heap, [&] {
+      for (auto last{values.end()}; last != values.begin(); --last) {
+        pop_mm_heap(values.begin(), last);
+      }
+    });
+    measure(2, samples, [&] {
+      const std::array ranks{values.begin() + regression_size / 2,
+                             values.begin() + regression_size * 9 / 10,
+                             values.begin() + regression_size * 99 / 100,
+                             values.begin() + regression_size * 999 / 1000};
+      make_order_statistics_tree(
+        values.begin(), values.end(), ranks.begin(), ranks.end());
+    });
+  }
+  for (auto& t : result) {
+    t.erase(t.begin());
+  }
+  return result;
+}
+
+/// @brief Writes @p t as the JSON object
+/// {"elements": N, "throughputs": {"make_mm_heap": [...], ...}}.
+/// @throws std::runtime_error if the file cannot be written.
+void write_baseline(const std::string& path, const throughputs& t)
+{
+  std::ofstream out{path};
+  out << "{\n  \"elements\": " << regression_size << ",\n  \"throughputs\": {"
+      << std::setprecision(std::numeric_limits<double>::max_digits10);
+  for (std::size_t i{0}; i < t.size(); ++i) {
+    out << (i == 0 ? "\n" : ",\n") << "    \"" << regression_operations[i]
+        << "\": [";
+    for (std::size_t j{0}; j < t[i].size(); ++j) {
+      out << (j == 0 ? "" : ", ") << t[i][j];
+    }
+    out << ']';
+  }
+  out << "\n  }\n}\n";
+  if (!out.flush()) {
+    throw std::runtime_error{"cannot write " + path};
+  }
+}
+
+/// @brief Reads the JSON written by write_baseline(): Objects, arrays,
+/// numbers and strings without escapes.
+class json_reader {
+public:
+  explicit json_reader(std::string json) : text{std::move(json)} {}
+
+  /// @brief Consumes @p c if it is the next character after whitespace.
+  bool consume(char c)
+  {
+    skip_whitespace();
+    if (position < text.size() && text[position] == c) {
+      ++position;
+      return true;
+    }
+    return false;
+  }
+
+  /// @throws std::runtime_error if @p c is not the next character.
+  void expect(char c)
+  {
+    if (!consume(c)) {
+      throw error(std::string{"expected '"} + c + '\'');
+    }
+  }
+
+  std::string string()
+  {
+    expect('"');
+    const auto end{text.find_first_of("\"\\", position)};
+    if (end == std::string::npos || text[end] != '"') {
+      throw error("unsupported string");
+    }
+    auto result{text.substr(position, end - position)};
+    position = end + 1;
+    return result;
+  }
+
+  double number()
+  {
+    skip_whitespace();
+    double     value{0.0};
+    const auto first{text.data() + position};
+    const auto result{
+      std::from_chars(first, text.data() + text.size(), value)};
+    if (result.ec != std::errc{}) {
+      throw error("expected a number");
+    }
+    position += static_cast<std::size_t>(result.ptr - first);
+    return value;
+  }
+
+  /// @throws std::runtime_error if anything but whitespace is left.
+  void finish()
+  {
+    skip_whitespace();
+    if (position != text.size()) {
+      throw error("trailing characters");
+    }
+  }
+
+private:
+  void skip_whitespace() noexcept
+  {
+    position = std::min(text.find_first_not_of(" \t\r\n", position),
+                        text.size());
+  }
+
+  std::runtime_error error(const std::string& what) const
+  {
+    return std::runtime_error{"offset " + std::to_string(position) + ": "
+                              + what};
+  }
+
+  std::string text;
+  std::size_t position{0};
+};
+
+/// @brief Reads a baseline written by write_baseline().
+/// @throws std::runtime_error if the file cannot be read or holds no
+/// baseline of regression_size elements.
+throughputs read_baseline(const std::string& path)
+{
+  std::ifstream      in{path};
+  std::ostringstream contents;
+  if (!(contents << in.rdbuf())) {
+    throw std::runtime_error{"cannot read " + path};
+  }
+  json_reader json{contents.str()};
+  throughputs result;
+  double      elements{0.0};
+  json.expect('{');
+  do {
+    const auto key{json.string()};
+    json.expect(':');
+    if (key == "elements") {
+      elements = json.number();
+    }
+    else if (key == "throughputs") {
+      json.expect('{');
+      while (!json.consume('}')) {
+        const auto name{json.string()};
+        const auto operation{std::find(regression_operations.begin(),
+                                       regression_operations.end(),
+                                       name)};
+        if (operation == regression_operations.end()) {
+          throw std::runtime_error{path + ": unknown operation " + name};
+        }
+        auto& values{result[static_cast<std::size_t>(
+          operation - regression_operations.begin())]};
+        json.expect(':');
+        json.expect('[');
+        values.clear();
+        if (!json.consume(']')) {
+          do {
+            values.push_back(json.number());
+          } while (json.consume(','));
+          json.expect(']');
+        }
+        if (!json.consume(',')) {
+          json.expect('}');
+          break;
+        }
+      }
+    }
+    else {
+      throw std::runtime_error{path + ": unknown key " + key};
+    }
+  } while (json.consume(','));
+  json.expect('}');
+  json.finish();
+
+  if (elements != static_cast<double>(regression_size)) {
+    std::ostringstream message;
+    message << path << ": the baseline was measured on " << elements
+            << " elements, not " << regression_size;
+    throw std::runtime_error{message.str()};
+  }
+  for (std::size_t i{0}; i < result.size(); ++i) {
+    if (result[i].size() < 2) {
+      throw std::runtime_error{path + ": fewer than 2 measurements of "
+                               + std::string{regression_operations[i]}};
+    }
+  }
+  return result;
+}
+
+/// @brief Mean and unbiased variance of measurements.
+struct sample_summary {
+  double      mean{0.0};
+  double      variance{0.0};
+  std::size_t count{0};
+};
+
+sample_summary summarize(const std::vector<double>& values)
+{
+  sample_summary result{0.0, 0.0, values.size()};
+  const auto     n{static_cast<double>(values.size())};
+  result.mean = std::accumulate(values.begin(), values.end(), 0.0) / n;
+  for (const auto v : values) {
+    result.variance += (v - result.mean) * (v - result.mean) / (n - 1.0);
+  }
+  return result;
+}
+
+/// @brief Returns the 97.5th percentile of Student's t distribution with
+/// @p degrees_of_freedom, for two-sided 95% confidence intervals.
+///
+/// Fractional degrees of freedom are rounded down, which widens the
+/// intervals. Beyond the table, the Cornish-Fisher expansion around the
+/// normal quantile is accurate to three digits.
+double t_quantile(double degrees_of_freedom)
+{
+  constexpr std::array<double, 30> table{
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+  const auto df{std::max(degrees_of_freedom, 1.0)};
+  if (df < static_cast<double>(table.size() + 1)) {
+    return table[static_cast<std::size_t>(df) - 1];
+  }
+  constexpr double z{1.959963984540054};
+  return z + (z * z * z + z) / (4.0 * df)
+         + (5.0 * std::pow(z, 5) + 16.0 * z * z * z + 3.0 * z)
+             / (96.0 * df * df);
+}
+
+/// @brief Returns half the width of the 95% confidence interval of the mean
+/// of @p s.
+double confidence(const sample_summary& s)
+{
+  const auto n{static_cast<double>(s.count)};
+  return t_quantile(n - 1.0) * std::sqrt(s.variance / n);
+}
+
+/// @brief Compares @p current to @p baseline with Welch's t-test and prints
+/// the relative changes of the mean throughputs with their 95% confidence
+/// intervals.
+/// @return @c true if an operation is slower than the baseline by more than
+/// @p tolerance with 95% confidence.
+bool compare_throughputs(const throughputs& baseline,
+                         const throughputs& current,
+                         double             tolerance)
+{
+  std::cout << "Throughput of " << regression_size
+            << " floats in millions of elements per second, 95% confidence\n"
+            << std::setw(28) << std::left << "operation" << std::right
+            << std::setw(20) << "baseline" << std::setw(20) << "current"
+            << std::setw(26) << "change" << '\n';
+  bool regressed{false};
+  for (std::size_t i{0}; i < baseline.size(); ++i) {
+    const auto b{summarize(baseline[i])};
+    const auto c{summarize(current[i])};
+
+    // Welch-Satterthwaite degrees of freedom of the difference.
+    const auto vb{b.variance / static_cast<double>(b.count)};
+    const auto vc{c.variance / static_cast<double>(c.count)};
+    const auto error{std::sqrt(vb + vc)};
+    const auto df{error == 0.0 ? 1.0
+                               : (vb + vc) * (vb + vc)
+                                   / (vb * vb / static_cast<double>(b.count - 1)
+                                      + vc * vc
+                                          / static_cast<double>(c.count - 1))};
+    const auto change{(c.mean - b.mean) / b.mean};
+    const auto margin{t_quantile(df) * error / b.mean};
+
+    const auto slower{change + margin < -tolerance};
+    const auto faster{change - margin > tolerance};
+    regressed = regressed || slower;
+
+    std::ostringstream interval;
+    interval << std::showpos << std::fixed << std::setprecision(1)
+             << 100.0 * change << "% [" << 100.0 * (change - margin) << ", "
+             << 100.0 * (change + margin) << ']';
+    const auto format{[](const sample_summary& s) {
+      std::ostringstream out;
+      out << std::fixed << std::setprecision(2) << s.mean / 1e6 << " +- "
+          << confidence(s) / 1e6;
+      return out.str();
+    }};
+    std::cout << std::setw(28) << std::left << regression_operations[i]
+              << std::right << std::setw(20) << format(b) << std::setw(20)
+              << format(c) << std::setw(26) << interval.str() << "  "
+              << (slower ? "REGRESSION" : faster ? "faster" : "ok") << '\n';
+  }
+  return regressed;
+}
+
+/// @brief Options of the regression gate.
+struct options {
+  std::optional<std::string> record;
+  std::optional<std::string> compare;
+  std::size_t                repetitions{15};
+  double                     tolerance{0.05};
+};
+
+constexpr std::string_view usage{
+  "usage: order_statistics_benchmarks [options]\n"
+  "  without options         runs all benchmarks\n"
+  "  --record FILE           measures the throughputs into a JSON baseline\n"
+  "  --compare FILE          fails if the throughputs regressed from FILE\n"
+  "  --repetitions N         measurements of every operation (15)\n"
+  "  --tolerance T           relative slowdown that passes (0.05)\n"};
+
+/// @throws std::invalid_argument for unknown or malformed options.
+options parse_options(std::span<char*> list)
+{
+  options                 result;
+  command_line::arguments arguments{list};
+  while (!arguments.empty()) {
+    const auto argument{arguments.next()};
+    if (argument == "--record") {
+      result.record = arguments.value();
+    }
+    else if (argument == "--compare") {
+      result.compare = arguments.value();
+    }
+    else if (argument == "--repetitions") {
+      result.repetitions = arguments.number<std::size_t>();
+      if (result.repetitions < 2) {
+        throw std::invalid_argument{"at least 2 repetitions are needed"};
+      }
+    }
+    else if (argument == "--tolerance") {
+      result.tolerance = arguments.number<double>();
+      if (!(result.tolerance >= 0.0)) {
+        throw std::invalid_argument{"tolerance must not be negative"};
+      }
+    }
+    else if (argument == "-h" || argument == "--help") {
+      std::cout << usage;
+      std::exit(0);
+    }
+    else {
+      arguments.unknown();
+    }
+  }
+  return result;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+  try {
+    const auto options{parse_options(
+      std::span<char*>{argv + 1, static_cast<std::size_t>(argc - 1)})};
+    if (options.record || options.compare) {
+      const auto baseline{options.compare ? read_baseline(*options.compare)
+                                          : throughputs{}};
+      const auto current{measure_throughputs(options.repetitions)};
+      if (options.record) {
+        write_baseline(*options.record, current);
+      }
+      return options.compare
+                 && compare_throughputs(baseline, current, options.tolerance)
+               ? 1
+               : 0;
+    }
+  }
+  catch (const std::invalid_argument& e) {
+    std::cerr << "order_statistics_benchmarks: " << e.what() << '\n' << usage;
+    return 2;
+  }
+  catch (const std::exception& e) {
+    std::cerr << "order_statistics_benchmarks: " << e.what() << '\n';
+    return 2;
+  }
+
+  perf_counters counters;
+  benchmark_operation_counters(counters);
+  run_benchmark(counters, benchmark_distributions);
+  run_benchmark(counters, benchmark_latencies);
+  run_benchmark(counters, benchmark_replacement_selection);
+  run_benchmark(counters, benchmark_median_filters);
+  run_benchmark(counters, benchmark_rolling_quantiles);
+  run_benchmark(counters, benchmark_running_median);
+  run_benchmark(counters, benchmark_heap_batches);
+  run_benchmark(counters, benchmark_incremental_build);
+  run_benchmark(counters, benchmark_double_buffering);
+  run_benchmark(counters, benchmark_parallel_build);
+  run_benchmark(counters, benchmark_parallel_selection);
+  run_benchmark(counters, benchmark_distributed_quantiles);
+  run_benchmark(counters, benchmark_snapshots);
+  run_benchmark(counters, benchmark_ingest);
+  run_benchmark(counters, benchmark_pipeline);
+#if defined(__unix__) || defined(__APPLE__)
+  run_benchmark(counters, benchmark_shared_memory);
+#endif
+}
@@ -0,0 +1,256 @@
+/// @file
+/// Inputs of the shapes heaps and trees meet in production, for the tests and
+/// the benchmarks.
+///
+/// Every distribution first generates values as @c double, which are then
+/// converted to the element type preserving their order: Integers that do not
+/// fit into the type are scaled into its range, strings are the zero-padded
+/// decimal integer parts, so their lexicographical order is the numeric
+/// order. The same distribution, size and seed give the same values.
+///
+/// The nth_element killer is built by the adversary of M. D. McIlroy, A
+/// Killer Adversary for Quicksort (1999), against std::nth_element() of the
+/// standard library in use: The adversary decides the order of the elements
+/// only when std::nth_element() compares them, always so that the pivot is
+/// as small as possible.
+
+/// @cond
+module;
+/// @endcond
+
+// C++ Standard Library.
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+/// @cond
+export module order_statistics_datasets;
+/// @endcond
+
+namespace order_statistics::datasets {
+
+/// @brief Exponent of the Zipf distribution.
+inline constexpr double zipf_exponent{1.1};
+
+/// @brief Number of distinct values of the few_unique distribution.
+inline constexpr std::size_t few_unique_values{16};
+
+/// @brief Number of teeth of the sawtooth distribution.
+inline constexpr std::size_t sawtooth_teeth{16};
+
+/// @brief Returns the values of rank 1 to @p size with the probability
+/// proportional to rank^-zipf_exponent, by inverting the continuous power
+/// law.
+inline std::vector<double> zipf(std::size_t size, std::mt19937_64& rng)
+{
+  std::uniform_real_distribution<double> sample{0.0, 1.0};
+  const auto                             a{1.0 - zipf_exponent};
+  const auto top{std::pow(static_cast<double>(size) + 1.0, a) - 1.0};
+  std::vector<double> values(size);
+  for (auto& v : values) {
+    v = std::min(std::floor(std::pow(top * sample(rng) + 1.0, 1.0 / a)),
+                 static_cast<double>(size));
+  }
+  return values;
+}
+
+/// @brief Returns an input on which std::nth_element() of the median makes
+/// as many comparisons as McIlroy's adversary can force.
+inline std::vector<double> nth_element_killer(std::size_t size)
+{
+  // The value of every element, gas until the adversary freezes it.
+  const auto               gas{size};
+  std::vector<std::size_t> values(size, gas);
+  std::size_t              frozen{0};
+  std::size_t              candidate{0};
+
+  std::vector<std::size_t> elements(size);
+  std::iota(elements.begin(), elements.end(), std::size_t{0});
+  std::nth_element(elements.begin(),
+                   elements.begin() + static_cast<std::ptrdiff_t>(size / 2),
+                   elements.end(),
+                   [&](std::size_t x, std::size_t y) {
+                     // Of two gas elements, the likely pivot is frozen.
+                     if (values[x] == gas && values[y] == gas) {
+                       values[x == candidate ? x : y] = frozen++;
+                     }
+                     if (values[x] == gas) {
+                       candidate = x;
+                     }
+                     else if (values[y] == gas) {
+                       candidate = y;
+                     }
+                     return values[x] < values[y];
+                   });
+  return {values.begin(), values.end()};
+}
+
+/// @brief Converts @p values to @p T preserving their order.
+template<typename T>
+std::vector<T> convert(const std::vector<double>& values)
+{
+  const auto greatest{
+    values.empty() ? 0.0 : *std::max_element(values.begin(), values.end())};
+  std::vector<T> result;
+  result.reserve(values.size());
+  if constexpr (std::is_same_v<T, std::string>) {
+    const auto width{std::to_string(static_cast<std::uint64_t>(greatest))
+                       .size()};
+    for (const auto v : values) {
+      const auto digits{std::to_string(static_cast<std::uint64_t>(v))};
+      result.push_back(std::string(width - digits.size(), '0') + digits);
+    }
+  }
+  else if constexpr (std::is_integral_v<T>) {
+    constexpr auto limit{static_cast<double>(std::numeric_limits<T>::max())};
+    const auto     scale{greatest > limit ? limit / greatest : 1.0};
+    for (const auto v : values) {
+      result.push_back(static_cast<T>(v * scale));
+    }
+  }
+  else {
+    for (const auto v : values) {
+      result.push_back(static_cast<T>(v));
+    }
+  }
+  return result;
+}
+
+}
+
+export namespace order_statistics::datasets {
+
+/// @brief Shapes of inputs.
+enum class distribution {
+  /// Uniform in [0, size).
+  uniform,
+  /// Ranks from 1 to size, rank k with a probability proportional to
+  /// k^-1.1, i.e., a few values are very frequent.
+  zipf,
+  /// Latency-like, 1000 e^X with X normally distributed, mean 0 and
+  /// standard deviation 1.
+  lognormal,
+  /// 0, 1, ..., size - 1.
+  sorted,
+  /// size - 1, ..., 1, 0.
+  reverse_sorted,
+  /// Ascending to the middle, then descending.
+  organ_pipe,
+  /// Sixteen ascending runs.
+  sawtooth,
+  /// Uniform among sixteen values.
+  few_unique,
+  /// A single value.
+  all_equal,
+  /// The input that is worst for std::nth_element(), see the file comment.
+  nth_element_killer,
+};
+
+/// @brief All distributions, in the order of their declaration.
+inline constexpr std::array<distribution, 10> distributions{
+  distribution::uniform,
+  distribution::zipf,
+  distribution::lognormal,
+  distribution::sorted,
+  distribution::reverse_sorted,
+  distribution::organ_pipe,
+  distribution::sawtooth,
+  distribution::few_unique,
+  distribution::all_equal,
+  distribution::nth_element_killer};
+
+/// @brief Returns the name of @p d, e.g., "organ_pipe".
+constexpr std::string_view name(distribution d) noexcept
+{
+  constexpr std::array<std::string_view, distributions.size()> names{
+    "uniform",
+    "zipf",
+    "lognormal",
+    "sorted",
+    "reverse_sorted",
+    "organ_pipe",
+    "sawtooth",
+    "few_unique",
+    "all_equal",
+    "nth_element_killer"};
+  return names[static_cast<std::size_t>(d)];
+}
+
+/// @brief Returns @p size values of the distribution @p d.
+/// @tparam T An arithmetic type or std::string.
+/// @param seed Seed of the random distributions.
+template<typename T>
+std::vector<T>
+generate(distribution d, std::size_t size, std::uint64_t seed = 1)
+{
+  std::mt19937_64     rng{seed};
+  std::vector<double> values(size);
+  const auto          n{static_cast<double>(size)};
+  switch (d) {
+  case distribution::uniform: {
+    std::uniform_real_distribution<double> sample{0.0, n};
+    for (auto& v : values) {
+      v = sample(rng);
+    }
+    break;
+  }
+  case distribution::zipf:
+    values = zipf(size, rng);
+    break;
+  case distribution::lognormal: {
+    std::lognormal_distribution<double> sample{0.0, 1.0};
+    for (auto& v : values) {
+      v = 1000.0 * sample(rng);
+    }
+    break;
+  }
+  case distribution::sorted:
+    std::iota(values.begin(), values.end(), 0.0);
+    break;
+  case distribution::reverse_sorted:
+    std::iota(values.rbegin(), values.rend(), 0.0);
+    break;
+  case distribution::organ_pipe:
+    for (std::size_t i{0}; i < size; ++i) {
+      values[i] = static_cast<double>(std::min(i, size - 1 - i));
+    }
+    break;
+  case distribution::sawtooth: {
+    const auto tooth{std::max<std::size_t>(
+      (size + sawtooth_teeth - 1) / sawtooth_teeth, 1)};
+    for (std::size_t i{0}; i < size; ++i) {
+      values[i] = static_cast<double>(i % tooth);
+    }
+    break;
+  }
+  case distribution::few_unique: {
+    std::uniform_int_distribution<std::size_t> sample{
+      0, few_unique_values - 1};
+    for (auto& v : values) {
+      v = static_cast<double>(sample(rng));
+    }
+    break;
+  }
+  case distribution::all_equal:
+    std::fill(values.begin(), values.end(), 42.0);
+    break;
+  case distribution::nth_element_killer:
+    values = nth_element_killer(size);
+    break;
+  default:
+    throw std::invalid_argument{"unknown distribution"};
+  }
+  return convert<T>(values);
+}
+
+}
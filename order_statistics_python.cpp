@@ -0,0 +1,277 @@
+/// @file
+/// Python bindings that work in place on NumPy arrays.
+///
+/// Every function takes a writable, C-contiguous, one-dimensional array of
+/// int32, int64, float32 or float64 values through the buffer protocol and
+/// reorders its elements in place, no element is copied. The GIL is released
+/// while the elements are reordered.
+///
+/// Other objects, e.g., lists, are not converted, since the conversion would
+/// reorder a copy.
+///
+/// @code{.py}
+/// import numpy as np
+/// import order_statistics as ost
+///
+/// latencies = np.fromfile("latencies.bin", dtype=np.float32)
+/// p50, p99 = ost.quantiles(latencies, [0.5, 0.99])  # reorders latencies
+///
+/// # The values of group i are values[offsets[i]:offsets[i + 1]].
+/// table = ost.grouped_quantiles(values, offsets, [0.5, 0.99])
+/// @endcode
+///
+/// A percentile p in [0, 1] is the element of rank percentile_rank(p, size).
+/// NaN values have no rank and are rejected.
+
+// C++ Standard Library.
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+// pybind11.
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+import order_statistics;
+
+namespace py = pybind11;
+
+using namespace order_statistics;
+
+namespace {
+
+/// @brief Calls @p f with a span of the elements of @p array, whose type is
+/// the element type of the array.
+/// @throws py::type_error if the elements have another type.
+/// @throws std::invalid_argument if the array is not one-dimensional,
+/// contiguous and, unless @p writable is @c false, writable.
+template<typename F>
+py::object visit_elements(const py::array& array, F&& f, bool writable = true)
+{
+  if (array.ndim() != 1) {
+    throw std::invalid_argument{"expected a one-dimensional array"};
+  }
+  if ((array.flags() & py::array::c_style) == 0) {
+    throw std::invalid_argument{"expected a contiguous array"};
+  }
+  if (writable && !array.writeable()) {
+    throw std::invalid_argument{"the array is read-only"};
+  }
+  const auto size{static_cast<std::size_t>(array.shape(0))};
+  const auto elements{[&]<typename T>(T*) {
+    // The data of a read-only array is never written.
+    return f(std::span<T>{
+      static_cast<T*>(const_cast<void*>(array.data())), size});
+  }};
+  if (py::isinstance<py::array_t<std::int32_t>>(array)) {
+    return elements(static_cast<std::int32_t*>(nullptr));
+  }
+  if (py::isinstance<py::array_t<std::int64_t>>(array)) {
+    return elements(static_cast<std::int64_t*>(nullptr));
+  }
+  if (py::isinstance<py::array_t<float>>(array)) {
+    return elements(static_cast<float*>(nullptr));
+  }
+  if (py::isinstance<py::array_t<double>>(array)) {
+    return elements(static_cast<double*>(nullptr));
+  }
+  throw py::type_error{"expected int32, int64, float32 or float64 values"};
+}
+
+/// @throws std::invalid_argument if @p values contain NaN.
+template<typename T>
+void check_ordered(std::span<const T> values)
+{
+  if constexpr (std::is_floating_point_v<T>) {
+    if (std::any_of(values.begin(), values.end(), [](T value) {
+          return std::isnan(value);
+        })) {
+      throw std::invalid_argument{"NaN has no rank"};
+    }
+  }
+}
+
+/// @brief Turns @p values into an order statistics tree with the ranks of
+/// @p percentiles and writes the percentiles to @p out.
+template<typename T, typename Executor>
+void select_percentiles(std::span<T>            values,
+                        std::span<const double> percentiles,
+                        T*                      out,
+                        Executor&               executor)
+{
+  const auto [ranks, index]{make_percentile_ranks(percentiles, values.size())};
+  std::vector<T*> rank_its;
+  for (const auto rank : ranks) {
+    rank_its.push_back(values.data() + rank);
+  }
+  parallel_make_order_statistics_tree(values.data(),
+                                      values.data() + values.size(),
+                                      rank_its.begin(),
+                                      rank_its.end(),
+                                      executor);
+  for (const auto i : index) {
+    *out++ = values[ranks[i]];
+  }
+}
+
+void make_heap(const py::array& array)
+{
+  visit_elements(array, []<typename T>(std::span<T> values) {
+    {
+      const py::gil_scoped_release release;
+      check_ordered<T>(values);
+      make_mm_heap(values.begin(), values.end());
+    }
+    return py::none{};
+  });
+}
+
+bool is_heap(const py::array& array)
+{
+  return visit_elements(
+           array,
+           []<typename T>(std::span<T> values) {
+             bool result{false};
+             {
+               const py::gil_scoped_release release;
+               result = is_mm_heap(values.begin(), values.end());
+             }
+             return py::bool_{result};
+           },
+           false)
+    .cast<bool>();
+}
+
+void make_tree(const py::array& array, std::vector<std::size_t> ranks)
+{
+  visit_elements(array, [&]<typename T>(std::span<T> values) {
+    for (std::size_t i{0}; i < ranks.size(); ++i) {
+      if (ranks[i] >= values.size() || (i > 0 && ranks[i - 1] >= ranks[i])) {
+        throw std::invalid_argument{
+          "ranks must be strictly increasing and less than the size"};
+      }
+    }
+    {
+      const py::gil_scoped_release release;
+      check_ordered<T>(values);
+      std::vector<T*> rank_its;
+      for (const auto rank : ranks) {
+        rank_its.push_back(values.data() + rank);
+      }
+      make_order_statistics_tree(values.data(),
+                                 values.data() + values.size(),
+                                 rank_its.begin(),
+                                 rank_its.end());
+    }
+    return py::none{};
+  });
+}
+
+py::object quantiles(const py::array&    array,
+                     std::vector<double> percentiles,
+                     unsigned            threads)
+{
+  return visit_elements(array, [&]<typename T>(std::span<T> values) {
+    if (values.empty()) {
+      throw std::invalid_argument{"no elements"};
+    }
+    py::array_t<T> result(static_cast<py::ssize_t>(percentiles.size()));
+    const auto     out{result.mutable_data()};
+    {
+      const py::gil_scoped_release release;
+      check_ordered<T>(values);
+      work_stealing_pool pool{threads};
+      select_percentiles<T>(values, percentiles, out, pool);
+    }
+    return py::object{std::move(result)};
+  });
+}
+
+py::object grouped_quantiles(const py::array&         array,
+                             std::vector<std::size_t> offsets,
+                             std::vector<double>      percentiles,
+                             unsigned                 threads)
+{
+  return visit_elements(array, [&]<typename T>(std::span<T> values) {
+    if (offsets.empty() || offsets.front() != 0
+        || offsets.back() != values.size()) {
+      throw std::invalid_argument{
+        "offsets must start at 0 and end at the size of the array"};
+    }
+    for (std::size_t i{1}; i < offsets.size(); ++i) {
+      if (offsets[i - 1] >= offsets[i]) {
+        throw std::invalid_argument{"every group needs an element"};
+      }
+    }
+    const auto     groups{offsets.size() - 1};
+    py::array_t<T> result({static_cast<py::ssize_t>(groups),
+                           static_cast<py::ssize_t>(percentiles.size())});
+    const auto     out{result.mutable_data()};
+    {
+      const py::gil_scoped_release release;
+      check_ordered<T>(values);
+      // One task per group, the groups are small compared to the array.
+      work_stealing_pool pool{threads};
+      pool.run([&] {
+        for (std::size_t g{0}; g < groups; ++g) {
+          pool.spawn([&, g] {
+            // The groups are selected in parallel, each one on its own.
+            inline_executor executor;
+            select_percentiles<T>(
+              values.subspan(offsets[g], offsets[g + 1] - offsets[g]),
+              percentiles,
+              out + g * percentiles.size(),
+              executor);
+          });
+        }
+      });
+    }
+    return py::object{std::move(result)};
+  });
+}
+
+}
+
+PYBIND11_MODULE(order_statistics, m)
+{
+  m.doc() = "Min-max heaps and order statistics trees over NumPy arrays, "
+            "built in place.";
+
+  m.def("make_mm_heap",
+        &make_heap,
+        py::arg("values").noconvert(),
+        "Turns values into a min-max heap in place.");
+  m.def("is_mm_heap",
+        &is_heap,
+        py::arg("values").noconvert(),
+        "Returns True if values form a min-max heap.");
+  m.def("make_order_statistics_tree",
+        &make_tree,
+        py::arg("values").noconvert(),
+        py::arg("ranks"),
+        "Turns values into an order statistics tree with the strictly "
+        "increasing ranks in place, values[rank] is then the element of "
+        "that rank.");
+  m.def("quantiles",
+        &quantiles,
+        py::arg("values").noconvert(),
+        py::arg("percentiles"),
+        py::arg("threads") = 0u,
+        "Returns the percentiles in [0, 1] of values, which are reordered "
+        "in place by threads worker threads, 0 for all CPUs.");
+  m.def("grouped_quantiles",
+        &grouped_quantiles,
+        py::arg("values").noconvert(),
+        py::arg("offsets"),
+        py::arg("percentiles"),
+        py::arg("threads") = 0u,
+        "Returns a table of the percentiles in [0, 1] of every group "
+        "values[offsets[i]:offsets[i + 1]], the groups are reordered in "
+        "place in parallel.");
+}
@@ -0,0 +1,85 @@
+"""Tests of the Python extension module order_statistics against NumPy.
+
+Run with the directory of the built module on PYTHONPATH, as CTest does.
+"""
+
+import unittest
+
+import numpy as np
+
+import order_statistics as ost
+
+PERCENTILES = [0.0, 0.01, 0.25, 0.5, 0.5, 0.99, 1.0]
+
+
+def rank_of(p, size):
+    """The rank round(p * (size - 1)) of the percentile p."""
+    return int(p * (size - 1) + 0.5)
+
+
+def expected_quantiles(values, percentiles):
+    """The percentiles of values, selected with numpy.partition."""
+    ranks = [rank_of(p, len(values)) for p in percentiles]
+    return np.partition(values, ranks)[ranks]
+
+
+def random_values(rng, size, dtype):
+    if np.issubdtype(dtype, np.integer):
+        return rng.integers(-1000, 1000, size=size).astype(dtype)
+    return rng.standard_normal(size).astype(dtype)
+
+
+class quantile_tests(unittest.TestCase):
+    def test_quantiles_match_partition(self):
+        rng = np.random.default_rng(7)
+        for dtype in (np.int32, np.int64, np.float32, np.float64):
+            # The largest size is split by the parallel selection.
+            for size in (1, 2, 1000, 200000):
+                values = random_values(rng, size, dtype)
+                original = np.sort(values)
+                expected = expected_quantiles(values, PERCENTILES)
+                result = ost.quantiles(values, PERCENTILES, threads=4)
+                self.assertEqual(result.dtype, values.dtype)
+                np.testing.assert_array_equal(result, expected)
+                # The elements are reordered in place, not changed.
+                np.testing.assert_array_equal(np.sort(values), original)
+                for p, quantile in zip(PERCENTILES, result):
+                    self.assertEqual(values[rank_of(p, size)], quantile)
+
+    def test_grouped_quantiles_match_partition(self):
+        rng = np.random.default_rng(11)
+        sizes = [1, 7, 100, 150000, 3, 5000]
+        offsets = np.concatenate(([0], np.cumsum(sizes))).tolist()
+        for dtype in (np.int64, np.float64):
+            values = random_values(rng, offsets[-1], dtype)
+            groups = [values[offsets[g]:offsets[g + 1]].copy()
+                      for g in range(len(sizes))]
+            table = ost.grouped_quantiles(values, offsets, PERCENTILES,
+                                          threads=3)
+            self.assertEqual(table.shape, (len(sizes), len(PERCENTILES)))
+            for g, group in enumerate(groups):
+                np.testing.assert_array_equal(
+                    table[g], expected_quantiles(group, PERCENTILES))
+                np.testing.assert_array_equal(
+                    np.sort(values[offsets[g]:offsets[g + 1]]),
+                    np.sort(group))
+
+    def test_invalid_input_is_rejected(self):
+        with self.assertRaises(ValueError):
+            ost.quantiles(np.array([1.0, np.nan, 2.0]), [0.5])
+        with self.assertRaises(ValueError):
+            ost.quantiles(np.arange(10.0), [1.5])
+        with self.assertRaises(ValueError):
+            ost.grouped_quantiles(np.arange(10.0), [0, 5, 5, 10], [0.5])
+        read_only = np.arange(10.0)
+        read_only.flags.writeable = False
+        with self.assertRaises(ValueError):
+            ost.quantiles(read_only, [0.5])
+        with self.assertRaises(TypeError):
+            ost.quantiles([3.0, 1.0, 2.0], [0.5])
+        with self.assertRaises(TypeError):
+            ost.quantiles(np.arange(10, dtype=np.int8), [0.5])
+
+
+if __name__ == "__main__":
+    unittest.main()
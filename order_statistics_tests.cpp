@@ -1,11 +1,40 @@
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
 #include <iterator>
+#include <numeric>
+#include <random>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #define BOOST_TEST_MODULE Order Statistics Tests
 #include <boost/test/unit_test.hpp>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 import order_statistics;
+import order_statistics_datasets;
 
 using namespace order_statistics;
 
@@ -84,6 +113,32 @@ BOOST_AUTO_TEST_CASE(is_heap_after_pop_heap)
   BOOST_TEST((h.end() - 1) == std::min_element(h.begin(), h.end()));
 }
 
+BOOST_AUTO_TEST_CASE(is_heap_after_erase_heap)
+{
+  make_mm_heap(h.begin(), h.end());
+  for (auto last{h.end()}; last != h.begin(); --last) {
+    const auto it{h.begin() + (last - h.begin()) / 3};
+    const auto value{*it};
+    erase_mm_heap(h.begin(), it, last);
+
+    BOOST_TEST(*(last - 1) == value);
+    BOOST_TEST(is_mm_heap(h.begin(), last - 1));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(find_finds_every_element)
+{
+  make_mm_heap(h.begin(), h.end());
+
+  for (const auto value : h) {
+    const auto it{find_mm_heap(h.begin(), h.end(), value)};
+    BOOST_TEST((it != h.end() && *it == value));
+  }
+  for (const auto value : {-1, 11, 29, 100}) {
+    BOOST_TEST((find_mm_heap(h.begin(), h.end(), value) == h.end()));
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_FIXTURE_TEST_SUITE(order_statistics_tree_tests,
@@ -109,6 +164,1856 @@ BOOST_AUTO_TEST_CASE(q1_q3_are_in_correct_place)
   BOOST_TEST(*ranks[2] == 39);
 }
 
+BOOST_AUTO_TEST_CASE(ranks_are_kept_after_push)
+{
+  std::vector<int> v(h.begin(), h.begin() + 10);
+  v.reserve(h.size());
+  const std::array<std::vector<int>::iterator, 2> ranks{v.begin() + 3,
+                                                        v.begin() + 6};
+  make_order_statistics_tree(v.begin(), v.end(), ranks.begin(), ranks.end());
+
+  for (auto it{h.begin() + 10}; it != h.end(); ++it) {
+    v.push_back(*it);
+    push_order_statistics_tree(v.begin(), v.end(), ranks.begin(), ranks.end());
+
+    auto sorted{v};
+    std::sort(sorted.begin(), sorted.end());
+    BOOST_TEST(*ranks[0] == sorted[3]);
+    BOOST_TEST(*ranks[1] == sorted[6]);
+    BOOST_TEST(is_mm_heap(ranks[1], v.end()));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ranks_are_kept_after_erase)
+{
+  const std::array<heap_type::iterator, 2> ranks{h.begin() + 3,
+                                                 h.begin() + 6};
+  make_order_statistics_tree(h.begin(), h.end(), ranks.begin(), ranks.end());
+
+  for (auto last{h.end()}; last - h.begin() > 7; --last) {
+    const auto value{*(h.begin() + 5)};
+    erase_order_statistics_tree(
+      h.begin(), h.begin() + 5, last, ranks.begin(), ranks.end());
+    BOOST_TEST(*(last - 1) == value);
+
+    std::vector<int> sorted(h.begin(), last - 1);
+    std::sort(sorted.begin(), sorted.end());
+    BOOST_TEST(*ranks[0] == sorted[3]);
+    BOOST_TEST(*ranks[1] == sorted[6]);
+    BOOST_TEST(is_mm_heap(ranks[1], last - 1));
+  }
+
+  // Equal ranks leave empty segments.
+  std::mt19937     rng{31};
+  std::vector<int> v(60);
+  for (auto& e : v) {
+    e = static_cast<int>(rng() % 40);
+  }
+  const std::array<std::vector<int>::iterator, 5> equal_ranks{v.begin() + 4,
+                                                              v.begin() + 4,
+                                                              v.begin() + 11,
+                                                              v.begin() + 11,
+                                                              v.begin() + 19};
+  make_order_statistics_tree(
+    v.begin(), v.end(), equal_ranks.begin(), equal_ranks.end());
+  for (auto last{v.end()}; last - v.begin() > 20; --last) {
+    const auto size{static_cast<std::size_t>(last - v.begin())};
+    const auto it{v.begin() + static_cast<std::ptrdiff_t>(rng() % size)};
+    erase_order_statistics_tree(
+      v.begin(), it, last, equal_ranks.begin(), equal_ranks.end());
+    BOOST_TEST(is_order_statistics_tree(
+      v.begin(), last - 1, equal_ranks.begin(), equal_ranks.end()));
+    std::vector<int> sorted(v.begin(), last - 1);
+    std::sort(sorted.begin(), sorted.end());
+    for (const auto rank : equal_ranks) {
+      BOOST_TEST(*rank == sorted[static_cast<std::size_t>(rank - v.begin())]);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ranks_are_kept_after_update)
+{
+  const std::array<heap_type::iterator, 2> ranks{h.begin() + 3,
+                                                 h.begin() + 6};
+  make_order_statistics_tree(h.begin(), h.end(), ranks.begin(), ranks.end());
+
+  for (const auto& [i, value] : {std::pair{0, 100},
+                                 std::pair{3, -100},
+                                 std::pair{5, 50},
+                                 std::pair{6, 0},
+                                 std::pair{9, 7}}) {
+    *(h.begin() + i) = value;
+    update_order_statistics_tree(
+      h.begin(), h.begin() + i, h.end(), ranks.begin(), ranks.end());
+
+    std::vector<int> sorted(h.begin(), h.end());
+    std::sort(sorted.begin(), sorted.end());
+    BOOST_TEST(*ranks[0] == sorted[3]);
+    BOOST_TEST(*ranks[1] == sorted[6]);
+    BOOST_TEST(is_mm_heap(ranks[1], h.end()));
+  }
+
+  // Equal ranks leave empty segments.
+  std::mt19937     rng{37};
+  std::vector<int> v(60);
+  for (auto& e : v) {
+    e = static_cast<int>(rng() % 40);
+  }
+  const std::array<std::vector<int>::iterator, 5> equal_ranks{v.begin() + 4,
+                                                              v.begin() + 4,
+                                                              v.begin() + 11,
+                                                              v.begin() + 11,
+                                                              v.begin() + 19};
+  make_order_statistics_tree(
+    v.begin(), v.end(), equal_ranks.begin(), equal_ranks.end());
+  for (std::size_t n{0}; n < 500; ++n) {
+    const auto it{v.begin() + static_cast<std::ptrdiff_t>(rng() % v.size())};
+    *it = static_cast<int>(rng() % 40);
+    update_order_statistics_tree(
+      v.begin(), it, v.end(), equal_ranks.begin(), equal_ranks.end());
+    BOOST_TEST(is_order_statistics_tree(
+      v.begin(), v.end(), equal_ranks.begin(), equal_ranks.end()));
+    auto sorted{v};
+    std::sort(sorted.begin(), sorted.end());
+    for (const auto rank : equal_ranks) {
+      BOOST_TEST(*rank == sorted[static_cast<std::size_t>(rank - v.begin())]);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(string_key_tests)
+
+BOOST_AUTO_TEST_CASE(prefix_order_matches_string_order)
+{
+  const std::vector<std::string> s{"",
+                                   "a",
+                                   "ab",
+                                   "abcdefgh",
+                                   "abcdefghi",
+                                   "abcdefgh\x01",
+                                   "abcdefgi",
+                                   "b",
+                                   "\xff"};
+
+  for (const auto& lhs : s) {
+    for (const auto& rhs : s) {
+      const prefixed_string plhs{lhs};
+      const prefixed_string prhs{rhs};
+      BOOST_TEST(prefix_less{}(plhs, prhs) == (lhs < rhs));
+      BOOST_TEST((plhs < prhs) == (lhs < rhs));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(median_of_prefixed_strings)
+{
+  std::vector<prefixed_string> v;
+  for (const auto* s : {"delta_0001", "alpha_0002", "delta_0000", "charlie",
+                        "bravo", "delta_0002", "echo"}) {
+    v.emplace_back(s);
+  }
+  make_mm_heap(v.begin(), v.end(), prefix_less{});
+  BOOST_TEST(is_mm_heap(v.begin(), v.end(), prefix_less{}));
+  BOOST_TEST(v.front().value == "alpha_0002");
+
+  std::array<std::vector<prefixed_string>::iterator, 1> ranks{v.begin() + 3};
+  make_order_statistics_tree(
+    v.begin(), v.end(), ranks.begin(), ranks.end(), prefix_less{});
+  BOOST_TEST(ranks[0]->value == "delta_0000");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE(packed_key_tests, order_statistics_tree_fixture)
+
+BOOST_AUTO_TEST_CASE(round_trip)
+{
+  for (const auto key : {-3.5f, -0.0f, 0.0f, 1e-30f, 2.25f, 1e30f}) {
+    const packed_element<float> p{key, 42};
+    BOOST_TEST(p.key() == key);
+    BOOST_TEST(p.payload() == 42u);
+  }
+  for (const auto key : {INT32_MIN, -1, 0, 1, INT32_MAX}) {
+    const packed_element<std::int32_t> p{key, 0xffffffffu};
+    BOOST_TEST(p.key() == key);
+    BOOST_TEST(p.payload() == 0xffffffffu);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(order_matches_key_order)
+{
+  std::vector<packed_element<float>> v;
+  for (const auto& e : h) {
+    v.emplace_back(static_cast<float>(e) - 40.5f,
+                   static_cast<std::uint32_t>(v.size()));
+  }
+
+  make_mm_heap(v.begin(), v.end());
+  BOOST_TEST(is_mm_heap(v.begin(), v.end()));
+  BOOST_TEST(v.front().key() == -35.5f);
+  BOOST_TEST(v.front().payload() == 16u);
+
+  std::array<std::vector<packed_element<float>>::iterator, 1> ranks{
+    v.begin() + v.size() / 2};
+  make_order_statistics_tree(v.begin(), v.end(), ranks.begin(), ranks.end());
+  BOOST_TEST(ranks[0]->key() == -10.5f);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE(soa_tests, order_statistics_tree_fixture)
+
+BOOST_AUTO_TEST_CASE(heap_moves_payloads)
+{
+  std::vector<std::string> payloads;
+  for (const auto& e : h) {
+    payloads.push_back(std::to_string(e));
+  }
+  const auto first{make_zip_iterator(h.begin(), payloads.begin())};
+  const auto last{make_zip_iterator(h.end(), payloads.end())};
+
+  make_mm_heap(first, last, by_key{std::less<>{}});
+  BOOST_TEST(is_mm_heap(h.begin(), h.end()));
+  for (std::size_t i{0}; i < h.size(); ++i) {
+    BOOST_TEST(payloads[i] == std::to_string(h[i]));
+  }
+
+  std::array<decltype(first), 3> ranks{
+    first + h.size() / 4, first + h.size() / 2, first + h.size() * 3 / 4};
+  make_order_statistics_tree(
+    first, last, ranks.begin(), ranks.end(), by_key{std::less<>{}});
+  BOOST_TEST((*ranks[0]).key == 15);
+  BOOST_TEST((*ranks[1]).payload == "30");
+  BOOST_TEST((*ranks[2]).key == 39);
+  for (std::size_t i{0}; i < h.size(); ++i) {
+    BOOST_TEST(payloads[i] == std::to_string(h[i]));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(deferred_payload_permutation)
+{
+  std::vector<std::string> payloads;
+  for (const auto& e : h) {
+    payloads.push_back(std::to_string(e));
+  }
+  std::vector<std::uint32_t> indices(h.size());
+  std::iota(indices.begin(), indices.end(), 0u);
+
+  make_mm_heap(make_zip_iterator(h.begin(), indices.begin()),
+               make_zip_iterator(h.end(), indices.end()),
+               by_key{std::less<>{}});
+  apply_permutation(payloads.begin(), payloads.end(), indices.begin());
+
+  BOOST_TEST(is_mm_heap(h.begin(), h.end()));
+  for (std::size_t i{0}; i < h.size(); ++i) {
+    BOOST_TEST(payloads[i] == std::to_string(h[i]));
+    BOOST_TEST(indices[i] == i);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+struct memory_run_sink {
+  std::vector<std::vector<int>> runs;
+  std::vector<int>              low;
+  std::vector<int>              high;
+
+  void push_low(int value)
+  {
+    low.push_back(value);
+  }
+
+  void push_high(int value)
+  {
+    high.push_back(value);
+  }
+
+  void finish_run()
+  {
+    low.insert(low.end(), high.rbegin(), high.rend());
+    runs.push_back(std::move(low));
+    low.clear();
+    high.clear();
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(replacement_selection_tests,
+                         order_statistics_tree_fixture)
+
+BOOST_AUTO_TEST_CASE(runs_are_sorted)
+{
+  memory_run_sink            sink;
+  replacement_selection<int> selection{4};
+  for (const auto& e : h) {
+    selection.push(e, sink);
+  }
+  selection.flush(sink);
+
+  std::vector<int> all;
+  for (const auto& run : sink.runs) {
+    BOOST_TEST(std::is_sorted(run.begin(), run.end()));
+    all.insert(all.end(), run.begin(), run.end());
+  }
+  std::sort(all.begin(), all.end());
+  std::sort(h.begin(), h.end());
+  BOOST_TEST(std::equal(all.begin(), all.end(), h.begin(), h.end()));
+}
+
+BOOST_AUTO_TEST_CASE(monotonic_input_is_a_single_run)
+{
+  for (const auto descending : {false, true}) {
+    memory_run_sink            sink;
+    replacement_selection<int> selection{4};
+    for (auto i{0}; i < 100; ++i) {
+      selection.push(descending ? -i : i, sink);
+    }
+    selection.flush(sink);
+
+    BOOST_REQUIRE(sink.runs.size() == 1u);
+    BOOST_TEST(sink.runs[0].size() == 100u);
+    BOOST_TEST(std::is_sorted(sink.runs[0].begin(), sink.runs[0].end()));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(runs_are_written_to_files)
+{
+  const auto directory{std::filesystem::temp_directory_path()
+                       / "order_statistics_tests_runs"};
+  std::filesystem::create_directories(directory);
+
+  auto* input{std::tmpfile()};
+  BOOST_REQUIRE(input);
+  std::vector<std::int32_t> values(1000);
+  for (std::size_t i{0}; i < values.size(); ++i) {
+    values[i] = static_cast<std::int32_t>(i * 7919 % 1000);
+  }
+  std::fwrite(values.data(), sizeof(std::int32_t), values.size(), input);
+  std::rewind(input);
+
+  const auto runs{generate_runs<std::int32_t>(input, 64, directory)};
+  std::rewind(input);
+  const auto other_runs{generate_runs<std::int32_t>(input, 64, directory)};
+  std::fclose(input);
+
+  // Every sink writes to a directory of its own.
+  BOOST_REQUIRE(!runs.empty());
+  BOOST_REQUIRE(runs.size() == other_runs.size());
+  BOOST_TEST(runs[0].path.parent_path().parent_path() == directory);
+  BOOST_TEST(runs[0].path.parent_path() != other_runs[0].path.parent_path());
+
+  std::uintmax_t total{0};
+  for (const auto& run : runs) {
+    std::vector<std::int32_t> r(run.size);
+    std::ifstream             file{run.path, std::ios::binary};
+    file.read(reinterpret_cast<char*>(r.data()),
+              static_cast<std::streamsize>(r.size() * sizeof(std::int32_t)));
+    BOOST_TEST(file.good());
+    BOOST_TEST(std::is_sorted(r.begin(), r.end()));
+    total += run.size;
+  }
+  BOOST_TEST(total == values.size());
+
+  std::filesystem::remove_all(directory);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE(bounded_priority_queue_tests,
+                         order_statistics_tree_fixture)
+
+BOOST_AUTO_TEST_CASE(keeps_greatest_elements)
+{
+  bounded_priority_queue<int> q{8};
+  std::vector<int>            evicted;
+  for (const auto& e : h) {
+    q.try_admit(e, [&evicted](int&& x) {
+      evicted.push_back(x);
+    });
+    BOOST_TEST(q.size() <= q.capacity());
+  }
+
+  std::sort(h.begin(), h.end(), std::greater<>{});
+  BOOST_TEST(q.full());
+  BOOST_TEST(q.bottom() == h[7]);
+  for (std::size_t i{0}; i < 8; ++i) {
+    BOOST_TEST(q.top() == h[i]);
+    q.pop();
+  }
+  BOOST_TEST(q.empty());
+  for (const auto& e : evicted) {
+    BOOST_TEST(e <= h[7]);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(counts_admissions)
+{
+  bounded_priority_queue<int> q{2};
+  BOOST_TEST((q.try_admit(5) == admission::admitted));
+  BOOST_TEST((q.try_admit(3) == admission::admitted));
+  BOOST_TEST((q.try_admit(3) == admission::rejected));
+  BOOST_TEST((q.try_admit(1) == admission::rejected));
+  BOOST_TEST((q.try_admit(7) == admission::evicted));
+  BOOST_TEST(q.bottom() == 5);
+  BOOST_TEST(q.top() == 7);
+
+  BOOST_TEST(q.statistics().admitted == 2u);
+  BOOST_TEST(q.statistics().evicted == 1u);
+  BOOST_TEST(q.statistics().rejected == 2u);
+  q.reset_statistics();
+  BOOST_TEST(q.statistics().rejected == 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+template<typename Pixel>
+std::vector<Pixel> percentile_filter_reference(const std::vector<Pixel>& input,
+                                               std::size_t width,
+                                               std::size_t radius_x,
+                                               std::size_t radius_y,
+                                               double      percentile)
+{
+  const auto         height{input.size() / width};
+  std::vector<Pixel> output(input.size());
+  std::vector<Pixel> window;
+  for (std::size_t y{0}; y < height; ++y) {
+    for (std::size_t x{0}; x < width; ++x) {
+      window.clear();
+      for (auto j{static_cast<std::ptrdiff_t>(y - radius_y)};
+           j <= static_cast<std::ptrdiff_t>(y + radius_y);
+           ++j) {
+        for (auto i{static_cast<std::ptrdiff_t>(x - radius_x)};
+             i <= static_cast<std::ptrdiff_t>(x + radius_x);
+             ++i) {
+          const auto yy{std::clamp<std::ptrdiff_t>(j, 0, height - 1)};
+          const auto xx{std::clamp<std::ptrdiff_t>(i, 0, width - 1)};
+          window.push_back(input[yy * width + xx]);
+        }
+      }
+      const auto k{static_cast<std::size_t>(
+        percentile * static_cast<double>(window.size() - 1) + 0.5)};
+      std::nth_element(window.begin(), window.begin() + k, window.end());
+      output[y * width + x] = window[k];
+    }
+  }
+  return output;
+}
+
+BOOST_AUTO_TEST_SUITE(filter_tests)
+
+BOOST_AUTO_TEST_CASE(percentile_filter_matches_nth_element)
+{
+  std::mt19937 rng{7};
+
+  std::vector<std::uint8_t> image(37 * 23);
+  for (auto& p : image) {
+    p = static_cast<std::uint8_t>(rng() % 16);
+  }
+  for (const auto percentile : {0.0, 0.25, 0.5, 1.0}) {
+    for (const auto threads : {1u, 3u}) {
+      std::vector<std::uint8_t> output(image.size());
+      percentile_filter<std::uint8_t>(
+        image, output, 37, 3, 2, percentile, threads);
+      BOOST_TEST((output
+                  == percentile_filter_reference(image, 37, 3, 2, percentile)));
+    }
+  }
+
+  std::vector<float> fimage(41 * 17);
+  for (auto& p : fimage) {
+    p = static_cast<float>(rng() % 1000) - 500.0f;
+  }
+  std::vector<float> foutput(fimage.size());
+  median_filter<float>(fimage, foutput, 41, 4, 2);
+  BOOST_TEST((foutput == percentile_filter_reference(fimage, 41, 4, 4, 0.5)));
+}
+
+BOOST_AUTO_TEST_CASE(median_filter_of_signal)
+{
+  const std::vector<std::uint16_t> signal{1, 9, 2, 8, 3, 7, 4, 6, 5};
+  std::vector<std::uint16_t>       output(signal.size());
+  percentile_filter<std::uint16_t>(signal, output, signal.size(), 1, 0, 0.5);
+
+  const std::vector<std::uint16_t> expected{1, 2, 8, 3, 7, 4, 6, 5, 5};
+  BOOST_TEST((output == expected));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(rolling_quantile_tests)
+
+BOOST_AUTO_TEST_CASE(quantiles_match_nth_element)
+{
+  constexpr std::size_t         streams{5};
+  constexpr std::size_t         window{20};
+  const std::array<double, 4>   percentiles{0.5, 0.95, 0.0, 1.0};
+  rolling_quantiles<std::int32_t> q{streams, window, percentiles};
+  std::vector<std::vector<std::int32_t>> history(streams);
+  std::mt19937                           rng{11};
+
+  for (std::size_t n{0}; n < 500; ++n) {
+    const auto stream{rng() % streams};
+    const auto value{static_cast<std::int32_t>(rng() % 50) - 25};
+    q.push(stream, value);
+    history[stream].push_back(value);
+
+    const auto& h{history[stream]};
+    std::vector<std::int32_t> w(
+      h.end() - static_cast<std::ptrdiff_t>(std::min(h.size(), window)),
+      h.end());
+    BOOST_TEST(q.size(stream) == w.size());
+    for (std::size_t i{0}; i < percentiles.size(); ++i) {
+      const auto k{static_cast<std::size_t>(
+        percentiles[i] * static_cast<double>(w.size() - 1) + 0.5)};
+      std::nth_element(w.begin(), w.begin() + k, w.end());
+      BOOST_TEST(q.quantile(stream, i) == w[k]);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(batch_matches_single_updates)
+{
+  const std::array<double, 2> percentiles{0.5, 0.9};
+  rolling_quantiles<float>    single{100, 16, percentiles};
+  rolling_quantiles<float>    batched{100, 16, percentiles};
+  std::vector<std::uint32_t>  streams(5000);
+  std::vector<float>          values(streams.size());
+  std::mt19937                rng{13};
+
+  for (std::size_t i{0}; i < streams.size(); ++i) {
+    streams[i] = static_cast<std::uint32_t>(rng() % 100);
+    values[i]  = static_cast<float>(rng() % 1000) / 8.0f;
+    single.push(streams[i], values[i]);
+  }
+  batched.push(streams, values);
+
+  for (std::size_t s{0}; s < 100; ++s) {
+    for (std::size_t i{0}; i < percentiles.size(); ++i) {
+      BOOST_TEST(batched.quantile(s, i) == single.quantile(s, i));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(running_median_tests)
+
+BOOST_AUTO_TEST_CASE(median_and_neighbours_match_sorted)
+{
+  running_median<int> m;
+  std::vector<int>    elements;
+  std::mt19937        rng{17};
+
+  for (std::size_t n{0}; n < 2000; ++n) {
+    const auto value{static_cast<int>(rng() % 40)};
+    if (!elements.empty() && rng() % 3 == 0) {
+      const auto out{elements[rng() % elements.size()]};
+      BOOST_TEST(m.slide(out, value));
+      elements.erase(std::find(elements.begin(), elements.end(), out));
+      elements.push_back(value);
+    }
+    else if (!elements.empty() && rng() % 3 == 0) {
+      const auto out{elements[rng() % elements.size()]};
+      BOOST_TEST(m.erase(out));
+      elements.erase(std::find(elements.begin(), elements.end(), out));
+    }
+    else {
+      m.insert(value);
+      elements.push_back(value);
+    }
+
+    std::vector<int> sorted(elements);
+    std::sort(sorted.begin(), sorted.end());
+    const auto k{sorted.size() / 2};
+    BOOST_TEST(m.size() == sorted.size());
+    BOOST_TEST(m.empty() == sorted.empty());
+    if (!sorted.empty()) {
+      BOOST_TEST(m.median() == sorted[k]);
+      BOOST_TEST(m.has_predecessor() == (k > 0));
+      if (k > 0) {
+        BOOST_TEST(m.predecessor() == sorted[k - 1]);
+      }
+      BOOST_TEST(m.has_successor() == (k + 1 < sorted.size()));
+      if (k + 1 < sorted.size()) {
+        BOOST_TEST(m.successor() == sorted[k + 1]);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(erase_of_missing_value_fails)
+{
+  running_median<int> m;
+  for (const auto value : {5, 1, 9, 3}) {
+    m.insert(value);
+  }
+  BOOST_TEST(!m.erase(4));
+  BOOST_TEST(!m.slide(7, 2));
+  BOOST_TEST(m.size() == 4u);
+  BOOST_TEST(m.median() == 5);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(heap_batch_tests)
+
+BOOST_AUTO_TEST_CASE(batch_matches_single_operations)
+{
+  using iterator = std::vector<int>::iterator;
+
+  constexpr std::size_t heaps{50};
+  constexpr std::size_t capacity{40};
+  std::vector<int>         batched(heaps * capacity);
+  std::vector<int>         single(batched.size());
+  std::vector<std::size_t> sizes(heaps);
+  std::mt19937             rng{19};
+
+  for (std::size_t round{0}; round < 100; ++round) {
+    std::vector<heap_task<iterator>> tasks;
+    for (std::size_t h{0}; h < heaps; ++h) {
+      const auto first{static_cast<std::ptrdiff_t>(h * capacity)};
+      auto       operation{static_cast<heap_operation>(rng() % 3)};
+      if (sizes[h] == 0) {
+        operation = heap_operation::push;
+      }
+      else if (sizes[h] == capacity) {
+        operation = heap_operation::pop;
+      }
+
+      if (operation == heap_operation::push) {
+        const auto value{static_cast<int>(rng() % 100)};
+        batched[h * capacity + sizes[h]] = value;
+        single[h * capacity + sizes[h]]  = value;
+        ++sizes[h];
+      }
+      const auto last{first + static_cast<std::ptrdiff_t>(sizes[h])};
+      tasks.push_back(
+        {batched.begin() + first, batched.begin() + last, operation});
+
+      switch (operation) {
+      case heap_operation::push:
+        push_mm_heap(single.begin() + first, single.begin() + last);
+        break;
+      case heap_operation::pop:
+        pop_mm_heap(single.begin() + first, single.begin() + last);
+        --sizes[h];
+        break;
+      case heap_operation::pop_max:
+        pop_max_mm_heap(single.begin() + first, single.begin() + last);
+        --sizes[h];
+        break;
+      }
+    }
+    batch_mm_heap(std::span<const heap_task<iterator>>{tasks});
+    BOOST_TEST((batched == single));
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(container_tests)
+
+/// @brief Checks that @p tree holds the elements @p expected with the right
+/// elements at its ranks.
+void check_tree(const order_statistics_tree<int>& tree,
+                std::vector<int>                  expected)
+{
+  std::sort(expected.begin(), expected.end());
+  std::vector<int> elements(tree.elements().begin(), tree.elements().end());
+  std::sort(elements.begin(), elements.end());
+  BOOST_TEST((elements == expected));
+  for (std::size_t i{0}; i < tree.ranks().size(); ++i) {
+    BOOST_TEST(tree.at_rank(i) == expected[tree.ranks()[i]]);
+  }
+  BOOST_TEST(tree.min() == expected.front());
+  BOOST_TEST(tree.max() == expected.back());
+}
+
+BOOST_AUTO_TEST_CASE(tree_keeps_ranks)
+{
+  std::mt19937     rng{23};
+  std::vector<int> elements(50);
+  for (auto& e : elements) {
+    e = static_cast<int>(rng() % 30);
+  }
+  order_statistics_tree<int> tree{elements, {0, 12, 25, 37}};
+  check_tree(tree, elements);
+
+  for (std::size_t n{0}; n < 200; ++n) {
+    if (rng() % 2 == 0 && tree.size() > 39) {
+      const auto position{rng() % tree.size()};
+      elements.erase(std::find(
+        elements.begin(), elements.end(), tree.elements()[position]));
+      tree.erase(position);
+    }
+    else {
+      const auto value{static_cast<int>(rng() % 30)};
+      elements.push_back(value);
+      tree.push(value);
+    }
+    check_tree(tree, elements);
+  }
+
+  std::vector<int> batch(100);
+  for (auto& e : batch) {
+    e = static_cast<int>(rng() % 30);
+  }
+  elements.insert(elements.end(), batch.begin(), batch.end());
+  tree.insert(batch);
+  check_tree(tree, elements);
+
+  BOOST_CHECK_THROW((order_statistics_tree<int>{{1, 2, 3}, {2, 1}}),
+                    std::invalid_argument);
+  order_statistics_tree<int> small{{1, 2, 3}, {1}};
+  small.pop_min();
+  BOOST_CHECK_THROW(small.pop_min(), std::length_error);
+}
+
+BOOST_AUTO_TEST_CASE(incremental_build_matches_tree)
+{
+  std::mt19937 rng{29};
+  for (const std::size_t size : {0, 1, 17, 1000}) {
+    std::vector<int> elements(size);
+    for (auto& e : elements) {
+      e = static_cast<int>(rng() % 100);
+    }
+    std::vector<std::size_t> ranks;
+    for (const auto rank : {size / 4, size / 2, size * 3 / 4}) {
+      if (rank < size && (ranks.empty() || ranks.back() < rank)) {
+        ranks.push_back(rank);
+      }
+    }
+
+    incremental_tree_build<int> build{elements, ranks};
+    BOOST_CHECK_THROW(build.result(), std::logic_error);
+    std::size_t resumes{0};
+    while (!build.step(7)) {
+      ++resumes;
+    }
+    BOOST_TEST((size < 100 || resumes > 100));
+    if (size > 0) {
+      check_tree(build.result(), elements);
+    }
+  }
+
+  incremental_tree_build<int> build{std::vector<int>(100000, 1), {50000}};
+  while (!build.resume(std::chrono::microseconds{100})) {
+  }
+  BOOST_TEST(build.result().at_rank(0) == 1);
+}
+
+/// @brief Returns an input on which the selection of the median by an
+/// incremental_tree_build makes as many steps as McIlroy's adversary can
+/// force, see order_statistics_datasets.
+std::vector<int> incremental_build_killer(std::size_t size)
+{
+  const auto               gas{size};
+  std::vector<std::size_t> values(size, gas);
+  std::size_t              frozen{0};
+  std::size_t              candidate{0};
+  const auto               adversary{[&](std::size_t x, std::size_t y) {
+    if (values[x] == gas && values[y] == gas) {
+      values[x == candidate ? x : y] = frozen++;
+    }
+    if (values[x] == gas) {
+      candidate = x;
+    }
+    else if (values[y] == gas) {
+      candidate = y;
+    }
+    return values[x] < values[y];
+  }};
+
+  std::vector<std::size_t> elements(size);
+  std::iota(elements.begin(), elements.end(), std::size_t{0});
+  incremental_tree_build<std::size_t, decltype(std::cref(adversary))> build{
+    elements, {size / 2}, std::cref(adversary)};
+  while (!build.step(4096)) {
+  }
+  for (auto& v : values) {
+    if (v == gas) {
+      v = frozen++;
+    }
+  }
+  return {values.begin(), values.end()};
+}
+
+BOOST_AUTO_TEST_CASE(incremental_build_of_adversarial_inputs)
+{
+  // Inputs that make a plain quickselect quadratic take O(n log n) steps.
+  using namespace order_statistics::datasets;
+  constexpr std::size_t         size{1 << 14};
+  std::vector<std::vector<int>> inputs{incremental_build_killer(size)};
+  for (const auto d : {distribution::nth_element_killer,
+                       distribution::organ_pipe,
+                       distribution::sawtooth}) {
+    inputs.push_back(generate<int>(d, size));
+  }
+  for (const auto& elements : inputs) {
+    incremental_tree_build<int> build{elements, {size / 2, size * 9 / 10}};
+    std::size_t                 steps{0};
+    while (!build.step(1)) {
+      ++steps;
+    }
+    BOOST_TEST_MESSAGE(steps << " steps");
+    BOOST_TEST(steps < 100 * size);
+    check_tree(build.result(), elements);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(percentiles_map_to_ranks)
+{
+  BOOST_TEST(percentile_rank(0.5, 0) == 0u);
+  BOOST_TEST(percentile_rank(0.5, 100) == 50u);
+  BOOST_TEST(percentile_rank(0.99, 100) == 98u);
+  BOOST_TEST(percentile_rank(1.0, 100) == 99u);
+
+  const std::vector<double> percentiles{0.99, 0.5, 1.0, 0.5, 0.0};
+  const auto                all{make_percentile_ranks(percentiles, 100)};
+  BOOST_TEST((all.ranks == std::vector<std::size_t>{0, 50, 98, 99}));
+  BOOST_TEST((all.index == std::vector<std::size_t>{2, 1, 3, 1, 0}));
+
+  const auto without{make_percentile_ranks(percentiles, 100, false)};
+  BOOST_TEST((without.ranks == std::vector<std::size_t>{0, 50, 98}));
+  BOOST_TEST(without.index[2] == percentile_ranks::greatest);
+
+  const std::vector<double> invalid{0.5, 1.5};
+  BOOST_CHECK_THROW(make_percentile_ranks(invalid, 100),
+                    std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_reloads_tree)
+{
+  const auto path{std::filesystem::temp_directory_path()
+                  / "order_statistics_tests_snapshot.bin"};
+  std::vector<int> elements(10000);
+  std::mt19937     rng{73};
+  for (auto& e : elements) {
+    e = static_cast<int>(rng() % 1000);
+  }
+  const order_statistics_tree<int> tree{elements, {10, 5000, 9990}};
+  save_snapshot(path, tree);
+
+  const order_statistics_snapshot<int> snapshot{path};
+  BOOST_TEST(std::equal(tree.elements().begin(),
+                        tree.elements().end(),
+                        snapshot.elements().begin(),
+                        snapshot.elements().end()));
+  BOOST_TEST(snapshot.at_rank(1) == tree.at_rank(1));
+  BOOST_TEST(snapshot.max() == tree.max());
+  auto reloaded{snapshot.to_tree()};
+  reloaded.push(-1);
+  elements.push_back(-1);
+  check_tree(reloaded, elements);
+
+  BOOST_CHECK_THROW(order_statistics_snapshot<unsigned short>{path},
+                    std::runtime_error);
+  BOOST_CHECK_THROW((order_statistics_snapshot<int, std::greater<>>{path}),
+                    std::runtime_error);
+
+  const auto size{std::filesystem::file_size(path)};
+  {
+    std::fstream file{path, std::ios::binary | std::ios::in | std::ios::out};
+    file.seekp(static_cast<std::streamoff>(size - 1));
+    file.put('\x7f');
+  }
+  BOOST_CHECK_THROW(order_statistics_snapshot<int>{path}, std::runtime_error);
+  std::filesystem::resize_file(path, size - 4);
+  BOOST_CHECK_THROW(order_statistics_snapshot<int>{path}, std::runtime_error);
+  std::filesystem::remove(path);
+
+  // Elements that are no tree are not adopted.
+  BOOST_CHECK_THROW(order_statistics_tree<int>::adopt({3, 1, 2}, {}),
+                    std::invalid_argument);
+  BOOST_CHECK_THROW(order_statistics_tree<int>::adopt({1, 5, 4, 2}, {2}),
+                    std::invalid_argument);
+  BOOST_TEST(order_statistics_tree<int>::adopt({1, 2, 3, 4}, {2}).max() == 4);
+}
+
+BOOST_AUTO_TEST_CASE(minmax_priority_queue_pops_both_ends)
+{
+  std::mt19937     rng{29};
+  std::vector<int> elements(300);
+  for (auto& e : elements) {
+    e = static_cast<int>(rng() % 100);
+  }
+  minmax_priority_queue<int> queue{{elements.begin(), elements.begin() + 100}};
+  for (auto it{elements.begin() + 100}; it != elements.end(); ++it) {
+    queue.push(*it);
+  }
+  std::sort(elements.begin(), elements.end());
+
+  auto low{elements.begin()};
+  auto high{elements.end()};
+  while (!queue.empty()) {
+    BOOST_TEST(queue.min() == *low);
+    BOOST_TEST(queue.max() == *(high - 1));
+    if (rng() % 2 == 0) {
+      queue.pop_min();
+      ++low;
+    }
+    else {
+      queue.pop_max();
+      --high;
+    }
+    BOOST_TEST(queue.size() == static_cast<std::size_t>(high - low));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(operations_record_latencies)
+{
+  // A quantile is the upper bound of a bucket at most 1/16 above it.
+  latency_histogram histogram;
+  for (std::uint64_t ticks{1}; ticks <= 100000; ++ticks) {
+    histogram.record(ticks);
+  }
+  BOOST_TEST(histogram.count() == 100000u);
+  for (const auto p : {0.0, 0.5, 0.9, 0.99, 1.0}) {
+    const auto exact{1.0 + p * 99999.0};
+    const auto ticks{histogram.quantile(p) / nanoseconds_per_tick()};
+    BOOST_TEST(ticks >= exact - 1.0);
+    BOOST_TEST(ticks <= exact * 17.0 / 16.0 + 1.0);
+  }
+  BOOST_CHECK_THROW(histogram.quantile(1.5), std::invalid_argument);
+  histogram.reset();
+  BOOST_TEST(histogram.count() == 0u);
+  BOOST_TEST(histogram.quantile(0.99) == 0.0);
+
+  // The containers count every operation, or none if they do not record.
+  const std::uint64_t        recorded{record_latencies ? 1u : 0u};
+  minmax_priority_queue<int> queue;
+  for (int i{0}; i < 10; ++i) {
+    queue.push(i);
+  }
+  queue.pop_min();
+  queue.pop_max();
+  queue.pop_max();
+  BOOST_TEST(queue.latencies(queue_operation::push).count() == 10 * recorded);
+  BOOST_TEST(queue.latencies(queue_operation::pop_min).count() == recorded);
+  BOOST_TEST(queue.latencies(queue_operation::pop_max).count()
+             == 2 * recorded);
+  queue.reset_latencies();
+  BOOST_TEST(queue.latencies(queue_operation::push).count() == 0u);
+
+  order_statistics_tree<int> tree{{5, 3, 1, 4, 2}, {2}};
+  tree.push(0);
+  tree.insert(std::vector<int>{7, 6});
+  tree.pop_min();
+  BOOST_TEST(tree.latencies(tree_operation::push).count() == recorded);
+  BOOST_TEST(tree.latencies(tree_operation::insert).count() == recorded);
+  BOOST_TEST(tree.latencies(tree_operation::erase).count() == recorded);
+  tree.reset_latencies();
+  BOOST_TEST(tree.latencies(tree_operation::erase).count() == 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(double_buffering_tests)
+
+/// @brief Returns the percentile @p p of @p elements.
+int percentile_of(std::vector<int> elements, double p)
+{
+  const auto rank{static_cast<std::size_t>(
+    p * static_cast<double>(elements.size() - 1) + 0.5)};
+  std::nth_element(elements.begin(),
+                   elements.begin() + static_cast<std::ptrdiff_t>(rank),
+                   elements.end());
+  return elements[rank];
+}
+
+BOOST_AUTO_TEST_CASE(rebuild_updates_ranks)
+{
+  const std::vector<double>  percentiles{0.0, 0.5, 0.9, 1.0};
+  double_buffered_tree<int> tree{percentiles};
+  BOOST_CHECK_THROW(tree.quantile(0), std::length_error);
+  BOOST_CHECK_THROW(double_buffered_tree<int>{{1.5}}, std::invalid_argument);
+
+  std::mt19937     rng{31};
+  std::vector<int> elements;
+  for (const auto size : {1, 2, 1000, 1500}) {
+    while (elements.size() < static_cast<std::size_t>(size)) {
+      elements.push_back(static_cast<int>(rng() % 500));
+      tree.push(elements.back());
+    }
+    BOOST_TEST(tree.rebuild());
+    tree.wait();
+    BOOST_TEST(!tree.is_rebuilding());
+    BOOST_TEST(tree.size() == elements.size());
+    for (std::size_t i{0}; i < percentiles.size(); ++i) {
+      BOOST_TEST(tree.quantile(i) == percentile_of(elements, percentiles[i]));
+    }
+  }
+
+  // Until the next rebuild the ranks are those of 1500 elements.
+  const auto rank{static_cast<std::size_t>(0.5 * 1499 + 0.5)};
+  for (std::size_t i{0}; i < 100; ++i) {
+    elements.push_back(static_cast<int>(rng() % 500));
+    tree.push(elements.back());
+  }
+  auto sorted{elements};
+  std::sort(sorted.begin(), sorted.end());
+  BOOST_TEST(tree.quantile(1) == sorted[rank]);
+  BOOST_TEST(tree.quantile(3) == sorted.back());
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_pushes_are_kept)
+{
+  const std::vector<double>  percentiles{0.01, 0.5, 0.99};
+  double_buffered_tree<int> tree{percentiles};
+
+  std::vector<int> elements(200000);
+  std::mt19937     rng{37};
+  for (auto& e : elements) {
+    e = static_cast<int>(rng() % 100000);
+  }
+
+  std::size_t rebuilds{0};
+  {
+    std::jthread writer{[&] {
+      for (const auto e : elements) {
+        tree.push(e);
+      }
+    }};
+    while (tree.size() < elements.size()) {
+      if (tree.rebuild()) {
+        ++rebuilds;
+      }
+      std::this_thread::yield();
+    }
+  }
+  tree.wait();
+  BOOST_TEST(rebuilds > 0);
+  BOOST_TEST(tree.size() == elements.size());
+
+  tree.rebuild();
+  tree.wait();
+  for (std::size_t i{0}; i < percentiles.size(); ++i) {
+    BOOST_TEST(tree.quantile(i) == percentile_of(elements, percentiles[i]));
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+// Executes every task at once and records where it was spawned.
+struct recording_executor {
+  std::size_t size() const noexcept
+  {
+    return 4;
+  }
+
+  template<typename F>
+  void run(F&& f)
+  {
+    f();
+  }
+
+  template<typename F>
+  void spawn(F&& f)
+  {
+    ++unplaced;
+    f();
+  }
+
+  template<typename F>
+  void spawn_near(const void* address, F&& f)
+  {
+    addresses.push_back(static_cast<const int*>(address));
+    f();
+  }
+
+  std::vector<const int*> addresses;
+  std::size_t             unplaced{0};
+};
+
+BOOST_AUTO_TEST_SUITE(parallel_tree_tests)
+
+BOOST_AUTO_TEST_CASE(pool_runs_spawned_tasks)
+{
+  work_stealing_pool       pool{4};
+  std::atomic<std::size_t> count{0};
+
+  // A binary tree of 2^10 - 1 tasks.
+  std::function<void(int)> task{[&](int depth) {
+    ++count;
+    if (depth > 1) {
+      pool.spawn([&, depth] { task(depth - 1); });
+      pool.spawn([&, depth] { task(depth - 1); });
+    }
+  }};
+  for (int run{0}; run < 10; ++run) {
+    count = 0;
+    pool.run([&] { task(10); });
+    BOOST_TEST(count == 1023);
+  }
+
+  const auto statistics{pool.statistics()};
+  BOOST_TEST(statistics.tasks.size() == 4);
+  BOOST_TEST(std::accumulate(statistics.tasks.begin(),
+                             statistics.tasks.end(),
+                             std::size_t{0})
+             == 1023);
+
+  const auto failing_root{[&] {
+    pool.spawn([] { throw std::runtime_error{"task failed"}; });
+  }};
+  BOOST_CHECK_THROW(pool.run(failing_root), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(parallel_build_places_ranks)
+{
+  work_stealing_pool pool{3};
+  std::mt19937       rng{41};
+  for (const std::size_t size : {0, 1, 100, 5000, 100000}) {
+    for (const auto& percentiles :
+         {std::vector<double>{0.25, 0.5, 0.75},
+          std::vector<double>{0.99, 0.999, 0.9999},
+          std::vector<double>{0.001, 0.5, 0.9},
+          std::vector<double>{}}) {
+      std::vector<int> v(size);
+      for (auto& e : v) {
+        e = static_cast<int>(rng() % 1000);
+      }
+      std::vector<std::size_t> positions;
+      for (const auto p : percentiles) {
+        const auto rank{static_cast<std::size_t>(
+          p * static_cast<double>(size == 0 ? 0 : size - 1))};
+        if (rank < size && (positions.empty() || positions.back() < rank)) {
+          positions.push_back(rank);
+        }
+      }
+      std::vector<std::vector<int>::iterator> ranks;
+      for (const auto position : positions) {
+        ranks.push_back(v.begin() + static_cast<std::ptrdiff_t>(position));
+      }
+
+      auto sorted{v};
+      std::sort(sorted.begin(), sorted.end());
+      parallel_make_order_statistics_tree(v.begin(),
+                                          v.end(),
+                                          ranks.begin(),
+                                          ranks.end(),
+                                          std::less<>{},
+                                          pool,
+                                          64);
+
+      auto segment_first{v.begin()};
+      for (std::size_t i{0}; i <= ranks.size(); ++i) {
+        const auto segment_last{i < ranks.size() ? ranks[i] : v.end()};
+        BOOST_TEST(is_mm_heap(segment_first, segment_last));
+        std::vector<int> segment(segment_first, segment_last);
+        std::sort(segment.begin(), segment.end());
+        BOOST_TEST(std::equal(segment.begin(),
+                              segment.end(),
+                              sorted.begin() + (segment_first - v.begin())));
+        if (i < ranks.size()) {
+          BOOST_TEST(*ranks[i] == sorted[positions[i]]);
+        }
+        segment_first = segment_last;
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(parallel_build_takes_threads_from_executor)
+{
+  std::vector<int> v(100000);
+  std::mt19937     rng{59};
+  for (auto& e : v) {
+    e = static_cast<int>(rng() % 1000);
+  }
+  auto sorted{v};
+  std::sort(sorted.begin(), sorted.end());
+
+  const auto check{[&](auto& executor) {
+    auto             w{v};
+    const std::array ranks{w.begin() + 500, w.begin() + 99000};
+    parallel_make_order_statistics_tree(w.begin(),
+                                        w.end(),
+                                        ranks.begin(),
+                                        ranks.end(),
+                                        std::less<>{},
+                                        executor,
+                                        256);
+    BOOST_TEST(*ranks[0] == sorted[500]);
+    BOOST_TEST(*ranks[1] == sorted[99000]);
+    BOOST_TEST(is_mm_heap(w.begin(), ranks[0]));
+  }};
+  // Neither one worker nor the calling thread alone splits the top level.
+  work_stealing_pool single{1};
+  check(single);
+  inline_executor immediate;
+  check(immediate);
+}
+
+BOOST_AUTO_TEST_CASE(parallel_partition_selects)
+{
+  work_stealing_pool pool{3};
+  std::mt19937       rng{47};
+  for (const std::size_t size : {0, 1, 100, 5000, 100000}) {
+    for (const int values : {2, 1000}) {
+      std::vector<int> v(size);
+      for (auto& e : v) {
+        e = static_cast<int>(rng() % static_cast<unsigned>(values));
+      }
+      auto sorted{v};
+      std::sort(sorted.begin(), sorted.end());
+
+      const auto threshold{values / 3};
+      auto       partitioned{v};
+      const auto mid{parallel_partition(
+        partitioned.begin(),
+        partitioned.end(),
+        [&](int x) { return x < threshold; },
+        pool,
+        64)};
+      BOOST_TEST(std::is_partitioned(partitioned.begin(),
+                                     partitioned.end(),
+                                     [&](int x) { return x < threshold; }));
+      const auto smaller{
+        std::lower_bound(sorted.begin(), sorted.end(), threshold)
+        - sorted.begin()};
+      BOOST_TEST((mid - partitioned.begin()) == smaller);
+      std::sort(partitioned.begin(), partitioned.end());
+      BOOST_TEST((partitioned == sorted));
+
+      for (const auto position : {std::size_t{0}, size / 2, size - 1}) {
+        if (position >= size) {
+          continue;
+        }
+        auto       selected{v};
+        const auto nth{selected.begin()
+                       + static_cast<std::ptrdiff_t>(position)};
+        parallel_nth_element(
+          selected.begin(), nth, selected.end(), std::less<>{}, pool, 64);
+        BOOST_TEST(*nth == sorted[position]);
+        BOOST_TEST(std::all_of(selected.begin(), nth, [&](int x) {
+          return x <= *nth;
+        }));
+        BOOST_TEST(std::all_of(nth, selected.end(), [&](int x) {
+          return x >= *nth;
+        }));
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(topology_is_detected)
+{
+  const auto topology{detect_numa_topology()};
+  BOOST_TEST(!topology.nodes.empty());
+  BOOST_TEST(topology.cpus() > 0);
+  for (const auto& node : topology.nodes) {
+    BOOST_TEST(!node.cpus.empty());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(numa_pool_builds_tree)
+{
+  // Two nodes on the first CPU, which every machine has.
+  const numa_topology topology{{numa_node{0, {0, 0}}, numa_node{1, {0, 0}}}};
+  work_stealing_pool  pool{topology};
+  BOOST_TEST(pool.size() == 4);
+  BOOST_TEST(pool.node_of(1) == 0);
+  BOOST_TEST(pool.node_of(2) == 1);
+
+  std::vector<std::size_t> calls(pool.size());
+  pool.for_each_worker([&](std::size_t worker) { ++calls[worker]; });
+  BOOST_TEST((calls == std::vector<std::size_t>(pool.size(), 1)));
+  const auto statistics{pool.statistics()};
+  BOOST_TEST(std::accumulate(statistics.steals.begin(),
+                             statistics.steals.end(),
+                             std::size_t{0})
+             == 0);
+
+  std::vector<int> v(100000);
+  std::mt19937     rng{43};
+  for (auto& e : v) {
+    e = static_cast<int>(rng() % 1000);
+  }
+  auto sorted{v};
+  std::sort(sorted.begin(), sorted.end());
+
+  first_touch_array<int> placed{pool, std::span<const int>{v}};
+  BOOST_TEST(placed.size() == v.size());
+  BOOST_TEST(std::equal(placed.begin(), placed.end(), v.begin(), v.end()));
+  BOOST_TEST(placed.worker_of(0) == 0u);
+  BOOST_TEST(placed.worker_of(24999) == 0u);
+  BOOST_TEST(placed.worker_of(25000) == 1u);
+  BOOST_TEST(placed.worker_of(99999) == 3u);
+
+  auto             executor{placed.executor()};
+  const std::array ranks{placed.begin() + 50000, placed.begin() + 99000};
+  parallel_make_order_statistics_tree(placed.begin(),
+                                      placed.end(),
+                                      ranks.begin(),
+                                      ranks.end(),
+                                      std::less<>{},
+                                      executor,
+                                      256);
+  BOOST_TEST(*ranks[0] == sorted[50000]);
+  BOOST_TEST(*ranks[1] == sorted[99000]);
+  BOOST_TEST(is_mm_heap(placed.begin(), ranks[0]));
+  BOOST_TEST(pool.statistics().remote_steals.size() == pool.size());
+}
+
+BOOST_AUTO_TEST_CASE(partition_tasks_start_near_their_elements)
+{
+  std::vector<int> v(4000);
+  std::mt19937     rng{71};
+  for (auto& e : v) {
+    e = static_cast<int>(rng() % 1000);
+  }
+  recording_executor executor;
+  const auto         mid{parallel_partition(
+    v.begin(), v.end(), [](int e) { return e < 500; }, executor, 1000)};
+  BOOST_TEST(std::all_of(v.begin(), mid, [](int e) { return e < 500; }));
+  BOOST_TEST(std::none_of(mid, v.end(), [](int e) { return e < 500; }));
+
+  // Four blocks, then the swaps of the misplaced elements before mid.
+  BOOST_TEST(executor.unplaced == 0u);
+  BOOST_REQUIRE(executor.addresses.size() > 4);
+  for (std::size_t i{0}; i < 4; ++i) {
+    BOOST_TEST(executor.addresses[i] == v.data() + 1000 * i);
+  }
+  for (std::size_t i{4}; i < executor.addresses.size(); ++i) {
+    BOOST_TEST((executor.addresses[i] < std::to_address(mid)));
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(distributed_tests)
+
+BOOST_AUTO_TEST_CASE(in_process_selects_ranks)
+{
+  std::mt19937 rng{59};
+  for (const std::size_t workers : {1, 3, 8}) {
+    for (const int values : {3, 1000000}) {
+      std::vector<std::vector<int>> shards(workers);
+      std::vector<int>              all;
+      for (std::size_t i{0}; i < workers; ++i) {
+        // Unequal shards, the second one empty.
+        shards[i].resize(i == 1 ? 0 : 1000 * (i + 1));
+        for (auto& e : shards[i]) {
+          e = static_cast<int>(rng() % static_cast<unsigned>(values));
+          all.push_back(e);
+        }
+      }
+      std::sort(all.begin(), all.end());
+
+      in_process_transport<int>      transport{shards};
+      const std::vector<std::size_t> ranks{
+        all.size() - 1, 0, all.size() / 2, all.size() * 99 / 100};
+      const auto selection{distributed_select<int>(
+        transport, std::span<const std::size_t>{ranks})};
+      BOOST_TEST(selection.values.size() == ranks.size());
+      for (std::size_t i{0}; i < ranks.size(); ++i) {
+        BOOST_TEST(selection.values[i] == all[ranks[i]]);
+      }
+      // Two requests and two replies of at most 3 values per rank.
+      BOOST_TEST(selection.exchanged
+                 <= 2 * workers
+                      + selection.rounds * 4 * workers * 3 * ranks.size());
+
+      const std::vector<double> percentiles{0.5, 0.999};
+      const auto                quantiles{distributed_quantiles<int>(
+        transport, std::span<const double>{percentiles})};
+      BOOST_TEST(quantiles.values[0]
+                 == all[static_cast<std::size_t>(
+                      0.5 * static_cast<double>(all.size() - 1) + 0.5)]);
+      BOOST_TEST(quantiles.values[1]
+                 == all[static_cast<std::size_t>(
+                      0.999 * static_cast<double>(all.size() - 1) + 0.5)]);
+
+      const std::vector<std::size_t> out_of_range{all.size()};
+      const std::span<const std::size_t> invalid{out_of_range};
+      BOOST_CHECK_THROW(distributed_select<int>(transport, invalid),
+                        std::out_of_range);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(workers_do_linear_work)
+{
+  std::mt19937 rng{67};
+  for (const int values : {2, 1000000}) {
+    std::vector<std::vector<int>> shards(4);
+    std::vector<int>              all;
+    for (auto& shard : shards) {
+      shard.resize(100000);
+      for (auto& e : shard) {
+        e = static_cast<int>(rng() % static_cast<unsigned>(values));
+        all.push_back(e);
+      }
+    }
+    std::sort(all.begin(), all.end());
+
+    std::size_t                   comparisons{0};
+    const auto                    counting{[&](int a, int b) {
+      ++comparisons;
+      return a < b;
+    }};
+    in_process_transport<int, decltype(counting)> transport{shards, counting};
+    const std::vector<std::size_t>                ranks{
+      0, all.size() / 4, all.size() / 2, all.size() * 99 / 100};
+    const auto selection{distributed_select<int>(
+      transport, std::span<const std::size_t>{ranks}, std::less<>{})};
+    for (std::size_t i{0}; i < ranks.size(); ++i) {
+      BOOST_TEST(selection.values[i] == all[ranks[i]]);
+    }
+    // A few passes over the shards per rank, sorting the shards would take
+    // about 17 comparisons per element.
+    BOOST_TEST(comparisons < 4 * ranks.size() * all.size());
+  }
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+BOOST_AUTO_TEST_CASE(pipe_workers_select_ranks)
+{
+  std::mt19937                  rng{61};
+  std::vector<std::vector<int>> shards(4);
+  std::vector<int>              all;
+  for (auto& shard : shards) {
+    shard.resize(10000);
+    for (auto& e : shard) {
+      e = static_cast<int>(rng() % 100000);
+      all.push_back(e);
+    }
+  }
+  std::sort(all.begin(), all.end());
+
+  auto transport{pipe_transport<int>::fork(shards)};
+  BOOST_TEST(transport.size() == 4);
+  const std::vector<std::size_t> ranks{0, 20000, 39600};
+  for (int run{0}; run < 2; ++run) {
+    const auto selection{
+      distributed_select<int>(transport, std::span<const std::size_t>{ranks})};
+    BOOST_TEST(selection.values[0] == all[0]);
+    BOOST_TEST(selection.values[1] == all[20000]);
+    BOOST_TEST(selection.values[2] == all[39600]);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(exited_pipe_workers_throw)
+{
+  // The workers exit in the first round, their comparison throws while they
+  // select a proposal.
+  const auto throwing{[](int, int) -> bool {
+    throw std::runtime_error{"comparison"};
+  }};
+  auto transport{pipe_transport<int>::fork({{2, 1}, {4, 3}}, throwing)};
+  const std::vector<std::size_t> ranks{1};
+  BOOST_CHECK_THROW(
+    distributed_select<int>(transport, std::span<const std::size_t>{ranks}),
+    std::system_error);
+  // Larger than a pipe buffer, the write cannot finish before the exit.
+  const selection_message<int> request{
+    selection_step::count, std::vector<int>(1 << 20), {}};
+  for (int run{0}; run < 2; ++run) {
+    try {
+      transport.broadcast(request);
+      BOOST_ERROR("broadcast to exited workers succeeded");
+    }
+    catch (const std::system_error& e) {
+      BOOST_TEST(e.code().value() == EPIPE);
+    }
+  }
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(ingest_tests)
+
+BOOST_AUTO_TEST_CASE(parses_columns)
+{
+  const std::string text{"id,latency\r\n"
+                         "1, 2.5 ,x\r\n"
+                         "\n"
+                         "2,-7\n"
+                         "  \r\n"
+                         "3,1e3"};
+  const auto        values{parse_column<double>(text, {',', 1, true})};
+  BOOST_TEST(values.size == 3);
+  BOOST_TEST(values.elements()[0] == 2.5);
+  BOOST_TEST(values.elements()[1] == -7.0);
+  BOOST_TEST(values.elements()[2] == 1000.0);
+
+  const auto ids{parse_column<int>("1;a\n2;b\n", {';', 0, false})};
+  BOOST_TEST(ids.size == 2);
+  BOOST_TEST(ids.elements()[1] == 2);
+  BOOST_TEST(parse_column<int>("").size == 0);
+  BOOST_TEST(parse_column<int>("id\n", {',', 0, true}).size == 0);
+
+  const auto error_line{[](std::string_view invalid) {
+    try {
+      parse_column<int>(invalid, {',', 1, true});
+    }
+    catch (const std::invalid_argument& e) {
+      return std::string{e.what()}.substr(0, std::string{e.what()}.find(':'));
+    }
+    return std::string{};
+  }};
+  BOOST_TEST(error_line("a,b\n1,2\n\n3\n") == "line 4");
+  BOOST_TEST(error_line("a,b\n1,2.5\n") == "line 2");
+  BOOST_TEST(error_line("a,b\n1,x\n") == "line 2");
+}
+
+BOOST_AUTO_TEST_CASE(parallel_parse_matches_sequential)
+{
+  std::mt19937     rng{67};
+  std::string      text;
+  std::vector<int> expected;
+  for (int i{0}; i < 100000; ++i) {
+    if (rng() % 16 == 0) {
+      text += i % 2 == 0 ? "\n" : " \r\n";
+      continue;
+    }
+    expected.push_back(static_cast<int>(rng() % 2000000) - 1000000);
+    text += std::to_string(i) + ',' + std::to_string(expected.back())
+            + (i % 3 == 0 ? "\r\n" : "\n");
+  }
+
+  work_stealing_pool pool{4};
+  for (const std::size_t chunk_size : {1, 100, 4096, 1 << 20}) {
+    const auto values{
+      parse_column<int>(text, {',', 1, false}, pool, chunk_size)};
+    BOOST_TEST(values.elements().size() == expected.size());
+    BOOST_TEST(std::equal(values.elements().begin(),
+                          values.elements().end(),
+                          expected.begin(),
+                          expected.end()));
+  }
+
+  text += "1,\n";
+  BOOST_CHECK_THROW(parse_column<int>(text, {',', 1, false}, pool, 4096),
+                    std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(pipeline_tests)
+
+BOOST_AUTO_TEST_CASE(pipelined_build_selects_percentiles)
+{
+  std::mt19937                        rng{71};
+  std::lognormal_distribution<double> sample{0.0, 1.0};
+  for (const bool sorted_input : {false, true}) {
+    std::vector<double> values(20000);
+    for (auto& v : values) {
+      v = std::round(sample(rng) * 1000.0) / 1000.0;
+    }
+    if (sorted_input) {
+      std::sort(values.begin(), values.end());
+    }
+    std::string text{"id,latency\r\n"};
+    for (std::size_t i{0}; i < values.size(); ++i) {
+      text += std::to_string(i) + ", " + std::to_string(values[i]) + "\r\n";
+    }
+    std::sort(values.begin(), values.end());
+
+    const std::vector<double> percentiles{0.5, 0.0, 0.99, 1.0, 0.5};
+    // Lines span the small blocks.
+    pipelined_tree_build<double> build{percentiles, {',', 1, true}, {}, 7};
+    std::istringstream           in{text};
+    build.run(in);
+    BOOST_TEST(build.statistics().bytes == text.size());
+    BOOST_TEST(build.statistics().blocks == (text.size() + 6) / 7);
+    for (std::size_t i{0}; i < percentiles.size(); ++i) {
+      const auto rank{static_cast<std::size_t>(
+        percentiles[i] * static_cast<double>(values.size() - 1) + 0.5)};
+      BOOST_TEST(build.quantile(i) == values[rank]);
+    }
+
+    auto                           tree{build.result()};
+    const std::vector<std::size_t> ranks(tree.ranks().begin(),
+                                         tree.ranks().end());
+    auto                           elements{tree.release()};
+    std::vector<std::vector<double>::iterator> rank_its;
+    for (const auto rank : ranks) {
+      rank_its.push_back(elements.begin() + static_cast<std::ptrdiff_t>(rank));
+    }
+    BOOST_TEST(elements.size() == values.size());
+    BOOST_TEST(is_order_statistics_tree(
+      elements.begin(), elements.end(), rank_its.begin(), rank_its.end()));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(pipelined_build_reports_errors)
+{
+  pipelined_tree_build<int> build{{0.5}, {',', 0, false}, {}, 3};
+  std::istringstream        empty{""};
+  build.run(empty);
+  BOOST_CHECK_THROW(build.quantile(0), std::length_error);
+
+  std::istringstream invalid{"1\n2\n\n30\nx\n4\n"};
+  try {
+    build.run(invalid);
+    BOOST_TEST(false);
+  }
+  catch (const std::invalid_argument& e) {
+    BOOST_TEST(std::string{e.what()}.starts_with("line 5:"));
+  }
+
+  auto read_fails{[](char*, std::size_t) -> std::size_t {
+    throw std::runtime_error{"read"};
+  }};
+  BOOST_CHECK_THROW(build.run(read_fails), std::runtime_error);
+  BOOST_CHECK_THROW(pipelined_tree_build<int>({1.5}), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(dataset_tests)
+
+BOOST_AUTO_TEST_CASE(distributions_have_their_shapes)
+{
+  using namespace order_statistics::datasets;
+  constexpr std::size_t size{1000};
+
+  const auto sorted{generate<int>(distribution::sorted, size)};
+  BOOST_TEST(std::is_sorted(sorted.begin(), sorted.end()));
+  const auto reverse{generate<int>(distribution::reverse_sorted, size)};
+  BOOST_TEST(std::is_sorted(reverse.rbegin(), reverse.rend()));
+  const auto pipe{generate<int>(distribution::organ_pipe, size)};
+  BOOST_TEST(std::is_sorted(pipe.begin(), pipe.begin() + size / 2));
+  BOOST_TEST(std::is_sorted(pipe.rbegin(), pipe.rbegin() + size / 2));
+  const auto saw{generate<int>(distribution::sawtooth, size)};
+  BOOST_TEST(std::count(saw.begin(), saw.end(), 0) == 16);
+
+  auto few{generate<float>(distribution::few_unique, size)};
+  std::sort(few.begin(), few.end());
+  BOOST_TEST((std::unique(few.begin(), few.end()) - few.begin()) <= 16);
+  const auto equal{generate<double>(distribution::all_equal, size)};
+  BOOST_TEST(std::count(equal.begin(), equal.end(), equal[0]) == size);
+
+  const auto zipf{generate<std::int64_t>(distribution::zipf, size)};
+  BOOST_TEST(*std::min_element(zipf.begin(), zipf.end()) == 1);
+  BOOST_TEST(std::count(zipf.begin(), zipf.end(), 1) > size / 10);
+  const auto lognormal{generate<double>(distribution::lognormal, size)};
+  BOOST_TEST(*std::min_element(lognormal.begin(), lognormal.end()) > 0.0);
+
+  // Order preserving conversions.
+  const auto bytes{generate<std::uint8_t>(distribution::sorted, size)};
+  BOOST_TEST(std::is_sorted(bytes.begin(), bytes.end()));
+  BOOST_TEST(bytes.back() == 255);
+  const auto strings{generate<std::string>(distribution::sorted, size)};
+  BOOST_TEST(std::is_sorted(strings.begin(), strings.end()));
+  BOOST_TEST(strings[7] == "007");
+
+  for (const auto d : distributions) {
+    BOOST_TEST((generate<float>(d, size, 3) == generate<float>(d, size, 3)));
+  }
+  BOOST_TEST(name(distribution::nth_element_killer) == "nth_element_killer");
+}
+
+BOOST_AUTO_TEST_CASE(trees_of_all_distributions)
+{
+  using namespace order_statistics::datasets;
+  constexpr std::size_t size{10001};
+
+  const auto check{[&]<typename T>(std::vector<T> values) {
+    auto sorted{values};
+    std::sort(sorted.begin(), sorted.end());
+    const std::array<std::size_t, 3> positions{0, size / 2, size * 99 / 100};
+    std::vector<typename std::vector<T>::iterator> ranks;
+    for (const auto position : positions) {
+      ranks.push_back(values.begin() + static_cast<std::ptrdiff_t>(position));
+    }
+    make_order_statistics_tree(
+      values.begin(), values.end(), ranks.begin(), ranks.end());
+    for (const auto position : positions) {
+      BOOST_TEST((values[position] == sorted[position]));
+    }
+    BOOST_TEST(is_order_statistics_tree(
+      values.begin(), values.end(), ranks.begin(), ranks.end()));
+  }};
+  for (const auto d : distributions) {
+    BOOST_TEST_CONTEXT(name(d))
+    {
+      check(generate<int>(d, size));
+      check(generate<std::uint16_t>(d, size));
+      check(generate<double>(d, size));
+      check(generate<std::string>(d, size));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#if defined(__unix__) || defined(__APPLE__)
+BOOST_AUTO_TEST_SUITE(shared_memory_tests)
+
+BOOST_AUTO_TEST_CASE(reader_sees_pushes)
+{
+  const auto name{"/order_statistics_tests_" + std::to_string(::getpid())};
+  std::vector<int> v(1000);
+  std::mt19937     rng{67};
+  for (auto& e : v) {
+    e = static_cast<int>(rng() % 10000);
+  }
+  shared_order_statistics_tree<int> tree{
+    name, std::span<const int>{v}, {499, 989}, 2000};
+  BOOST_CHECK_THROW((shared_order_statistics_tree<int>{
+                      name, std::span<const int>{v}, {499}, 2000}),
+                    std::system_error);
+  BOOST_CHECK_THROW(shared_order_statistics_reader<long double>{name},
+                    std::runtime_error);
+
+  const shared_order_statistics_reader<int> reader{name};
+  BOOST_TEST(reader.rank_count() == 2);
+  BOOST_TEST(reader.position(1) == 989);
+  for (std::size_t i{0}; i <= 1000; ++i) {
+    if (i > 0) {
+      const auto value{static_cast<int>(rng() % 10000)};
+      v.push_back(value);
+      tree.push(value);
+    }
+    auto sorted{v};
+    std::sort(sorted.begin(), sorted.end());
+    const auto snapshot{reader.snapshot()};
+    BOOST_TEST(snapshot.size == v.size());
+    BOOST_TEST(reader.at_rank(0) == sorted[499]);
+    BOOST_TEST(snapshot.ranks[1] == sorted[989]);
+    BOOST_TEST(snapshot.min == sorted.front());
+    BOOST_TEST(reader.max() == sorted.back());
+  }
+  BOOST_CHECK_THROW(tree.push(0), std::length_error);
+}
+
+BOOST_AUTO_TEST_CASE(reader_checks_bounds)
+{
+  const auto name{"/order_statistics_tests_" + std::to_string(::getpid())};
+  {
+    std::vector<int> v(100);
+    std::iota(v.begin(), v.end(), 0);
+    const shared_order_statistics_tree<int> tree{
+      name, std::span<const int>{v}, {50}, 200};
+    const shared_order_statistics_reader<int> reader{name};
+    BOOST_TEST(reader.position(0) == 50);
+    BOOST_CHECK_THROW(reader.position(1), std::out_of_range);
+    BOOST_TEST(reader.at_rank(2) == 99);
+    BOOST_CHECK_THROW(reader.at_rank(3), std::out_of_range);
+  }
+
+  // Segments of the same name whose header points past their end.
+  const auto write_segment{[&](std::span<const std::uint64_t> words) {
+    const auto fd{::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600)};
+    BOOST_REQUIRE(fd >= 0);
+    BOOST_REQUIRE(::ftruncate(fd, static_cast<off_t>(words.size_bytes()))
+                  == 0);
+    const auto address{::mmap(nullptr,
+                              words.size_bytes(),
+                              PROT_READ | PROT_WRITE,
+                              MAP_SHARED,
+                              fd,
+                              0)};
+    ::close(fd);
+    BOOST_REQUIRE(address != MAP_FAILED);
+    std::memcpy(address, words.data(), words.size_bytes());
+    ::munmap(address, words.size_bytes());
+  }};
+  // Magic, version, element size, capacity, ranks and the offsets of the
+  // positions, the pivots and the elements.
+  const std::array<std::uint64_t, 8> header{
+    0x5453544154534f53, 1, sizeof(int), 0, 1, 128, 136, 192};
+  std::vector<std::uint64_t> words(header.begin(), header.end());
+  words.resize(32);
+  write_segment(words);
+  BOOST_CHECK_NO_THROW(shared_order_statistics_reader<int>{name});
+  ::shm_unlink(name.c_str());
+
+  // Too many ranks, positions or pivots past the end, unaligned pivots.
+  const std::array<std::pair<std::size_t, std::uint64_t>, 4> corruptions{
+    {{4, 1u << 30}, {5, 1u << 20}, {6, 1u << 20}, {6, 137}}};
+  for (const auto& [index, value] : corruptions) {
+    auto corrupt{words};
+    corrupt[index] = value;
+    write_segment(corrupt);
+    BOOST_CHECK_THROW(shared_order_statistics_reader<int>{name},
+                      std::runtime_error);
+    ::shm_unlink(name.c_str());
+  }
+  write_segment(std::span{header}.first(2));
+  BOOST_CHECK_THROW(shared_order_statistics_reader<int>{name},
+                    std::runtime_error);
+  ::shm_unlink(name.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(reader_times_out_on_unfinished_publish)
+{
+  const auto name{"/order_statistics_tests_" + std::to_string(::getpid())};
+  std::vector<int> v(100);
+  std::iota(v.begin(), v.end(), 0);
+  shared_order_statistics_tree<int> tree{
+    name, std::span<const int>{v}, {50}, 100};
+  const shared_order_statistics_reader<int> reader{
+    name, std::chrono::milliseconds{20}};
+
+  // A writer that died while it copied the pivots leaves the sequence number
+  // odd, at byte 64 of the header.
+  const auto fd{::shm_open(name.c_str(), O_RDWR, 0600)};
+  BOOST_REQUIRE(fd >= 0);
+  const auto address{
+    ::mmap(nullptr, 128, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)};
+  ::close(fd);
+  BOOST_REQUIRE(address != MAP_FAILED);
+  const auto sequence{static_cast<std::byte*>(address) + 64};
+  std::uint64_t published;
+  std::memcpy(&published, sequence, sizeof(published));
+  const auto unfinished{published + 1};
+  std::memcpy(sequence, &unfinished, sizeof(unfinished));
+
+  const auto timed_out{[](const std::system_error& error) {
+    return error.code() == std::errc::timed_out;
+  }};
+  const auto start{std::chrono::steady_clock::now()};
+  BOOST_CHECK_EXCEPTION(reader.at_rank(0), std::system_error, timed_out);
+  BOOST_TEST((std::chrono::steady_clock::now() - start
+              >= std::chrono::milliseconds{20}));
+  BOOST_CHECK_EXCEPTION(reader.max(), std::system_error, timed_out);
+  BOOST_CHECK_EXCEPTION(reader.snapshot(), std::system_error, timed_out);
+
+  std::memcpy(sequence, &published, sizeof(published));
+  BOOST_TEST(reader.at_rank(0) == 50);
+  ::munmap(address, 128);
+}
+
+BOOST_AUTO_TEST_CASE(reader_process_sees_consistent_pivots)
+{
+  const auto name{"/order_statistics_tests_" + std::to_string(::getpid())};
+  std::vector<int> v(10000);
+  std::iota(v.begin(), v.end(), 0);
+  shared_order_statistics_tree<int> tree{
+    name, std::span<const int>{v}, {1000, 5000, 9000}, 110000};
+
+  // The child reads while the parent appends ever greater elements, every
+  // snapshot must be the pivots of some size.
+  const auto pid{::fork()};
+  BOOST_REQUIRE(pid >= 0);
+  if (pid == 0) {
+    const shared_order_statistics_reader<int> reader{name};
+    for (int i{0}; i < 100000; ++i) {
+      const auto snapshot{reader.snapshot()};
+      if (snapshot.ranks != std::vector<int>{1000, 5000, 9000}
+          || snapshot.min != 0
+          || snapshot.max != static_cast<int>(snapshot.size) - 1) {
+        ::_exit(1);
+      }
+    }
+    ::_exit(0);
+  }
+  for (int value{10000}; value < 110000; ++value) {
+    tree.push(value);
+  }
+  int status{0};
+  BOOST_REQUIRE(::waitpid(pid, &status, 0) == pid);
+  BOOST_TEST(WIFEXITED(status));
+  BOOST_TEST(WEXITSTATUS(status) == 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
+#endif
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,345 @@
+/// @file
+/// ostat prints exact percentiles of a column of numbers.
+///
+/// @code
+/// ostat [options] [file]
+///   -t, --type int32|int64|float|double  type of the values (double)
+///   -b, --binary                         raw values in native byte order
+///   -c, --column N                       zero-based CSV column (0)
+///   -H, --header                         skip the first CSV line
+///   -p, --percentiles P[,P...]           percentiles in [0, 100]
+///                                        (50,90,99,99.9)
+///   -j, --threads N                      worker threads (all CPUs)
+///   -s, --stats                          print timings to stderr
+/// @endcode
+///
+/// Without a file or with "-" the values are read from the standard input.
+/// Values that are NaN are rejected, the percentiles of unordered values are
+/// undefined.
+/// A binary file is mapped copy-on-write and the tree is built in the
+/// mapping, i.e., the values are neither parsed nor copied. A CSV file is
+/// mapped and parsed by the worker threads with parse_column().
+
+// C++ Standard Library.
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// POSIX.
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "command_line.hpp"
+
+import order_statistics;
+
+using namespace order_statistics;
+
+namespace {
+
+struct options {
+  std::string         type{"double"};
+  bool                binary{false};
+  std::size_t         column{0};
+  bool                header{false};
+  std::vector<double> percentiles{50.0, 90.0, 99.0, 99.9};
+  unsigned            threads{std::thread::hardware_concurrency()};
+  bool                stats{false};
+  std::string         path{"-"};
+};
+
+constexpr std::string_view usage{
+  "usage: ostat [options] [file]\n"
+  "  -t, --type int32|int64|float|double  type of the values (double)\n"
+  "  -b, --binary                         raw values in native byte order\n"
+  "  -c, --column N                       zero-based CSV column (0)\n"
+  "  -H, --header                         skip the first CSV line\n"
+  "  -p, --percentiles P[,P...]           percentiles in [0, 100]\n"
+  "                                       (50,90,99,99.9)\n"
+  "  -j, --threads N                      worker threads (all CPUs)\n"
+  "  -s, --stats                          print timings to stderr\n"};
+
+/// @throws std::invalid_argument for unknown or malformed options.
+options parse_options(std::span<char*> list)
+{
+  options                 result;
+  bool                    has_path{false};
+  command_line::arguments arguments{list};
+  while (!arguments.empty()) {
+    const auto argument{arguments.next()};
+    if (argument == "-t" || argument == "--type") {
+      result.type = arguments.value();
+    }
+    else if (argument == "-b" || argument == "--binary") {
+      result.binary = true;
+    }
+    else if (argument == "-c" || argument == "--column") {
+      result.column = arguments.number<std::size_t>();
+    }
+    else if (argument == "-H" || argument == "--header") {
+      result.header = true;
+    }
+    else if (argument == "-p" || argument == "--percentiles") {
+      result.percentiles.clear();
+      auto items{arguments.value()};
+      while (!items.empty()) {
+        const auto item{items.substr(0, items.find(','))};
+        items.remove_prefix(std::min(items.size(), item.size() + 1));
+        const auto p{command_line::parse_number<double>(item)};
+        if (!(p >= 0.0 && p <= 100.0)) {
+          throw std::invalid_argument{"percentile must lie in [0, 100]"};
+        }
+        result.percentiles.push_back(p);
+      }
+    }
+    else if (argument == "-j" || argument == "--threads") {
+      result.threads = std::max(1u, arguments.number<unsigned>());
+    }
+    else if (argument == "-s" || argument == "--stats") {
+      result.stats = true;
+    }
+    else if (argument == "-h" || argument == "--help") {
+      std::cout << usage;
+      std::exit(0);
+    }
+    else if (!has_path && (argument == "-" || !argument.starts_with('-'))) {
+      result.path = argument;
+      has_path    = true;
+    }
+    else {
+      arguments.unknown();
+    }
+  }
+  if (result.type != "int32" && result.type != "int64"
+      && result.type != "float" && result.type != "double") {
+    throw std::invalid_argument{"unknown type " + result.type};
+  }
+  return result;
+}
+
+/// @brief The bytes of a file or of the standard input.
+///
+/// A file is mapped copy-on-write, writes go to private copies of the pages.
+class input_bytes {
+public:
+  /// @throws std::system_error if the input cannot be read.
+  explicit input_bytes(const std::string& path)
+  {
+#if defined(__unix__) || defined(__APPLE__)
+    if (path != "-") {
+      const auto fd{::open(path.c_str(), O_RDONLY)};
+      if (fd < 0) {
+        throw std::system_error{errno, std::generic_category(), path};
+      }
+      struct stat status {};
+      if (::fstat(fd, &status) != 0) {
+        const auto error{errno};
+        ::close(fd);
+        throw std::system_error{error, std::generic_category(), path};
+      }
+      length = static_cast<std::size_t>(status.st_size);
+      if (length > 0) {
+        address = ::mmap(
+          nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+      }
+      const auto error{errno};
+      ::close(fd);
+      if (address == MAP_FAILED) {
+        address = nullptr;
+        throw std::system_error{error, std::generic_category(), path};
+      }
+      return;
+    }
+#endif
+    auto* file{path == "-" ? stdin : std::fopen(path.c_str(), "rb")};
+    if (file == nullptr) {
+      throw std::system_error{errno, std::generic_category(), path};
+    }
+    std::size_t count{0};
+    do {
+      buffer.resize(std::max<std::size_t>(buffer.size() * 2, 1 << 20));
+      count += std::fread(
+        buffer.data() + count, 1, buffer.size() - count, file);
+    } while (count == buffer.size());
+    const auto failed{std::ferror(file) != 0};
+    if (file != stdin) {
+      std::fclose(file);
+    }
+    if (failed) {
+      throw std::system_error{
+        std::make_error_code(std::errc::io_error), path};
+    }
+    buffer.resize(count);
+    length = count;
+  }
+
+  input_bytes(const input_bytes&)            = delete;
+  input_bytes& operator=(const input_bytes&) = delete;
+
+  ~input_bytes()
+  {
+#if defined(__unix__) || defined(__APPLE__)
+    if (address != nullptr) {
+      ::munmap(address, length);
+    }
+#endif
+  }
+
+  std::span<std::byte> bytes() noexcept
+  {
+    return {address != nullptr ? static_cast<std::byte*>(address)
+                               : buffer.data(),
+            length};
+  }
+
+private:
+  void*                  address{nullptr};
+  std::size_t            length{0};
+  std::vector<std::byte> buffer;
+};
+
+/// @brief Returns the shortest text that reads back as @p value.
+template<typename T>
+std::string exact(T value)
+{
+  char       text[64];
+  const auto result{std::to_chars(text, text + sizeof(text), value)};
+  return {text, result.ptr};
+}
+
+template<typename T>
+void run(const options& options)
+{
+  using clock = std::chrono::steady_clock;
+  const auto start{clock::now()};
+
+  work_stealing_pool pool{std::max(1u, options.threads)};
+  input_bytes        input{options.path};
+  ingested_column<T> parsed;
+  std::span<T>       values;
+  if (options.binary) {
+    const auto bytes{input.bytes()};
+    if (bytes.size() % sizeof(T) != 0) {
+      throw std::invalid_argument{"the size of the input is no multiple of "
+                                  + std::to_string(sizeof(T)) + " bytes"};
+    }
+    values = {reinterpret_cast<T*>(bytes.data()), bytes.size() / sizeof(T)};
+  }
+  else {
+    const auto bytes{input.bytes()};
+    parsed = parse_column<T>(
+      {reinterpret_cast<const char*>(bytes.data()), bytes.size()},
+      {',', options.column, options.header},
+      pool);
+    values = parsed.elements();
+  }
+  if (values.empty()) {
+    throw std::invalid_argument{"no values"};
+  }
+  // NaN is unordered, it would break the comparisons of the build.
+  if constexpr (std::is_floating_point_v<T>) {
+    const auto nan{std::find_if(
+      values.begin(), values.end(), [](T x) { return std::isnan(x); })};
+    if (nan != values.end()) {
+      throw std::domain_error{
+        "value " + std::to_string(nan - values.begin()) + " is NaN"};
+    }
+  }
+  const auto loaded{clock::now()};
+
+  const auto          size{values.size()};
+  std::vector<double> fractions;
+  for (const auto p : options.percentiles) {
+    fractions.push_back(p / 100.0);
+  }
+  const auto [positions, index]{make_percentile_ranks(fractions, size)};
+  std::vector<T*> ranks;
+  for (const auto position : positions) {
+    ranks.push_back(values.data() + position);
+  }
+
+  parallel_make_order_statistics_tree(values.data(),
+                                      values.data() + size,
+                                      ranks.begin(),
+                                      ranks.end(),
+                                      pool);
+  const auto built{clock::now()};
+
+  std::cout << "n\t" << size << '\n';
+  std::cout << "min\t" << exact(values.front()) << '\n';
+  for (std::size_t i{0}; i < index.size(); ++i) {
+    std::cout << 'p' << options.percentiles[i] << '\t'
+              << exact(*ranks[index[i]]) << '\n';
+  }
+  std::cout << "max\t"
+            << exact(*max_mm_heap(
+                 ranks.empty() ? values.data() : ranks.back(),
+                 values.data() + size))
+            << '\n';
+
+  if (options.stats) {
+    const auto load_seconds{
+      std::chrono::duration<double>(loaded - start).count()};
+    const auto build_seconds{
+      std::chrono::duration<double>(built - loaded).count()};
+    // A mapped file is read on the first touch, i.e., during the build.
+    std::cerr << std::fixed << std::setprecision(2) << "load "
+              << load_seconds * 1e3 << " ms, build " << build_seconds * 1e3
+              << " ms ("
+              << static_cast<double>(size * sizeof(T)) / build_seconds / 1e9
+              << " GB/s) with " << pool.size() << " threads\n";
+  }
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+  try {
+    const auto options{parse_options(
+      std::span<char*>{argv + 1, static_cast<std::size_t>(argc - 1)})};
+    if (options.type == "int32") {
+      run<std::int32_t>(options);
+    }
+    else if (options.type == "int64") {
+      run<std::int64_t>(options);
+    }
+    else if (options.type == "float") {
+      run<float>(options);
+    }
+    else {
+      run<double>(options);
+    }
+  }
+  catch (const std::invalid_argument& e) {
+    std::cerr << "ostat: " << e.what() << '\n' << usage;
+    return 2;
+  }
+  catch (const std::exception& e) {
+    std::cerr << "ostat: " << e.what() << '\n';
+    return 1;
+  }
+}